@@ -18,12 +18,12 @@ layout(set = 0, binding = 0, std140) uniform CameraUniform{
     mat4 toWorld;
 } u_camera;
 
-const mat3 transform = mat3(100.0, 0.0,  0.0,
-0.0,  100.0, 0.0,
-0.0,  0.0,  100.0);
+layout(push_constant) uniform ObjectConstants {
+    mat4 model;
+} u_object;
 
 void main() {
-    p_position = transform * position;
+    p_position = (u_object.model * vec4(position, 1.0)).xyz;
     gl_Position = u_camera.viewProj * vec4(p_position, 1.0);
     p_normal = normal;
     p_uv = uv;
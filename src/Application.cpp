@@ -1,6 +1,7 @@
 #include "Application.h"
 #include "Logger.h"
 #include "Input.h"
+#include "graphics/DescriptorBenchmark.h"
 #include "graphics/Vulkan.h"
 #include "util/Timer.h"
 #include "game/GameScene.h"
@@ -24,6 +25,9 @@ namespace vanguard {
         Vulkan::initImGui(m_imGuiWindow);
 
         m_renderSystem.init();
+#ifdef VANGUARD_BENCHMARK_DESCRIPTORS
+        benchmarkDescriptorUpdates(10000);
+#endif
 
         setScene<GameScene>();
     }
@@ -39,6 +43,8 @@ namespace vanguard {
             TIMER("Application::loop");
             Window::pollEvents();
 
+            // Host written per frame buffers are updated in place, the frame they belong to has to be done first
+            m_renderSystem.waitForFrame();
             m_scene->update(Window::getDeltaTime());
             m_scheduler.update();
 
@@ -48,10 +54,14 @@ namespace vanguard {
 //            Vulkan::renderImGuiFrame(m_imGuiWindow);
 
             m_renderSystem.render(m_window);
+            if(m_renderSystem.consumeSwapchainRecreated())
+                m_scene->onResize();
         }
 
         // Wait for the device to finish all operations
         Vulkan::getDevice().waitIdle();
+        m_renderSystem.getResourceManager().waitForPipelines();
+        Vulkan::savePipelineCache();
 
         m_scene.reset();
         Vulkan::destroyImGui(m_imGuiWindow);
@@ -6,4 +6,18 @@
 #define WINDOW_NAME APPLICATION_NAME
 
 #define FRAMES_IN_FLIGHT 2
-#define FRAMES_IN_FLIGHT_PLUS_ONE (FRAMES_IN_FLIGHT + 1)
\ No newline at end of file
+#define FRAMES_IN_FLIGHT_PLUS_ONE (FRAMES_IN_FLIGHT + 1)
+// Persistently mapped staging memory shared by all frames in flight, uploads which don't fit get their own buffer
+#define STAGING_RING_SIZE (32 * 1024 * 1024)
+// Staging memory of the async uploader, reused once the uploads staged in it have completed on the transfer queue
+#define ASYNC_STAGING_RING_SIZE (64 * 1024 * 1024)
+
+// Per frame uniform buffers up to these sizes are written by the CPU in place instead of through the stager, the
+// larger limit applies when they can live in host visible device local (BAR) memory
+#define HOST_UNIFORM_BUFFER_MAX_SIZE (256 * 1024)
+#define HOST_UNIFORM_BUFFER_MAX_SYSTEM_SIZE (16 * 1024)
+
+// Per frame in flight, per draw data suballocated from the transient buffer and bound with dynamic offsets
+#define TRANSIENT_BUFFER_SIZE (8 * 1024 * 1024)
+// Largest descriptor range bound onto the transient buffer
+#define TRANSIENT_BUFFER_MAX_RANGE (64 * 1024)
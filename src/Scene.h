@@ -12,6 +12,8 @@ namespace vanguard {
         virtual void init() = 0;
         virtual void update(float deltaTime) = 0;
         virtual CommandsInfo buildCommands() = 0;
+        // The swapchain changed size, commands built before stay valid
+        virtual void onResize() {}
     protected:
         entt::registry m_registry;
     };
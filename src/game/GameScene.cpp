@@ -2,6 +2,9 @@
 
 #include "../Application.h"
 #include "../graphics/FrameGraph.h"
+#include "../util/AllocationCounter.h"
+#include "../util/Timer.h"
+#include "glm/gtx/transform.hpp"
 
 static const std::vector<std::string> assets = {
     "shaders/gbuffer.vert.glsl",
@@ -33,10 +36,24 @@ namespace vanguard {
             uint32_t currentFrameCount = Application::Get().getRenderSystem().getFrameCount();
             uint32_t fps = currentFrameCount - m_lastFrame;
             INFO("FPS: {}", fps);
+            for (const auto& timing: Application::Get().getRenderSystem().getGpuProfiler().getPassTimings()) {
+                INFO("GPU pass {}: {:.3f}ms (avg over {} frames)", timing.name, timing.averageMillis, timing.samples);
+            }
+            auto memoryStats = Application::Get().getRenderSystem().getResourceManager().getMemoryBudget().getStats();
+            for (uint32_t heap = 0; heap < memoryStats.heaps.size(); heap++) {
+                if(memoryStats.heaps[heap].deviceLocal)
+                    INFO("Device local heap {}: {} of {} MiB", heap, memoryStats.heaps[heap].usage >> 20, memoryStats.heaps[heap].budget >> 20);
+            }
+            const auto& stagerStats = Application::Get().getRenderSystem().getStager().getStats();
+            INFO("Uploads last frame: {} copies ({} regions), {} KiB, {} jobs deferred", stagerStats.copies, stagerStats.regions,
+                 stagerStats.bytes >> 10, stagerStats.deferredJobs);
+            if(AllocationCounter::isEnabled())
+                INFO("Allocations while recording: {}", Application::Get().getRenderSystem().getRecordingAllocations());
             m_lastFrame = currentFrameCount;
         }, std::chrono::milliseconds(0), std::chrono::milliseconds(1000));
 
         Application::Get().getAssets().finishLoading();
+        prewarmPipelines();
 
         auto bunny = Application::Get().getAssets().get<Mesh>("bunnyuv.obj");
         m_vb.create<Vertex>(bunny.vertices);
@@ -82,17 +99,24 @@ namespace vanguard {
         m_skybox.addSkyboxPass(builder, sceneImage, cameraUniform);
 
         builder.addRenderPass(FGBRenderPassInfo{
+            .name = "gbuffer",
             .vertexShaderPath = "shaders/gbuffer.vert.glsl",
             .fragmentShaderPath = "shaders/gbuffer.frag.glsl",
             .inputs = {cameraUniform,textureUniform},
             .outputs = {sceneImage,depth},
-            .callback = [&](vk::CommandBuffer cmd, ResourceRef pipeline, std::unordered_map<uint32_t, FrameGraph::DescriptorSet> sets) {
-                sets.at(0).bindGraphics(pipeline, cmd);
+            .callback = [&](const FGBPassContext& ctx) {
+                // Still uploading
+                if(!m_vb.isReady() || !m_texture.isReady())
+                    return;
+                vk::CommandBuffer cmd = ctx.getCommandBuffer();
+                ctx.bindDescriptorSet(0);
+                ctx.pushConstants(glm::scale(glm::mat4(1.0f), glm::vec3(100.0f)));
                 m_vb.bind(cmd);
                 cmd.draw(m_vbc, 1, 0, 0);
                 INFO("Draw!");
             },
             .vertexInputData = getMeshVertexData(),
+            .pushConstants = {{ .stageFlags = vk::ShaderStageFlagBits::eVertex, .offset = 0, .size = sizeof(glm::mat4) }},
         });
 
         auto backbuffer = builder.createImage();
@@ -100,17 +124,91 @@ namespace vanguard {
         auto backbufferStorageImage = builder.addUniformStorageImage(1, 1, backbuffer);
 
         builder.addComputePass(FGBComputePassInfo{
+            .name = "colormap",
             .computeShaderPath = "shaders/colormap.comp.glsl",
             .inputs = { sceneStorageImage },
             .outputs = { backbufferStorageImage },
-            .callback = [&](vk::CommandBuffer cmd, ResourceRef pipeline, std::unordered_map<uint32_t, FrameGraph::DescriptorSet> sets) {
-                sets.at(1).bindCompute(pipeline, cmd);
-                cmd.dispatch(1, 1, 1);
+            .callback = [&](const FGBPassContext& ctx) {
+                ctx.bindDescriptorSet(1);
+                ctx.getCommandBuffer().dispatch(1, 1, 1);
             },
         });
 
         builder.setBackbuffer(backbuffer);
+        builder.setProfiling(true);
+        Timer bakeTimer;
         m_frameGraph = builder.bake();
+        INFO("Frame graph baked in {:.2f}ms with a {} pipeline cache", bakeTimer.elapsedMillis(), Vulkan::isPipelineCacheWarm() ? "warm" : "cold");
+        // The graph's pipelines hold on to the shared objects now
+        Application::Get().getRenderSystem().getResourceManager().releasePrewarmedPipelines();
         return m_frameGraph.getCommands();
     }
+
+    // Has to match the state the baked graph ends up with, anything that differs just compiles again at bake time
+    void GameScene::prewarmPipelines() {
+        auto& resourceManager = Application::Get().getRenderSystem().getResourceManager();
+        // Uniforms are grouped into sets by location, in the order they're added to the builder
+        ResourceRef sceneLayout = resourceManager.createDescriptorSetLayout({ .bindings = {
+                { .binding = 0, .type = vk::DescriptorType::eUniformBuffer },
+                { .binding = 1, .type = vk::DescriptorType::eCombinedImageSampler },
+                { .binding = 2, .type = vk::DescriptorType::eCombinedImageSampler },
+        }});
+        ResourceRef colormapLayout = resourceManager.createDescriptorSetLayout({ .bindings = {
+                { .binding = 0, .type = vk::DescriptorType::eStorageImage },
+                { .binding = 1, .type = vk::DescriptorType::eStorageImage },
+        }});
+        ResourceRef emptyLayout = resourceManager.createDescriptorSetLayout({});
+
+        // The skybox clears the scene image and the gbuffer pass draws over it
+        RenderPipelineAttachmentInfo sceneImage{
+                .format = vk::Format::eR8G8B8A8Unorm,
+                .initialLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .finalLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eClear,
+        };
+        RenderPipelineAttachmentInfo loadedSceneImage = sceneImage;
+        loadedSceneImage.loadOp = vk::AttachmentLoadOp::eLoad;
+
+        resourceManager.prewarmPipelines({
+                RenderPipelineStateInfo{
+                        .descriptorSetLayouts = { sceneLayout },
+                        .colorAttachments = { sceneImage },
+                        .depthTest = true,
+                        .depthWrite = true,
+                        .vertexShaderPath = "shaders/skybox.vert.glsl",
+                        .fragmentShaderPath = "shaders/skybox.frag.glsl",
+                        .vertexInputData = Skybox::getVertexInputData(),
+                },
+                RenderPipelineStateInfo{
+                        .descriptorSetLayouts = { sceneLayout },
+                        .pushConstantRanges = {{ .stageFlags = vk::ShaderStageFlagBits::eVertex, .offset = 0, .size = sizeof(glm::mat4) }},
+                        .colorAttachments = { loadedSceneImage },
+                        .depthStencilAttachment = RenderPipelineAttachmentInfo{
+                                .format = Vulkan::getDepthFormat(),
+                                .initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                                .finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                                .loadOp = vk::AttachmentLoadOp::eClear,
+                        },
+                        .depthTest = true,
+                        .depthWrite = true,
+                        .vertexShaderPath = "shaders/gbuffer.vert.glsl",
+                        .fragmentShaderPath = "shaders/gbuffer.frag.glsl",
+                        .vertexInputData = getMeshVertexData(),
+                },
+        }, {
+                ComputePipelineInfo{
+                        .descriptorSetLayouts = { emptyLayout, colormapLayout },
+                        .computeShaderPath = "shaders/colormap.comp.glsl",
+                },
+        });
+
+        // Pipeline layouts are keyed on the bindings and don't need the set layouts they were created from
+        resourceManager.destroyDescriptorSetLayout(sceneLayout);
+        resourceManager.destroyDescriptorSetLayout(colormapLayout);
+        resourceManager.destroyDescriptorSetLayout(emptyLayout);
+    }
+
+    void GameScene::onResize() {
+        m_frameGraph.resize();
+    }
 }
\ No newline at end of file
@@ -17,7 +17,11 @@ namespace vanguard {
         void init() override;
         void update(float deltaTime) override;
         CommandsInfo buildCommands() override;
+        void onResize() override;
     private:
+        // Starts compiling the pipelines buildCommands' graph uses while the scene is still loading
+        void prewarmPipelines();
+
         FrameGraph m_frameGraph;
         Camera m_camera{};
 
@@ -193,12 +193,17 @@ namespace vanguard {
         });
 
         builder.addRenderPass(FGBRenderPassInfo{
+            .name = "skybox",
             .vertexShaderPath = "shaders/skybox.vert.glsl",
             .fragmentShaderPath = "shaders/skybox.frag.glsl",
             .inputs = { cameraUniform, skyboxTexture },
             .outputs = { image },
-            .callback = [&](vk::CommandBuffer cmd, ResourceRef pipeline, std::unordered_map<uint32_t, FrameGraph::DescriptorSet> sets) {
-                sets.at(0).bindGraphics(pipeline, cmd);
+            .callback = [&](const FGBPassContext& ctx) {
+                // Still uploading
+                if(!m_vb.isReady() || !m_cubeMapTexture.isReady())
+                    return;
+                vk::CommandBuffer cmd = ctx.getCommandBuffer();
+                ctx.bindDescriptorSet(0);
                 m_vb.bind(cmd);
                 cmd.draw(cubeVertices.size(), 1, 0, 0);
             },
@@ -53,6 +53,9 @@ namespace vanguard {
         }
 
         Allocation& operator=(Allocation&& other) noexcept {
+            if(this == &other) return *this;
+            // Replacing a live allocation frees it, otherwise resized resources would leak
+            vmaFreeMemory(*Vulkan::getAllocator(), allocation);
             allocation = other.allocation;
             allocationInfo = other.allocationInfo;
             other.allocation = nullptr;
@@ -0,0 +1,213 @@
+#include "AsyncUploader.h"
+#include "Stager.h"
+#include "../Application.h"
+
+namespace vanguard {
+    void AsyncUploader::init(vk::DeviceSize ringSize) {
+        auto& device = Vulkan::getDevice();
+        vk::SemaphoreTypeCreateInfo typeInfo{
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue = 0
+        };
+        m_semaphore = device.createSemaphore({ .pNext = &typeInfo });
+        m_commandPool = device.createCommandPool({
+            .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = Vulkan::getTransferQueueFamilyIndex()
+        });
+
+        m_ringSize = ringSize / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        m_ring = Stager::createStagingBuffer(m_ringSize, "async staging buffer");
+        m_ringData = static_cast<char*>(RENDER_SYSTEM.getResourceManager().getBuffer(m_ring).allocation.allocationInfo.pMappedData);
+        INFO("Async uploads run on {}", Vulkan::hasTransferQueue() ? "a dedicated transfer queue" : "the main queue");
+    }
+
+    std::pair<ResourceRef, uint32_t> AsyncUploader::stage(uint32_t size, const void* data) {
+        uint64_t start = (m_ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        // Uploads are contiguous, one which would wrap starts at the beginning of the ring instead
+        if(start % m_ringSize + size > m_ringSize)
+            start = (start / m_ringSize + 1) * m_ringSize;
+        if(start + size - m_ringTail <= m_ringSize) {
+            m_ringHead = start + size;
+            vk::DeviceSize offset = start % m_ringSize;
+            memcpy(m_ringData + offset, data, size);
+            return { m_ring, static_cast<uint32_t>(offset) };
+        }
+
+        // The ring is still in use by earlier batches, or the upload is larger than the whole ring
+        ResourceRef buffer = Stager::createStagingBuffer(size, "async staging buffer");
+        memcpy(RENDER_SYSTEM.getResourceManager().getBuffer(buffer).allocation.allocationInfo.pMappedData, data, size);
+        return { buffer, 0 };
+    }
+
+    UploadTicket AsyncUploader::uploadBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data) {
+        if(!RENDER_SYSTEM.getResourceManager().getBuffer(buffer).info.asyncUpload)
+            throw std::runtime_error("Async upload destinations have to be created with asyncUpload");
+        auto [stagingBuffer, stagingOffset] = stage(size, data);
+        m_bufferUploads.push_back(BufferUpload{
+            .stagingBuffer = stagingBuffer,
+            .stagingOffset = stagingOffset,
+            .buffer = buffer,
+            .offset = offset,
+            .size = size
+        });
+        return { m_submittedValue + 1 };
+    }
+
+    UploadTicket AsyncUploader::uploadImage(ResourceRef image, uint32_t size, const void* data, uint32_t arrayLayer) {
+        if(!RENDER_SYSTEM.getResourceManager().getImage(image).info.asyncUpload)
+            throw std::runtime_error("Async upload destinations have to be created with asyncUpload");
+        auto [stagingBuffer, stagingOffset] = stage(size, data);
+        m_imageUploads.push_back(ImageUpload{
+            .stagingBuffer = stagingBuffer,
+            .stagingOffset = stagingOffset,
+            .image = image,
+            .arrayLayer = arrayLayer
+        });
+        return { m_submittedValue + 1 };
+    }
+
+    void AsyncUploader::wait(UploadTicket ticket) {
+        if(isComplete(ticket))
+            return;
+        if(ticket.value > m_submittedValue)
+            submit();
+
+        vk::Semaphore semaphore = *m_semaphore;
+        auto result = Vulkan::getDevice().waitSemaphores(vk::SemaphoreWaitInfo{
+            .semaphoreCount = 1,
+            .pSemaphores = &semaphore,
+            .pValues = &ticket.value
+        }, UINT64_MAX);
+        if(result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to wait for async upload");
+        }
+        m_completedValue = std::max(m_completedValue, ticket.value);
+    }
+
+    void AsyncUploader::beginFrame() {
+        m_completedValue = m_semaphore.getCounterValue();
+        retireBatches();
+        submit();
+    }
+
+    void AsyncUploader::submit() {
+        if(m_bufferUploads.empty() && m_imageUploads.empty())
+            return;
+
+        vk::raii::CommandBuffer commandBuffer = nullptr;
+        if(!m_freeCommandBuffers.empty()) {
+            commandBuffer = std::move(m_freeCommandBuffers.back());
+            m_freeCommandBuffers.pop_back();
+            commandBuffer.reset();
+        } else {
+            commandBuffer = std::move(Vulkan::getDevice().allocateCommandBuffers({
+                .commandPool = *m_commandPool,
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1
+            }).front());
+        }
+
+        auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+        commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+        // Whole images are transitioned, uploads replace their contents
+        std::vector<ResourceRef> images;
+        for (const auto& upload: m_imageUploads) {
+            if(std::find(images.begin(), images.end(), upload.image) == images.end())
+                images.push_back(upload.image);
+        }
+        auto imageBarriers = [&](vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess) {
+            std::vector<vk::ImageMemoryBarrier> barriers;
+            for (ResourceRef ref: images) {
+                auto& image = resourceManager.getImage(ref);
+                barriers.push_back(vk::ImageMemoryBarrier{
+                    .srcAccessMask = srcAccess,
+                    .dstAccessMask = dstAccess,
+                    .oldLayout = oldLayout,
+                    .newLayout = newLayout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = *image.image,
+                    .subresourceRange = vk::ImageSubresourceRange{
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = image.info.arrayLayers
+                    }
+                });
+            }
+            return barriers;
+        };
+        if(!images.empty()) {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                                          imageBarriers(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                                                        vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite));
+        }
+
+        Batch batch{
+            .value = m_submittedValue + 1,
+            .commandBuffer = nullptr,
+            .ringEnd = m_ringHead
+        };
+        for (const auto& upload: m_bufferUploads) {
+            commandBuffer.copyBuffer(*resourceManager.getBuffer(upload.stagingBuffer).buffer, *resourceManager.getBuffer(upload.buffer).buffer,
+                                     vk::BufferCopy{ .srcOffset = upload.stagingOffset, .dstOffset = upload.offset, .size = upload.size });
+            if(upload.stagingBuffer != m_ring)
+                batch.overflowBuffers.push_back(upload.stagingBuffer);
+        }
+        for (const auto& upload: m_imageUploads) {
+            auto& image = resourceManager.getImage(upload.image);
+            vk::BufferImageCopy copyRegion{};
+            copyRegion.bufferOffset = upload.stagingOffset;
+            copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            copyRegion.imageSubresource.mipLevel = 0;
+            copyRegion.imageSubresource.baseArrayLayer = upload.arrayLayer;
+            copyRegion.imageSubresource.layerCount = 1;
+            copyRegion.imageExtent = vk::Extent3D{image.info.width, image.info.height, 1};
+            commandBuffer.copyBufferToImage(*resourceManager.getBuffer(upload.stagingBuffer).buffer, *image.image,
+                                            vk::ImageLayout::eTransferDstOptimal, copyRegion);
+            if(upload.stagingBuffer != m_ring)
+                batch.overflowBuffers.push_back(upload.stagingBuffer);
+        }
+
+        // The semaphore signal makes the writes available, the consuming queues' timeline waits make them visible
+        if(!images.empty()) {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {},
+                                          imageBarriers(vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                                        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone));
+        }
+        commandBuffer.end();
+
+        vk::CommandBuffer submitted = *commandBuffer;
+        vk::Semaphore semaphore = *m_semaphore;
+        vk::TimelineSemaphoreSubmitInfo timelineInfo{
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &batch.value
+        };
+        Vulkan::getTransferQueue().submit(vk::SubmitInfo{
+            .pNext = &timelineInfo,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &submitted,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &semaphore
+        });
+
+        m_submittedValue = batch.value;
+        batch.commandBuffer = std::move(commandBuffer);
+        m_batches.push_back(std::move(batch));
+        m_bufferUploads.clear();
+        m_imageUploads.clear();
+    }
+
+    void AsyncUploader::retireBatches() {
+        while(!m_batches.empty() && m_batches.front().value <= m_completedValue) {
+            auto& batch = m_batches.front();
+            for (ResourceRef buffer: batch.overflowBuffers)
+                RENDER_SYSTEM.getResourceManager().destroyBuffer(buffer);
+            m_ringTail = batch.ringEnd;
+            m_freeCommandBuffers.push_back(std::move(batch.commandBuffer));
+            m_batches.pop_front();
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ResourceManager.h"
+
+#include <deque>
+
+namespace vanguard {
+    // Identifies an async upload, complete once the uploader's timeline semaphore reaches its value
+    struct UploadTicket {
+        uint64_t value = 0;
+
+        // Default tickets refer to nothing and are always complete
+        [[nodiscard]] bool isValid() const { return value != 0; }
+    };
+
+    // Records copies on the transfer queue so large uploads don't land on the frame which requested them. Uploads are
+    // batched into one submission per frame, each signaling the next value of a timeline semaphore. Destinations have
+    // to be created with concurrent and asyncUpload set, they may only be used by the renderer once their ticket is
+    // complete, images end up in eShaderReadOnlyOptimal.
+    //
+    // Uploads are staged in a persistently mapped ring, space is handed back once the batch it was staged for has
+    // signaled its value. An upload which doesn't fit into the free part of the ring gets its own staging buffer.
+    class AsyncUploader {
+    public:
+        AsyncUploader() = default;
+
+        AsyncUploader(const AsyncUploader&) = delete;
+        AsyncUploader& operator=(const AsyncUploader&) = delete;
+
+        void init(vk::DeviceSize ringSize = ASYNC_STAGING_RING_SIZE);
+
+        [[nodiscard]] UploadTicket uploadBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data);
+        // The image's previous contents are discarded
+        [[nodiscard]] UploadTicket uploadImage(ResourceRef image, uint32_t size, const void* data, uint32_t arrayLayer = 0);
+
+        // Uses the completion state sampled at the start of the frame, so everything a frame sees as complete is
+        // covered by the timeline wait its submissions do
+        [[nodiscard]] bool isComplete(UploadTicket ticket) const { return ticket.value <= m_completedValue; }
+        // Blocks until the upload has finished, submitting it first if needed
+        void wait(UploadTicket ticket);
+
+        // Called once per frame after its fence wait, submits queued uploads and frees finished ones
+        void beginFrame();
+        // Value every frame submission waits on
+        [[nodiscard]] vk::Semaphore getSemaphore() const { return *m_semaphore; }
+        [[nodiscard]] uint64_t getCompletedValue() const { return m_completedValue; }
+    private:
+        struct BufferUpload {
+            ResourceRef stagingBuffer;
+            uint32_t stagingOffset;
+            ResourceRef buffer;
+            uint32_t offset;
+            uint32_t size;
+        };
+        struct ImageUpload {
+            ResourceRef stagingBuffer;
+            uint32_t stagingOffset;
+            ResourceRef image;
+            uint32_t arrayLayer;
+        };
+        struct Batch {
+            uint64_t value;
+            vk::raii::CommandBuffer commandBuffer;
+            // Ring position up to which the batch's uploads were staged
+            uint64_t ringEnd;
+            // Uploads which didn't fit into the ring
+            std::vector<ResourceRef> overflowBuffers;
+        };
+
+        // Copies the data into staging memory, returns the staging buffer and the offset it was written to
+        [[nodiscard]] std::pair<ResourceRef, uint32_t> stage(uint32_t size, const void* data);
+        void submit();
+        void retireBatches();
+    private:
+        vk::raii::Semaphore m_semaphore = nullptr;
+        vk::raii::CommandPool m_commandPool = nullptr;
+
+        ResourceRef m_ring = UNDEFINED_RESOURCE;
+        char* m_ringData = nullptr;
+        vk::DeviceSize m_ringSize = 0;
+        // Positions only ever grow and wrap around the ring, everything from the tail to the head is still in use
+        uint64_t m_ringHead = 0;
+        uint64_t m_ringTail = 0;
+
+        std::vector<BufferUpload> m_bufferUploads;
+        std::vector<ImageUpload> m_imageUploads;
+        // In submission order
+        std::deque<Batch> m_batches;
+        std::vector<vk::raii::CommandBuffer> m_freeCommandBuffers;
+
+        uint64_t m_submittedValue = 0;
+        uint64_t m_completedValue = 0;
+    };
+}
@@ -0,0 +1,143 @@
+#include "BindlessDescriptors.h"
+#include "ResourceManager.h"
+#include "../Application.h"
+
+#include <algorithm>
+#include <array>
+
+namespace vanguard {
+    static constexpr uint32_t MAX_IMAGES = 16384;
+    static constexpr uint32_t MAX_SAMPLERS = 256;
+    static constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+
+    uint32_t BindlessDescriptors::IndexAllocator::allocate() {
+        if(!m_freeIndices.empty()) {
+            uint32_t index = m_freeIndices.back();
+            m_freeIndices.pop_back();
+            return index;
+        }
+        if(m_next == m_capacity)
+            throw std::runtime_error("Bindless descriptor array is full");
+        return m_next++;
+    }
+
+    void BindlessDescriptors::IndexAllocator::recycle(uint64_t frame) {
+        std::erase_if(m_retiredIndices, [&](const auto& retired) {
+            if(retired.first + FRAMES_IN_FLIGHT > frame)
+                return false;
+            m_freeIndices.push_back(retired.second);
+            return true;
+        });
+    }
+
+    // Array sizes are clamped to what the device allows for update after bind sets
+    static std::array<uint32_t, 3> getCapacities() {
+        auto properties = Vulkan::getPhysicalDevice().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>()
+                .get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+        return {
+                std::min({ MAX_IMAGES, properties.maxPerStageDescriptorUpdateAfterBindSampledImages, properties.maxDescriptorSetUpdateAfterBindSampledImages }),
+                std::min({ MAX_SAMPLERS, properties.maxPerStageDescriptorUpdateAfterBindSamplers, properties.maxDescriptorSetUpdateAfterBindSamplers }),
+                std::min({ MAX_STORAGE_BUFFERS, properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, properties.maxDescriptorSetUpdateAfterBindStorageBuffers }),
+        };
+    }
+
+    BindlessDescriptors::BindlessDescriptors(DescriptorSetLayoutPool& layoutPool) {
+        if(!Vulkan::isBindlessSupported())
+            throw std::runtime_error("Bindless descriptors need descriptor indexing support");
+        auto [images, samplers, storageBuffers] = getCapacities();
+        m_images = IndexAllocator(images);
+        m_samplers = IndexAllocator(samplers);
+        m_storageBuffers = IndexAllocator(storageBuffers);
+
+        // Unused entries are never written, shaders may only index entries which were added
+        vk::DescriptorBindingFlags flags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+                vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+        m_layout = layoutPool.create(DescriptorSetLayoutInfo{
+                .bindings = {
+                        { .binding = IMAGE_BINDING, .type = vk::DescriptorType::eSampledImage, .count = m_images.getCapacity(), .flags = flags },
+                        { .binding = SAMPLER_BINDING, .type = vk::DescriptorType::eSampler, .count = m_samplers.getCapacity(), .flags = flags },
+                        { .binding = STORAGE_BUFFER_BINDING, .type = vk::DescriptorType::eStorageBuffer, .count = m_storageBuffers.getCapacity(), .flags = flags },
+                }
+        });
+
+        std::array<vk::DescriptorPoolSize, 3> poolSizes = {{
+                { .type = vk::DescriptorType::eSampledImage, .descriptorCount = m_images.getCapacity() },
+                { .type = vk::DescriptorType::eSampler, .descriptorCount = m_samplers.getCapacity() },
+                { .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = m_storageBuffers.getCapacity() },
+        }};
+        m_pool = Vulkan::getDevice().createDescriptorPool(vk::DescriptorPoolCreateInfo{
+                .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+                .maxSets = 1,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data()
+        });
+        vk::DescriptorSetLayout layout = *layoutPool.get(m_layout).layout;
+        m_set = (*Vulkan::getDevice()).allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+                .descriptorPool = *m_pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &layout
+        }).front();
+
+        INFO("Bindless descriptors: {} images, {} samplers, {} storage buffers", m_images.getCapacity(), m_samplers.getCapacity(),
+             m_storageBuffers.getCapacity());
+    }
+
+    // Writing an index no frame in flight uses is allowed while the set is bound, so this doesn't have to be deferred
+    uint32_t BindlessDescriptors::addImage(ResourceRef image) {
+        uint32_t index = m_images.allocate();
+        vk::DescriptorImageInfo imageInfo{
+                .imageView = *RENDER_SYSTEM.getResourceManager().getImage(image).view,
+                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+        };
+        Vulkan::getDevice().updateDescriptorSets(vk::WriteDescriptorSet{
+                .dstSet = m_set,
+                .dstBinding = IMAGE_BINDING,
+                .dstArrayElement = index,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eSampledImage,
+                .pImageInfo = &imageInfo
+        }, {});
+        return index;
+    }
+
+    uint32_t BindlessDescriptors::addSampler(ResourceRef sampler) {
+        uint32_t index = m_samplers.allocate();
+        vk::DescriptorImageInfo samplerInfo{
+                .sampler = *RENDER_SYSTEM.getResourceManager().getSampler(sampler).sampler
+        };
+        Vulkan::getDevice().updateDescriptorSets(vk::WriteDescriptorSet{
+                .dstSet = m_set,
+                .dstBinding = SAMPLER_BINDING,
+                .dstArrayElement = index,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eSampler,
+                .pImageInfo = &samplerInfo
+        }, {});
+        return index;
+    }
+
+    uint32_t BindlessDescriptors::addStorageBuffer(ResourceRef buffer, vk::DeviceSize offset, vk::DeviceSize size) {
+        uint32_t index = m_storageBuffers.allocate();
+        vk::DescriptorBufferInfo bufferInfo{
+                .buffer = *RENDER_SYSTEM.getResourceManager().getBuffer(buffer).buffer,
+                .offset = offset,
+                .range = size
+        };
+        Vulkan::getDevice().updateDescriptorSets(vk::WriteDescriptorSet{
+                .dstSet = m_set,
+                .dstBinding = STORAGE_BUFFER_BINDING,
+                .dstArrayElement = index,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &bufferInfo
+        }, {});
+        return index;
+    }
+
+    void BindlessDescriptors::nextFrame() {
+        m_frame++;
+        m_images.recycle(m_frame);
+        m_samplers.recycle(m_frame);
+        m_storageBuffers.recycle(m_frame);
+    }
+}
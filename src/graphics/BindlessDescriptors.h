@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Vulkan.h"
+
+#include <vector>
+
+namespace vanguard {
+    typedef uint32_t ResourceRef;
+    class DescriptorSetLayoutPool;
+
+    // One global set of partially bound descriptor arrays which shaders index into, so differently textured draws
+    // don't need their own sets. Binding 0 holds sampled images, 1 samplers and 2 storage buffers. Indices are stable
+    // for the lifetime of the resource and only reused once the frames in flight are done with them.
+    // Only usable when Vulkan::isBindlessSupported.
+    class BindlessDescriptors {
+    public:
+        static constexpr uint32_t IMAGE_BINDING = 0;
+        static constexpr uint32_t SAMPLER_BINDING = 1;
+        static constexpr uint32_t STORAGE_BUFFER_BINDING = 2;
+        static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+        explicit BindlessDescriptors(DescriptorSetLayoutPool& layoutPool);
+
+        // The image is expected to be in eShaderReadOnlyOptimal when sampled. Resizing the image invalidates its entry.
+        [[nodiscard]] uint32_t addImage(ResourceRef image);
+        [[nodiscard]] uint32_t addSampler(ResourceRef sampler);
+        [[nodiscard]] uint32_t addStorageBuffer(ResourceRef buffer, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+        void removeImage(uint32_t index) { m_images.remove(index, m_frame); }
+        void removeSampler(uint32_t index) { m_samplers.remove(index, m_frame); }
+        void removeStorageBuffer(uint32_t index) { m_storageBuffers.remove(index, m_frame); }
+
+        // Called once the next frame's fence has been waited on
+        void nextFrame();
+
+        [[nodiscard]] ResourceRef getLayout() const { return m_layout; }
+        [[nodiscard]] vk::DescriptorSet getDescriptorSet() const { return m_set; }
+    private:
+        class IndexAllocator {
+        public:
+            IndexAllocator() = default;
+            explicit IndexAllocator(uint32_t capacity) : m_capacity(capacity) {}
+
+            [[nodiscard]] uint32_t allocate();
+            void remove(uint32_t index, uint64_t frame) { m_retiredIndices.emplace_back(frame, index); }
+            void recycle(uint64_t frame);
+
+            [[nodiscard]] uint32_t getCapacity() const { return m_capacity; }
+        private:
+            uint32_t m_capacity = 0;
+            uint32_t m_next = 0;
+            std::vector<uint32_t> m_freeIndices;
+            std::vector<std::pair<uint64_t, uint32_t>> m_retiredIndices;
+        };
+    private:
+        IndexAllocator m_images;
+        IndexAllocator m_samplers;
+        IndexAllocator m_storageBuffers;
+        uint64_t m_frame = 0;
+
+        ResourceRef m_layout;
+        vk::raii::DescriptorPool m_pool = nullptr;
+        // Freed with the pool
+        vk::DescriptorSet m_set;
+    };
+}
@@ -15,22 +15,26 @@ namespace vanguard {
             m_size = other.m_size;
             m_stride = other.m_stride;
             m_perFrame = other.m_perFrame;
+            m_mappedData = other.m_mappedData;
 
             other.m_buffer = UNDEFINED_RESOURCE;
             other.m_size = 0;
             other.m_stride = 0;
             other.m_perFrame = false;
+            other.m_mappedData = nullptr;
         }
         UniformBuffer& operator=(UniformBuffer&& other) noexcept {
             m_buffer = other.m_buffer;
             m_size = other.m_size;
             m_stride = other.m_stride;
             m_perFrame = other.m_perFrame;
+            m_mappedData = other.m_mappedData;
 
             other.m_buffer = UNDEFINED_RESOURCE;
             other.m_size = 0;
             other.m_stride = 0;
             other.m_perFrame = false;
+            other.m_mappedData = nullptr;
 
             return *this;
         }
@@ -41,18 +45,38 @@ namespace vanguard {
             m_stride = Vulkan::padUniformBufferSize(sizeof(T));
             m_size = perFrame ? m_stride * FRAMES_IN_FLIGHT : m_stride;
 
+            // Per frame buffers are written in place when small enough for where host visible memory lives, each
+            // frame in flight has its own slice so it's safe once the frame's fence has been waited on
+            uint32_t maxHostSize = Vulkan::getHostVisibleDeviceLocalSize() > 0 ? HOST_UNIFORM_BUFFER_MAX_SIZE : HOST_UNIFORM_BUFFER_MAX_SYSTEM_SIZE;
+            bool hostWritten = perFrame && m_size <= maxHostSize;
+
             BufferInfo bufferInfo = {};
             bufferInfo.size = m_size;
-            bufferInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst;
             bufferInfo.memoryUsage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO;
-            //bufferInfo.memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
-            bufferInfo.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            if(hostWritten) {
+                bufferInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer;
+                bufferInfo.memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+                bufferInfo.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+                bufferInfo.preferredMemoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            } else {
+                bufferInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst;
+                bufferInfo.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            }
+            bufferInfo.concurrent = true;
+            bufferInfo.name = "uniform buffer";
             m_buffer = RENDER_SYSTEM.getResourceManager().createBuffer(bufferInfo);
+            if(hostWritten)
+                m_mappedData = static_cast<char*>(RENDER_SYSTEM.getResourceManager().getBuffer(m_buffer).allocation.allocationInfo.pMappedData);
         }
 
+        // Host written buffers must only be updated after RenderSystem::waitForFrame, as the application loop does
         template <typename T>
         void update(const T& data) {
             uint32_t offset = m_perFrame ? m_stride * RENDER_SYSTEM.getFrameIndex() : 0;
+            if(m_mappedData) {
+                memcpy(m_mappedData + offset, &data, sizeof(T));
+                return;
+            }
             RENDER_SYSTEM.getStager().updateBuffer(m_buffer, offset, m_stride, &data);
         }
 
@@ -60,11 +84,14 @@ namespace vanguard {
         [[nodiscard]] uint32_t getSize() const { return m_size; }
         [[nodiscard]] uint32_t getStride() const { return m_stride; }
         [[nodiscard]] bool isPerFrame() const { return m_perFrame; }
+        // Written in place by the CPU instead of through the stager
+        [[nodiscard]] bool isHostWritten() const { return m_mappedData != nullptr; }
     private:
         ResourceRef m_buffer = UNDEFINED_RESOURCE;
         uint32_t m_size = 0;
         uint32_t m_stride = 0;
         bool m_perFrame = false;
+        char* m_mappedData = nullptr;
     };
 
     class VertexBuffer {
@@ -81,8 +108,11 @@ namespace vanguard {
             bufferInfo.size = m_size;
             bufferInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
             bufferInfo.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            bufferInfo.concurrent = true;
+            bufferInfo.asyncUpload = true;
+            bufferInfo.name = "vertex buffer";
             m_buffer = RENDER_SYSTEM.getResourceManager().createBuffer(bufferInfo);
-            RENDER_SYSTEM.getStager().updateBuffer(m_buffer, 0, m_size, vertices.data());
+            m_uploadTicket = RENDER_SYSTEM.getAsyncUploader().uploadBuffer(m_buffer, 0, m_size, vertices.data());
         }
 
         void bind(vk::CommandBuffer cmd) const {
@@ -91,80 +121,138 @@ namespace vanguard {
 
         [[nodiscard]] ResourceRef getBuffer() const { return m_buffer; }
         [[nodiscard]] uint32_t getSize() const { return m_size; }
+        // Vertices are uploaded asynchronously, the buffer mustn't be bound before it's ready
+        [[nodiscard]] UploadTicket getUploadTicket() const { return m_uploadTicket; }
+        [[nodiscard]] bool isReady() const { return RENDER_SYSTEM.getAsyncUploader().isComplete(m_uploadTicket); }
     private:
         ResourceRef m_buffer = UNDEFINED_RESOURCE;
         uint32_t m_size = 0;
+        UploadTicket m_uploadTicket{};
     };
 
-//    class UniformStorageBuffer {
-//    public:
-//        UniformStorageBuffer() = default;
-//        UniformStorageBuffer(const UniformStorageBuffer&) = delete;
-//        UniformStorageBuffer& operator=(const UniformStorageBuffer&) = delete;
-//
-//        UniformStorageBuffer(UniformStorageBuffer&& other) noexcept {
-//            m_buffer = other.m_buffer;
-//            m_size = other.m_size;
-//            m_stride = other.m_stride;
-//            m_perFrame = other.m_perFrame;
-//
-//            other.m_buffer = UNDEFINED_RESOURCE;
-//            other.m_size = 0;
-//            other.m_stride = 0;
-//            other.m_perFrame = false;
-//        }
-//        UniformStorageBuffer& operator=(UniformStorageBuffer&& other) noexcept {
-//            m_buffer = other.m_buffer;
-//            m_size = other.m_size;
-//            m_stride = other.m_stride;
-//            m_perFrame = other.m_perFrame;
-//
-//            other.m_buffer = UNDEFINED_RESOURCE;
-//            other.m_size = 0;
-//            other.m_stride = 0;
-//            other.m_perFrame = false;
-//
-//            return *this;
-//        }
-//
-//        template <typename T>
-//        void create(bool perFrame, uint32_t initialCount = 0) {
-//            m_perFrame = perFrame;
-//            m_stride = Vulkan::padUniformBufferSize(sizeof(T));
-//            m_size = perFrame ? m_stride * initialCount * FRAMES_IN_FLIGHT : m_stride;
-//            m_count = initialCount;
-//
-//            if(m_count > 0) {
-//                BufferInfo bufferInfo = {};
-//                bufferInfo.size = m_size;
-//                bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
-//                bufferInfo.memoryUsage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO;
-//                bufferInfo.memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
-//                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
-//                m_buffer = RENDER_SYSTEM.getResourceManager().createBuffer(bufferInfo);
-//            }
-//        }
-//
-//        template <typename T>
-//        void update(const T& data) {
-//            uint32_t offset = m_perFrame ? m_stride * RENDER_SYSTEM.getFrameIndex() : 0;
-//            RENDER_SYSTEM.getStager().updateBuffer(m_buffer, offset, m_stride, &data);
-//        }
-//
-//        void setAssociatedDescriptorSet(ResourceRef descriptorSet) {
-//            m_descriptorSet = descriptorSet;
-//        }
-//    private:
-//        template <typename T>
-//        void resizeBuffer(uint32_t newCount) {
-//
-//        }
-//    private:
-//        ResourceRef m_buffer = UNDEFINED_RESOURCE;
-//        ResourceRef m_descriptorSet = UNDEFINED_RESOURCE;
-//        uint32_t m_size = 0;
-//        uint32_t m_stride = 0;
-//        uint32_t m_count = 0;
-//        bool m_perFrame = false;
-//    };
+    // Storage buffer holding an array of T, per frame buffers keep FRAMES_IN_FLIGHT copies side by side. Grows when
+    // updated with more elements than it fits, descriptor sets registered with it are rewritten when it does.
+    class UniformStorageBuffer {
+    public:
+        UniformStorageBuffer() = default;
+        UniformStorageBuffer(const UniformStorageBuffer&) = delete;
+        UniformStorageBuffer& operator=(const UniformStorageBuffer&) = delete;
+
+        UniformStorageBuffer(UniformStorageBuffer&& other) noexcept {
+            m_buffer = other.m_buffer;
+            m_size = other.m_size;
+            m_stride = other.m_stride;
+            m_elementSize = other.m_elementSize;
+            m_count = other.m_count;
+            m_perFrame = other.m_perFrame;
+            m_descriptorBindings = std::move(other.m_descriptorBindings);
+
+            other.m_buffer = UNDEFINED_RESOURCE;
+            other.m_size = 0;
+            other.m_stride = 0;
+            other.m_elementSize = 0;
+            other.m_count = 0;
+            other.m_perFrame = false;
+            other.m_descriptorBindings.clear();
+        }
+        UniformStorageBuffer& operator=(UniformStorageBuffer&& other) noexcept {
+            m_buffer = other.m_buffer;
+            m_size = other.m_size;
+            m_stride = other.m_stride;
+            m_elementSize = other.m_elementSize;
+            m_count = other.m_count;
+            m_perFrame = other.m_perFrame;
+            m_descriptorBindings = std::move(other.m_descriptorBindings);
+
+            other.m_buffer = UNDEFINED_RESOURCE;
+            other.m_size = 0;
+            other.m_stride = 0;
+            other.m_elementSize = 0;
+            other.m_count = 0;
+            other.m_perFrame = false;
+            other.m_descriptorBindings.clear();
+
+            return *this;
+        }
+
+        template <typename T>
+        void create(uint32_t initialCount = 1, bool perFrame = false) {
+            m_perFrame = perFrame;
+            m_elementSize = sizeof(T);
+            m_count = std::max(initialCount, 1u);
+            m_stride = Vulkan::padStorageBufferSize(m_elementSize * m_count);
+            m_size = perFrame ? m_stride * FRAMES_IN_FLIGHT : m_stride;
+
+            BufferInfo bufferInfo = {};
+            bufferInfo.size = m_size;
+            bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+            bufferInfo.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            bufferInfo.concurrent = true;
+            bufferInfo.name = "storage buffer";
+            m_buffer = RENDER_SYSTEM.getResourceManager().createBuffer(bufferInfo);
+        }
+
+        template <typename T>
+        void update(const std::vector<T>& data) {
+            reserve(static_cast<uint32_t>(data.size()));
+            uint32_t offset = m_perFrame ? m_stride * RENDER_SYSTEM.getFrameIndex() : 0;
+            RENDER_SYSTEM.getStager().updateBuffer(m_buffer, offset, sizeof(T) * data.size(), data.data());
+        }
+
+        // Grows to at least count elements, doubling to keep regrowth rare. Frames in flight keep the old buffer
+        // until they finish, each frame's descriptor sets switch over before it's next recorded. Contents written
+        // by the GPU are lost.
+        void reserve(uint32_t count) {
+            if(count <= m_count) return;
+
+            m_count = std::max(count, m_count * 2);
+            m_stride = Vulkan::padStorageBufferSize(m_elementSize * m_count);
+            m_size = m_perFrame ? m_stride * FRAMES_IN_FLIGHT : m_stride;
+
+            RENDER_SYSTEM.getResourceManager().resizeBuffer(m_buffer, m_size);
+            for (const auto& binding: m_descriptorBindings) {
+                RENDER_SYSTEM.updateDescriptorSetForFrame(binding.frame, binding.descriptorSet, { getDescriptorWrite(binding.binding, binding.frame) });
+            }
+        }
+
+        // Descriptor sets pointing at this buffer, rewritten whenever the buffer grows
+        void addDescriptorSet(ResourceRef descriptorSet, uint32_t binding, uint32_t frame) {
+            m_descriptorBindings.push_back(DescriptorBinding{ descriptorSet, binding, frame });
+        }
+        void removeDescriptorSet(ResourceRef descriptorSet) {
+            std::erase_if(m_descriptorBindings, [&](const DescriptorBinding& binding) { return binding.descriptorSet == descriptorSet; });
+        }
+
+        [[nodiscard]] DescriptorSetWrite getDescriptorWrite(uint32_t binding, uint32_t frame) const {
+            return DescriptorSetWrite{
+                    .binding = binding,
+                    .type = vk::DescriptorType::eStorageBuffer,
+                    .buffer = DescriptorBufferInfo{
+                            .buffer = m_buffer,
+                            .offset = m_perFrame ? m_stride * frame : 0,
+                            .size = m_stride
+                    }
+            };
+        }
+
+        [[nodiscard]] ResourceRef getBuffer() const { return m_buffer; }
+        [[nodiscard]] uint32_t getSize() const { return m_size; }
+        [[nodiscard]] uint32_t getStride() const { return m_stride; }
+        [[nodiscard]] uint32_t getCount() const { return m_count; }
+        [[nodiscard]] bool isPerFrame() const { return m_perFrame; }
+    private:
+        struct DescriptorBinding {
+            ResourceRef descriptorSet;
+            uint32_t binding;
+            uint32_t frame;
+        };
+
+        ResourceRef m_buffer = UNDEFINED_RESOURCE;
+        uint32_t m_size = 0;
+        uint32_t m_stride = 0;
+        uint32_t m_elementSize = 0;
+        uint32_t m_count = 0;
+        bool m_perFrame = false;
+        std::vector<DescriptorBinding> m_descriptorBindings;
+    };
 }
\ No newline at end of file
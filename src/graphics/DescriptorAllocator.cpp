@@ -0,0 +1,70 @@
+#include "DescriptorAllocator.h"
+#include "../Logger.h"
+
+#include <array>
+
+namespace vanguard {
+    static constexpr uint32_t INITIAL_POOL_SETS = 64;
+    static constexpr uint32_t MAX_POOL_SETS = 4096;
+
+    // Descriptors of each type reserved per set in a pool
+    static constexpr std::array<std::pair<vk::DescriptorType, uint32_t>, 9> POOL_DESCRIPTORS_PER_SET = {{
+            { vk::DescriptorType::eUniformBuffer, 2 },
+            { vk::DescriptorType::eStorageBuffer, 2 },
+            { vk::DescriptorType::eCombinedImageSampler, 4 },
+            { vk::DescriptorType::eSampledImage, 1 },
+            { vk::DescriptorType::eSampler, 1 },
+            { vk::DescriptorType::eStorageImage, 1 },
+            { vk::DescriptorType::eInputAttachment, 1 },
+            { vk::DescriptorType::eUniformBufferDynamic, 1 },
+            { vk::DescriptorType::eStorageBufferDynamic, 1 },
+    }};
+
+    // Tries every pool starting at the current one before growing the chain, sets freed from earlier pools make room
+    // there again
+    template <typename F>
+    auto DescriptorAllocator::allocateFromPools(F&& allocate) {
+        for (uint32_t attempt = 0; ; attempt++) {
+            uint32_t createdSets = 0;
+            if(attempt >= m_pools.size()) {
+                createdSets = createPool();
+                m_currentPool = static_cast<uint32_t>(m_pools.size() - 1);
+            }
+            try {
+                return allocate(m_pools[m_currentPool]);
+            } catch (const vk::OutOfPoolMemoryError&) {
+            } catch (const vk::FragmentedPoolError&) {
+            }
+            if(createdSets == MAX_POOL_SETS)
+                throw std::runtime_error("Descriptor sets don't fit into an empty descriptor pool");
+            if(attempt + 1 < m_pools.size())
+                m_currentPool = (m_currentPool + 1) % m_pools.size();
+        }
+    }
+
+    std::vector<vk::raii::DescriptorSet> DescriptorAllocator::allocate(const std::vector<vk::DescriptorSetLayout>& layouts) {
+        return allocateFromPools([&](const vk::raii::DescriptorPool& pool) {
+            return Vulkan::getDevice().allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+                    .descriptorPool = *pool,
+                    .descriptorSetCount = static_cast<uint32_t>(layouts.size()),
+                    .pSetLayouts = layouts.data()
+            });
+        });
+    }
+
+    uint32_t DescriptorAllocator::createPool() {
+        uint32_t maxSets = std::min(INITIAL_POOL_SETS << std::min<size_t>(m_pools.size(), 16), MAX_POOL_SETS);
+        std::vector<vk::DescriptorPoolSize> poolSizes;
+        for (const auto& [type, count]: POOL_DESCRIPTORS_PER_SET) {
+            poolSizes.push_back(vk::DescriptorPoolSize{ .type = type, .descriptorCount = count * maxSets });
+        }
+        m_pools.push_back(Vulkan::getDevice().createDescriptorPool(vk::DescriptorPoolCreateInfo{
+                .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                .maxSets = maxSets,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data(),
+        }));
+        DEBUG("Added descriptor pool {} with {} sets", m_pools.size(), maxSets);
+        return maxSets;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Vulkan.h"
+
+#include <vector>
+
+namespace vanguard {
+    // Allocates descriptor sets from a chain of pools. When every pool is exhausted another one twice the size of the
+    // last is added, so the allocator never runs out and rebakes don't fragment a single pool. Sets free themselves
+    // when destroyed. Not thread safe.
+    class DescriptorAllocator {
+    public:
+        DescriptorAllocator() = default;
+
+        // One set per layout, allocated in a single call
+        [[nodiscard]] std::vector<vk::raii::DescriptorSet> allocate(const std::vector<vk::DescriptorSetLayout>& layouts);
+    private:
+        template <typename F>
+        auto allocateFromPools(F&& allocate);
+        // Returns the number of sets the new pool holds
+        uint32_t createPool();
+    private:
+        std::vector<vk::raii::DescriptorPool> m_pools;
+        uint32_t m_currentPool = 0;
+    };
+}
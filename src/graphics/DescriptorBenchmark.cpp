@@ -0,0 +1,93 @@
+#include "DescriptorBenchmark.h"
+#include "ResourceManager.h"
+#include "../Application.h"
+#include "../util/Timer.h"
+
+namespace vanguard {
+    static constexpr vk::DeviceSize BENCHMARK_STRIDE = 256;
+
+    // Per draw writes, each draw points at its own slice of the buffer
+    static std::vector<DescriptorSetWrite> getDrawWrites(ResourceRef buffer, uint32_t draw) {
+        return {
+                DescriptorSetWrite{
+                        .binding = 0,
+                        .type = vk::DescriptorType::eUniformBuffer,
+                        .buffer = DescriptorBufferInfo{ .buffer = buffer, .offset = draw * BENCHMARK_STRIDE, .size = BENCHMARK_STRIDE }
+                },
+                DescriptorSetWrite{
+                        .binding = 1,
+                        .type = vk::DescriptorType::eStorageBuffer,
+                        .buffer = DescriptorBufferInfo{ .buffer = buffer, .offset = draw * BENCHMARK_STRIDE, .size = BENCHMARK_STRIDE }
+                },
+        };
+    }
+
+    static void logResult(const char* name, float millis, uint32_t draws) {
+        INFO("Descriptor benchmark, {}: {:.1f}ns per draw ({:.3f}ms for {} draws)", name, millis * 1e6f / static_cast<float>(draws), millis, draws);
+    }
+
+    void benchmarkDescriptorUpdates(uint32_t draws) {
+        auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+        std::vector<DescriptorSetBinding> bindings = {
+                { .binding = 0, .type = vk::DescriptorType::eUniformBuffer },
+                { .binding = 1, .type = vk::DescriptorType::eStorageBuffer },
+        };
+        ResourceRef buffer = resourceManager.createBuffer(BufferInfo{
+                .size = draws * BENCHMARK_STRIDE,
+                .usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+        });
+        ResourceRef layout = resourceManager.createDescriptorSetLayout({ .bindings = bindings });
+
+        // Build the writes up front so only the descriptor work is measured
+        std::vector<std::vector<DescriptorSetWrite>> writes;
+        writes.reserve(draws);
+        for (uint32_t draw = 0; draw < draws; draw++)
+            writes.push_back(getDrawWrites(buffer, draw));
+
+        {
+            Timer timer;
+            std::vector<ResourceRef> sets = resourceManager.createDescriptorSets({ .layout = layout }, draws);
+            for (uint32_t draw = 0; draw < draws; draw++)
+                resourceManager.updateDescriptorSet(sets[draw], writes[draw]);
+            logResult("allocate and update a set", timer.elapsedMillis(), draws);
+
+            // The templates are warm now, so this is the steady state cost of rewriting persistent sets
+            timer.reset();
+            for (uint32_t draw = 0; draw < draws; draw++)
+                resourceManager.updateDescriptorSet(sets[draw], writes[draw]);
+            logResult("update a set through its template", timer.elapsedMillis(), draws);
+
+            for (ResourceRef set: sets)
+                resourceManager.destroyDescriptorSet(set);
+        }
+
+        if(Vulkan::isPushDescriptorSupported()) {
+            auto& device = Vulkan::getDevice();
+            ResourceRef pushLayout = resourceManager.createDescriptorSetLayout({ .bindings = bindings, .pushDescriptor = true });
+            vk::DescriptorSetLayout setLayout = *resourceManager.getDescriptorSetLayout(pushLayout).layout;
+            vk::raii::PipelineLayout pipelineLayout = device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+                    .setLayoutCount = 1,
+                    .pSetLayouts = &setLayout
+            });
+            vk::raii::CommandPool commandPool = device.createCommandPool({ .queueFamilyIndex = Vulkan::getQueueFamilyIndex() });
+            vk::raii::CommandBuffer commandBuffer = std::move(device.allocateCommandBuffers({
+                    .commandPool = *commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = 1
+            }).front());
+
+            // Only recorded, never submitted
+            commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+            Timer timer;
+            for (uint32_t draw = 0; draw < draws; draw++)
+                ResourceManager::cmdPushDescriptorSet(*commandBuffer, vk::PipelineBindPoint::eGraphics, *pipelineLayout, 0, writes[draw]);
+            logResult("push descriptors", timer.elapsedMillis(), draws);
+            commandBuffer.end();
+
+            resourceManager.destroyDescriptorSetLayout(pushLayout);
+        }
+
+        resourceManager.destroyDescriptorSetLayout(layout);
+        resourceManager.destroyBuffer(buffer);
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vanguard {
+    // Logs the CPU cost per draw of the ways a draw can get its own small set of bindings: allocating and writing a
+    // set, rewriting a persistent set through its update template, and pushing descriptors into a command buffer.
+    // Run at startup when built with VANGUARD_BENCHMARK_DESCRIPTORS, after the render system has been initialized.
+    void benchmarkDescriptorUpdates(uint32_t draws);
+}
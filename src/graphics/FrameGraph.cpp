@@ -1,40 +1,120 @@
 #include "FrameGraph.h"
 #include "../Application.h"
+#include "../util/Timer.h"
 #include "../util/TypeTraits.h"
 
+#include <numeric>
+
 namespace vanguard {
     FrameGraph::~FrameGraph() {
         for (auto& image : m_images) {
             RENDER_SYSTEM.getResourceManager().destroyImage(image);
         }
+        for (auto& memory : m_memory) {
+            RENDER_SYSTEM.getResourceManager().destroyMemory(memory);
+        }
+        for (auto& buffer : m_buffers) {
+            RENDER_SYSTEM.getResourceManager().destroyBuffer(buffer);
+        }
+        for (auto& [storageBuffer, descriptorSet] : m_storageBufferBindings) {
+            storageBuffer->removeDescriptorSet(descriptorSet);
+        }
+        for (auto& sampler : m_samplers) {
+            RENDER_SYSTEM.getResourceManager().destroySampler(sampler);
+        }
         for (auto& pipeline : m_pipelines) {
             RENDER_SYSTEM.getResourceManager().destroyRenderPipeline(pipeline);
         }
+        for (auto& pipeline : m_computePipelines) {
+            RENDER_SYSTEM.getResourceManager().destroyComputePipeline(pipeline);
+        }
         if(!m_descriptorSets.empty()) {
             for (auto& [location, descriptorSet]: m_descriptorSets) {
                 descriptorSet.destroy();
             }
         }
+        if(m_emptyDescriptorSetLayout != UNDEFINED_RESOURCE) {
+            RENDER_SYSTEM.getResourceManager().destroyDescriptorSetLayout(m_emptyDescriptorSetLayout);
+        }
+        if(m_pushDescriptorSetLayout != UNDEFINED_RESOURCE) {
+            RENDER_SYSTEM.getResourceManager().destroyDescriptorSetLayout(m_pushDescriptorSetLayout);
+        }
     }
 
     FrameGraph::FrameGraph(FrameGraph&& other) noexcept {
         m_commands = std::move(other.m_commands);
         m_images = std::move(other.m_images);
         other.m_images.clear();
+        m_memory = std::move(other.m_memory);
+        other.m_memory.clear();
+        m_buffers = std::move(other.m_buffers);
+        other.m_buffers.clear();
+        m_storageBufferBindings = std::move(other.m_storageBufferBindings);
+        other.m_storageBufferBindings.clear();
+        m_samplers = std::move(other.m_samplers);
+        other.m_samplers.clear();
         m_pipelines = std::move(other.m_pipelines);
         other.m_pipelines.clear();
+        m_computePipelines = std::move(other.m_computePipelines);
+        other.m_computePipelines.clear();
         m_descriptorSets = std::move(other.m_descriptorSets);
         other.m_descriptorSets.clear();
+        m_descriptorWrites = std::move(other.m_descriptorWrites);
+        other.m_descriptorWrites.clear();
+        m_swapchainImages = std::move(other.m_swapchainImages);
+        other.m_swapchainImages.clear();
+        m_pipelineExtents = std::move(other.m_pipelineExtents);
+        other.m_pipelineExtents.clear();
+        m_emptyDescriptorSetLayout = other.m_emptyDescriptorSetLayout;
+        other.m_emptyDescriptorSetLayout = UNDEFINED_RESOURCE;
+        m_pushDescriptorSetLayout = other.m_pushDescriptorSetLayout;
+        other.m_pushDescriptorSetLayout = UNDEFINED_RESOURCE;
+        m_passData = std::move(other.m_passData);
+        other.m_passData.clear();
+        m_exportedImages = std::move(other.m_exportedImages);
+        other.m_exportedImages.clear();
+        m_exportedBuffers = std::move(other.m_exportedBuffers);
+        other.m_exportedBuffers.clear();
+        m_passSchedule = std::move(other.m_passSchedule);
+        other.m_passSchedule.clear();
     }
 
     FrameGraph& FrameGraph::operator=(FrameGraph&& other) noexcept {
         m_commands = std::move(other.m_commands);
         m_images = std::move(other.m_images);
         other.m_images.clear();
+        m_memory = std::move(other.m_memory);
+        other.m_memory.clear();
+        m_buffers = std::move(other.m_buffers);
+        other.m_buffers.clear();
+        m_storageBufferBindings = std::move(other.m_storageBufferBindings);
+        other.m_storageBufferBindings.clear();
+        m_samplers = std::move(other.m_samplers);
+        other.m_samplers.clear();
         m_pipelines = std::move(other.m_pipelines);
         other.m_pipelines.clear();
+        m_computePipelines = std::move(other.m_computePipelines);
+        other.m_computePipelines.clear();
         m_descriptorSets = std::move(other.m_descriptorSets);
         other.m_descriptorSets.clear();
+        m_descriptorWrites = std::move(other.m_descriptorWrites);
+        other.m_descriptorWrites.clear();
+        m_swapchainImages = std::move(other.m_swapchainImages);
+        other.m_swapchainImages.clear();
+        m_pipelineExtents = std::move(other.m_pipelineExtents);
+        other.m_pipelineExtents.clear();
+        m_emptyDescriptorSetLayout = other.m_emptyDescriptorSetLayout;
+        other.m_emptyDescriptorSetLayout = UNDEFINED_RESOURCE;
+        m_pushDescriptorSetLayout = other.m_pushDescriptorSetLayout;
+        other.m_pushDescriptorSetLayout = UNDEFINED_RESOURCE;
+        m_passData = std::move(other.m_passData);
+        other.m_passData.clear();
+        m_exportedImages = std::move(other.m_exportedImages);
+        other.m_exportedImages.clear();
+        m_exportedBuffers = std::move(other.m_exportedBuffers);
+        other.m_exportedBuffers.clear();
+        m_passSchedule = std::move(other.m_passSchedule);
+        other.m_passSchedule.clear();
         return *this;
     }
 
@@ -54,6 +134,14 @@ namespace vanguard {
         };
     }
 
+    FGBResourceRef FrameGraphBuilder::createBuffer(const vanguard::FGBBufferInfo& info) {
+        m_buffers.push_back(info);
+        return {
+            FGBResourceType::Buffer,
+            static_cast<uint32_t>(m_buffers.size() - 1)
+        };
+    }
+
     FGBResourceRef FrameGraphBuilder::addRenderPass(const vanguard::FGBRenderPassInfo& info) {
         m_passes.emplace_back(info);
         return {
@@ -78,6 +166,30 @@ namespace vanguard {
         };
     }
 
+    FGBResourceRef FrameGraphBuilder::addUniformStorageBuffer(uint32_t location, uint32_t binding, FGBResourceRef buffer) {
+        m_uniforms.emplace_back(FGBUniformStorageBufferInfo{
+            .location = location,
+            .binding = binding,
+            .buffer = buffer
+        });
+        return {
+            FGBResourceType::UniformStorageBuffer,
+            static_cast<uint32_t>(m_uniforms.size() - 1)
+        };
+    }
+
+    FGBResourceRef FrameGraphBuilder::addUniformStorageBuffer(uint32_t location, uint32_t binding, vanguard::UniformStorageBuffer* buffer) {
+        m_uniforms.emplace_back(FGBUniformStorageBufferInfo{
+            .location = location,
+            .binding = binding,
+            .storageBuffer = buffer
+        });
+        return {
+            FGBResourceType::UniformStorageBuffer,
+            static_cast<uint32_t>(m_uniforms.size() - 1)
+        };
+    }
+
     FGBResourceRef FrameGraphBuilder::addUniformSampledImage(uint32_t location, uint32_t binding, FGBResourceRef image, const SamplerInfo& samplerInfo) {
         m_uniforms.emplace_back(FGBUniformSampledImageInfo{
             .location = location,
@@ -114,10 +226,77 @@ namespace vanguard {
         };
     }
 
+    FGBResourceRef FrameGraphBuilder::addUniformTransientBuffer(uint32_t location, uint32_t binding, uint32_t range) {
+        if(range == 0 || range > TRANSIENT_BUFFER_MAX_RANGE)
+            throw std::runtime_error("Transient buffer range has to be between 1 and TRANSIENT_BUFFER_MAX_RANGE");
+        if(range > Vulkan::getPhysicalDevice().getProperties().limits.maxUniformBufferRange)
+            throw std::runtime_error("Transient buffer range exceeds the device's uniform buffer range");
+        m_uniforms.emplace_back(FGBUniformTransientBufferInfo{ location, binding, range, false });
+        return {
+            FGBResourceType::UniformTransientBuffer,
+            static_cast<uint32_t>(m_uniforms.size() - 1)
+        };
+    }
+
+    FGBResourceRef FrameGraphBuilder::addStorageTransientBuffer(uint32_t location, uint32_t binding, uint32_t range) {
+        if(range == 0 || range > TRANSIENT_BUFFER_MAX_RANGE)
+            throw std::runtime_error("Transient buffer range has to be between 1 and TRANSIENT_BUFFER_MAX_RANGE");
+        if(range > Vulkan::getPhysicalDevice().getProperties().limits.maxStorageBufferRange)
+            throw std::runtime_error("Transient buffer range exceeds the device's storage buffer range");
+        m_uniforms.emplace_back(FGBUniformTransientBufferInfo{ location, binding, range, true });
+        return {
+            FGBResourceType::UniformTransientBuffer,
+            static_cast<uint32_t>(m_uniforms.size() - 1)
+        };
+    }
+
     void FrameGraphBuilder::setBackbuffer(FGBResourceRef image) {
         m_backbuffer = image;
     }
 
+    void FrameGraphBuilder::exportResource(FGBResourceRef resource) {
+        switch(resource.type) {
+            case FGBResourceType::Image:
+            case FGBResourceType::DepthStencil:
+            case FGBResourceType::Buffer:
+            case FGBResourceType::RenderPass:
+            case FGBResourceType::ComputePass:
+                m_exports.push_back(resource);
+                break;
+            default:
+                throw std::runtime_error("Only images, buffers and passes can be exported");
+        }
+    }
+
+    void FrameGraphBuilder::setMemoryAliasing(bool enabled) {
+        m_memoryAliasing = enabled;
+    }
+
+    void FrameGraphBuilder::setProfiling(bool enabled) {
+        m_profiling = enabled;
+    }
+
+    void FrameGraphBuilder::setPassScheduling(FGBPassScheduling scheduling) {
+        m_passScheduling = scheduling;
+    }
+
+    void FrameGraphBuilder::setPipelineCompilation(FGBPipelineCompilation compilation) {
+        m_pipelineCompilation = compilation;
+    }
+
+    void FrameGraphBuilder::setPushDescriptorLocation(uint32_t location, std::vector<DescriptorSetBinding> bindings) {
+        if(!Vulkan::isPushDescriptorSupported())
+            throw std::runtime_error("Push descriptors aren't supported by this device");
+        m_pushDescriptorLocation = location;
+        m_pushDescriptorBindings = std::move(bindings);
+    }
+
+    void FrameGraphBuilder::setBindlessLocation(uint32_t location) {
+        if(!Vulkan::isBindlessSupported())
+            throw std::runtime_error("Bindless descriptors aren't supported by this device");
+        m_bindlessLocation = location;
+    }
+
     // Frame Graph Baking
     static uint32_t toActualWidth(uint32_t width) {
         return width == FGB_SWAPCHAIN_EXTENT ? Vulkan::getSwapchainExtent().width : width;
@@ -127,6 +306,12 @@ namespace vanguard {
         return height == FGB_SWAPCHAIN_EXTENT ? Vulkan::getSwapchainExtent().height : height;
     }
 
+    static bool isUniformResource(FGBResourceType type) {
+        return type == FGBResourceType::UniformBuffer || type == FGBResourceType::UniformStorageBuffer ||
+               type == FGBResourceType::UniformSampledImage || type == FGBResourceType::UniformStorageImage ||
+               type == FGBResourceType::UniformTransientBuffer;
+    }
+
     static std::pair<std::vector<FGBResourceRef>, std::vector<FGBResourceRef>> getPassInputsAndOutputs(const FGBPassInfo& pass) {
         return std::visit([&](const auto& pass) {
             using T = std::decay_t<decltype(pass)>;
@@ -139,16 +324,464 @@ namespace vanguard {
         }, pass);
     }
 
+    struct FGBImageUsage {
+        FGBResourceRef image;
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        bool write = false;
+    };
+
+    // Resolves every graph image a pass touches, including the ones behind uniforms
+    static std::vector<FGBImageUsage> getPassImageUsages(const FGBPassInfo& pass, const std::vector<FGBUniformInfo>& uniforms) {
+        auto [inputs, outputs] = getPassInputsAndOutputs(pass);
+        vk::PipelineStageFlags shaderStages = std::holds_alternative<FGBComputePassInfo>(pass)
+                ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader)
+                : vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader;
+        vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+
+        std::vector<FGBImageUsage> usages;
+        for (const auto& input: inputs) {
+            switch(input.type) {
+                case FGBResourceType::Image:
+                    usages.push_back({ input, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eInputAttachmentRead });
+                    break;
+                case FGBResourceType::DepthStencil:
+                    usages.push_back({ input, vk::ImageLayout::eDepthStencilReadOnlyOptimal, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eInputAttachmentRead });
+                    break;
+                case FGBResourceType::UniformSampledImage: {
+                    const auto& uniform = std::get<FGBUniformSampledImageInfo>(uniforms[input.location]);
+                    if(uniform.image.has_value())
+                        usages.push_back({ *uniform.image, vk::ImageLayout::eShaderReadOnlyOptimal, shaderStages, vk::AccessFlagBits::eShaderRead });
+                    break;
+                }
+                case FGBResourceType::UniformStorageImage: {
+                    const auto& uniform = std::get<FGBUniformStorageImageInfo>(uniforms[input.location]);
+                    usages.push_back({ uniform.image, vk::ImageLayout::eGeneral, shaderStages, vk::AccessFlagBits::eShaderRead });
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        for (const auto& output: outputs) {
+            switch(output.type) {
+                case FGBResourceType::Image:
+                    usages.push_back({ output, vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                       vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite, true });
+                    break;
+                case FGBResourceType::DepthStencil:
+                    usages.push_back({ output, vk::ImageLayout::eDepthStencilAttachmentOptimal, depthStages,
+                                       vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite, true });
+                    break;
+                case FGBResourceType::UniformStorageImage: {
+                    const auto& uniform = std::get<FGBUniformStorageImageInfo>(uniforms[output.location]);
+                    usages.push_back({ uniform.image, vk::ImageLayout::eGeneral, shaderStages, vk::AccessFlagBits::eShaderWrite, true });
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        return usages;
+    }
+
+    struct FGBBufferUsage {
+        FGBResourceRef buffer;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        bool write = false;
+    };
+
+    // Graph buffers are identified by their own reference, imported ones by the first uniform importing them so
+    // uniforms sharing a buffer are tracked as one
+    static FGBResourceRef getStorageBufferKey(const FGBUniformStorageBufferInfo& uniform, const std::vector<FGBUniformInfo>& uniforms) {
+        if(uniform.buffer.has_value())
+            return *uniform.buffer;
+        for (uint32_t i = 0; i < uniforms.size(); i++) {
+            const auto* other = std::get_if<FGBUniformStorageBufferInfo>(&uniforms[i]);
+            if(other != nullptr && other->storageBuffer == uniform.storageBuffer)
+                return { FGBResourceType::UniformStorageBuffer, i };
+        }
+        throw std::runtime_error("Storage buffer uniform isn't part of the graph");
+    }
+
+    static bool isImportedBuffer(const FGBResourceRef& buffer) {
+        return buffer.type == FGBResourceType::UniformStorageBuffer;
+    }
+
+    // Resolves every buffer a pass touches, storage buffers through their uniforms and graph buffers read directly as
+    // indirect, vertex or index buffers
+    static std::vector<FGBBufferUsage> getPassBufferUsages(const FGBPassInfo& pass, const std::vector<FGBUniformInfo>& uniforms) {
+        auto [inputs, outputs] = getPassInputsAndOutputs(pass);
+        bool compute = std::holds_alternative<FGBComputePassInfo>(pass);
+        vk::PipelineStageFlags shaderStages = compute
+                ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader)
+                : vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader;
+
+        std::vector<FGBBufferUsage> usages;
+        for (const auto& input: inputs) {
+            if(input.type == FGBResourceType::Buffer) {
+                if(compute)
+                    usages.push_back({ input, vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead });
+                else
+                    usages.push_back({ input, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+                                       vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead });
+            } else if(input.type == FGBResourceType::UniformStorageBuffer) {
+                const auto& uniform = std::get<FGBUniformStorageBufferInfo>(uniforms[input.location]);
+                usages.push_back({ getStorageBufferKey(uniform, uniforms), shaderStages, vk::AccessFlagBits::eShaderRead });
+            }
+        }
+        for (const auto& output: outputs) {
+            if(output.type == FGBResourceType::Buffer)
+                throw std::runtime_error("Buffers are written through storage buffer uniforms");
+            if(output.type == FGBResourceType::UniformStorageBuffer) {
+                const auto& uniform = std::get<FGBUniformStorageBufferInfo>(uniforms[output.location]);
+                usages.push_back({ getStorageBufferKey(uniform, uniforms), shaderStages, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, true });
+            }
+        }
+        return usages;
+    }
+
+    // Every resource a pass reads or writes, used where images and buffers are treated the same
+    static std::vector<std::pair<FGBResourceRef, bool>> getPassResourceAccesses(const FGBPassInfo& pass, const std::vector<FGBUniformInfo>& uniforms) {
+        std::vector<std::pair<FGBResourceRef, bool>> accesses;
+        for (const auto& usage: getPassImageUsages(pass, uniforms)) {
+            accesses.emplace_back(usage.image, usage.write);
+        }
+        for (const auto& usage: getPassBufferUsages(pass, uniforms)) {
+            accesses.emplace_back(usage.buffer, usage.write);
+        }
+        return accesses;
+    }
+
+    // What happened to an image last, used to derive the tightest barrier in front of the next use
+    struct FGBImageState {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags writeStages;
+        vk::AccessFlags writeAccess;
+        // Stages which read the image since the last write, and the accesses the last write was made visible to
+        vk::PipelineStageFlags readStages;
+        vk::AccessFlags visibleAccess;
+        // Queue which owns the image and the submission that last used it this frame
+        CommandQueue queue = CommandQueue::Graphics;
+        uint32_t submission = UINT32_MAX;
+    };
+
+    // Same as FGBImageState minus the layout, buffers are concurrent so queue changes only need the semaphore
+    struct FGBBufferState {
+        vk::PipelineStageFlags writeStages;
+        vk::AccessFlags writeAccess;
+        vk::PipelineStageFlags readStages;
+        vk::AccessFlags visibleAccess;
+        CommandQueue queue = CommandQueue::Graphics;
+        uint32_t submission = UINT32_MAX;
+    };
+
+    static CommandQueue getPassQueue(const FGBPassInfo& pass) {
+        const auto* computePass = std::get_if<FGBComputePassInfo>(&pass);
+        if(computePass != nullptr && computePass->asyncCompute && Vulkan::hasComputeQueue())
+            return CommandQueue::Compute;
+        return CommandQueue::Graphics;
+    }
+
+    static uint32_t getQueueFamilyIndex(CommandQueue queue) {
+        return queue == CommandQueue::Compute ? Vulkan::getComputeQueueFamilyIndex() : Vulkan::getQueueFamilyIndex();
+    }
+
+    // Returns the barrier needed in front of the usage, if any, and advances the state past it. Stages are accumulated
+    // into srcStage and dstStage so all the transitions in front of a pass can share one barrier.
+    static std::optional<ImageBarrierInfo> transitionImage(FGBImageState& state, ResourceRef image, const FGBImageUsage& usage,
+                                                           vk::PipelineStageFlags& srcStage, vk::PipelineStageFlags& dstStage) {
+        bool layoutChange = state.layout != usage.layout;
+        if(!usage.write && !layoutChange) {
+            // Read after read, nothing to do if this stage already saw the last write
+            bool visible = (state.readStages & usage.stages) == usage.stages && (state.visibleAccess & usage.access) == usage.access;
+            if(!state.writeStages || visible)
+                return std::nullopt;
+
+            srcStage |= state.writeStages;
+            dstStage |= usage.stages;
+            state.readStages |= usage.stages;
+            state.visibleAccess |= usage.access;
+            return ImageBarrierInfo{
+                    .image = image,
+                    .oldLayout = state.layout,
+                    .newLayout = usage.layout,
+                    .srcAccessMask = state.writeAccess,
+                    .dstAccessMask = usage.access,
+            };
+        }
+
+        // Writes and layout transitions have to wait for both the last write and every read since
+        vk::PipelineStageFlags waitStages = state.writeStages | state.readStages;
+        if(!waitStages && !layoutChange)
+            return std::nullopt;
+
+        ImageBarrierInfo barrier{
+                .image = image,
+                .oldLayout = state.layout,
+                .newLayout = usage.layout,
+                .srcAccessMask = state.writeAccess,
+                .dstAccessMask = usage.access,
+        };
+        srcStage |= waitStages ? waitStages : vk::PipelineStageFlagBits::eTopOfPipe;
+        dstStage |= usage.stages;
+
+        state.layout = usage.layout;
+        if(usage.write) {
+            state.writeStages = usage.stages;
+            state.writeAccess = usage.access;
+        } else {
+            // The transition itself is a write, later readers chain onto it through this stage
+            state.writeStages = usage.stages;
+        }
+        state.readStages = usage.write ? vk::PipelineStageFlags{} : usage.stages;
+        state.visibleAccess = usage.write ? vk::AccessFlags{} : usage.access;
+        return barrier;
+    }
+
+    // Buffer counterpart of transitionImage, without layouts only hazards against earlier writes need a barrier
+    static std::optional<BufferBarrierInfo> transitionBuffer(FGBBufferState& state, ResourceRef buffer, const FGBBufferUsage& usage,
+                                                             vk::PipelineStageFlags& srcStage, vk::PipelineStageFlags& dstStage) {
+        if(!usage.write) {
+            bool visible = (state.readStages & usage.stages) == usage.stages && (state.visibleAccess & usage.access) == usage.access;
+            if(!state.writeStages || visible)
+                return std::nullopt;
+
+            srcStage |= state.writeStages;
+            dstStage |= usage.stages;
+            state.readStages |= usage.stages;
+            state.visibleAccess |= usage.access;
+            return BufferBarrierInfo{
+                    .buffer = buffer,
+                    .srcAccessMask = state.writeAccess,
+                    .dstAccessMask = usage.access,
+            };
+        }
+
+        // Write after read only needs the execution dependency, write after write also the memory one
+        vk::PipelineStageFlags waitStages = state.writeStages | state.readStages;
+        std::optional<BufferBarrierInfo> barrier;
+        if(waitStages) {
+            srcStage |= waitStages;
+            dstStage |= usage.stages;
+            barrier = BufferBarrierInfo{
+                    .buffer = buffer,
+                    .srcAccessMask = state.writeAccess,
+                    .dstAccessMask = usage.access,
+            };
+        }
+        state.writeStages = usage.stages;
+        state.writeAccess = usage.access & vk::AccessFlagBits::eShaderWrite;
+        state.readStages = {};
+        state.visibleAccess = {};
+        return barrier;
+    }
+
+    // Walks the passes backwards from the backbuffer and exports, a pass is only kept if it writes a resource a kept pass
+    // (or the blit) depends on, or an imported buffer which outlives the graph. Attachments and storage resources load
+    // their previous contents so writes count as reads too.
+    static std::vector<uint32_t> cullPasses(const std::vector<FGBPassInfo>& passes, const std::vector<FGBUniformInfo>& uniforms,
+                                            const FGBResourceRef& backbuffer, const std::vector<FGBResourceRef>& exports) {
+        std::unordered_set<FGBResourceRef> neededResources = { backbuffer };
+        std::unordered_set<uint32_t> exportedPasses;
+        for (const auto& resource: exports) {
+            if(resource.type == FGBResourceType::RenderPass || resource.type == FGBResourceType::ComputePass)
+                exportedPasses.insert(resource.location);
+            else
+                neededResources.insert(resource);
+        }
+
+        std::vector<uint32_t> livePasses;
+        for (uint32_t i = passes.size(); i-- > 0;) {
+            auto accesses = getPassResourceAccesses(passes[i], uniforms);
+            bool live = exportedPasses.find(i) != exportedPasses.end() || std::any_of(accesses.begin(), accesses.end(), [&](const auto& access) {
+                const auto& [resource, write] = access;
+                return write && (isImportedBuffer(resource) || neededResources.find(resource) != neededResources.end());
+            });
+            if(!live)
+                continue;
+
+            livePasses.push_back(i);
+            for (const auto& [resource, write]: accesses) {
+                neededResources.insert(resource);
+            }
+        }
+        std::reverse(livePasses.begin(), livePasses.end());
+        return livePasses;
+    }
+
+    // Builds the pass DAG from image and buffer hazards (read after write, write after read and write after write) in insertion
+    // order, then list schedules it. Of the ready passes the one whose most recent producer ran the longest ago goes
+    // first so barriers have other work to overlap with, ties fall back to insertion order which keeps it deterministic.
+    static std::vector<uint32_t> schedulePasses(const std::vector<FGBPassInfo>& passes, const std::vector<FGBUniformInfo>& uniforms,
+                                                const std::vector<uint32_t>& livePasses) {
+        std::unordered_map<uint32_t, std::unordered_set<uint32_t>> dependencies;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> dependents;
+        std::unordered_map<FGBResourceRef, uint32_t> lastWriters;
+        std::unordered_map<FGBResourceRef, std::vector<uint32_t>> readersSinceWrite;
+        for (uint32_t pass: livePasses) {
+            dependencies[pass];
+            for (const auto& [resource, write]: getPassResourceAccesses(passes[pass], uniforms)) {
+                auto writer = lastWriters.find(resource);
+                if(writer != lastWriters.end() && writer->second != pass)
+                    dependencies[pass].insert(writer->second);
+                if(!write) {
+                    readersSinceWrite[resource].push_back(pass);
+                    continue;
+                }
+                for (uint32_t reader: readersSinceWrite[resource]) {
+                    if(reader != pass)
+                        dependencies[pass].insert(reader);
+                }
+                readersSinceWrite[resource].clear();
+                lastWriters[resource] = pass;
+            }
+        }
+        for (const auto& [pass, passDependencies]: dependencies) {
+            for (uint32_t dependency: passDependencies) {
+                dependents[dependency].push_back(pass);
+            }
+        }
+
+        std::unordered_map<uint32_t, size_t> remainingDependencies;
+        std::unordered_map<uint32_t, int64_t> latestProducer;
+        std::vector<uint32_t> ready;
+        for (uint32_t pass: livePasses) {
+            remainingDependencies[pass] = dependencies[pass].size();
+            latestProducer[pass] = -1;
+            if(dependencies[pass].empty())
+                ready.push_back(pass);
+        }
+
+        std::vector<uint32_t> schedule;
+        schedule.reserve(livePasses.size());
+        while(!ready.empty()) {
+            auto next = std::min_element(ready.begin(), ready.end(), [&](uint32_t a, uint32_t b) {
+                return std::make_pair(latestProducer[a], a) < std::make_pair(latestProducer[b], b);
+            });
+            uint32_t pass = *next;
+            ready.erase(next);
+
+            for (uint32_t dependent: dependents[pass]) {
+                latestProducer[dependent] = static_cast<int64_t>(schedule.size());
+                if(--remainingDependencies[dependent] == 0)
+                    ready.push_back(dependent);
+            }
+            schedule.push_back(pass);
+        }
+        return schedule;
+    }
+
+    static std::string getPassName(const FGBPassInfo& pass) {
+        return std::visit([&](const auto& pass) {
+            using T = std::decay_t<decltype(pass)>;
+            if constexpr (std::is_same_v<T, FGBRenderPassInfo>) {
+                return pass.name.empty() ? pass.fragmentShaderPath : pass.name;
+            }
+            else if constexpr (std::is_same_v<T, FGBComputePassInfo>) {
+                return pass.name.empty() ? pass.computeShaderPath : pass.name;
+            }
+        }, pass);
+    }
+
+    // First and last pass index an image is used in, and a bit for every queue that uses it
+    struct FGBImageLifetime {
+        uint32_t firstUse = 0;
+        uint32_t lastUse = 0;
+        uint32_t queues = 0;
+    };
+
+    struct FGBMemoryHeap {
+        std::vector<size_t> images;
+        vk::MemoryRequirements requirements;
+    };
+
+    // Greedily packs images into heaps, largest first, only sharing a heap when no lifetimes overlap. Images also have
+    // to stay on a single queue, handing memory over between queues would need a semaphore in front of every alias.
+    static std::vector<FGBMemoryHeap> aliasImageMemory(const std::vector<std::pair<FGBResourceRef, ImageInfo>>& images,
+                                                       const std::vector<vk::MemoryRequirements>& requirements,
+                                                       const std::unordered_map<FGBResourceRef, FGBImageLifetime>& lifetimes) {
+        std::vector<size_t> order(images.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        std::vector<FGBMemoryHeap> heaps;
+        for (size_t index: order) {
+            const auto& lifetime = lifetimes.at(images[index].first);
+            const auto& requirement = requirements[index];
+
+            FGBMemoryHeap* chosenHeap = nullptr;
+            bool singleQueue = (lifetime.queues & (lifetime.queues - 1)) == 0;
+            for (auto& heap: heaps) {
+                if(!(heap.requirements.memoryTypeBits & requirement.memoryTypeBits))
+                    continue;
+                if(!singleQueue || lifetimes.at(images[heap.images.front()].first).queues != lifetime.queues)
+                    continue;
+
+                bool overlaps = std::any_of(heap.images.begin(), heap.images.end(), [&](size_t other) {
+                    const auto& otherLifetime = lifetimes.at(images[other].first);
+                    return lifetime.firstUse <= otherLifetime.lastUse && otherLifetime.firstUse <= lifetime.lastUse;
+                });
+                if(!overlaps) {
+                    chosenHeap = &heap;
+                    break;
+                }
+            }
+
+            if(chosenHeap == nullptr) {
+                heaps.push_back(FGBMemoryHeap{ .images = { index }, .requirements = requirement });
+                continue;
+            }
+            chosenHeap->images.push_back(index);
+            chosenHeap->requirements.size = std::max(chosenHeap->requirements.size, requirement.size);
+            chosenHeap->requirements.alignment = std::max(chosenHeap->requirements.alignment, requirement.alignment);
+            chosenHeap->requirements.memoryTypeBits &= requirement.memoryTypeBits;
+        }
+        return heaps;
+    }
+
     FrameGraph FrameGraphBuilder::bake() {
         if(m_backbuffer.location == FGB_UNDEFINED_RESOURCE)
             throw std::runtime_error("Backbuffer not set");
 
+        // Cull passes which don't contribute to the backbuffer or an export, everything below only sees live passes
+        std::vector<uint32_t> passOrder = cullPasses(m_passes, m_uniforms, m_backbuffer, m_exports);
+        if(passOrder.size() != m_passes.size()) {
+            INFO("Frame graph culled {} of {} passes", m_passes.size() - passOrder.size(), m_passes.size());
+        }
+        if(m_passScheduling == FGBPassScheduling::Dependency) {
+            passOrder = schedulePasses(m_passes, m_uniforms, passOrder);
+        }
+
+        std::string scheduleDump;
+        for (uint32_t passIndex: passOrder) {
+            scheduleDump += fmt::format("{}{} ({})", scheduleDump.empty() ? "" : " -> ", passIndex, getPassName(m_passes[passIndex]));
+        }
+        INFO("Frame graph schedule: {}", scheduleDump);
+
+        std::unordered_set<uint32_t> liveUniforms;
+        for (uint32_t passIndex: passOrder) {
+            auto [inputs, outputs] = getPassInputsAndOutputs(m_passes[passIndex]);
+            for (const auto& resource: inputs) {
+                if(isUniformResource(resource.type))
+                    liveUniforms.insert(resource.location);
+            }
+            for (const auto& resource: outputs) {
+                if(isUniformResource(resource.type))
+                    liveUniforms.insert(resource.location);
+            }
+        }
+
         // Calculate image usages
         std::unordered_map<uint32_t, vk::ImageUsageFlags> imageUsages;
         std::unordered_map<uint32_t, vk::ImageUsageFlags> depthStencilUsages;
 
-        for (const auto& pass: m_passes) {
-            auto [inputs, outputs] = getPassInputsAndOutputs(pass);
+        for (uint32_t passIndex: passOrder) {
+            auto [inputs, outputs] = getPassInputsAndOutputs(m_passes[passIndex]);
             for (const auto& input: inputs) {
                 switch(input.type) {
                     case FGBResourceType::Image:
@@ -184,38 +817,144 @@ namespace vanguard {
             }
         }
         imageUsages[m_backbuffer.location] |= vk::ImageUsageFlagBits::eTransferSrc;
+        for (const auto& resource: m_exports) {
+            if(resource.type == FGBResourceType::Image)
+                imageUsages[resource.location] |= vk::ImageUsageFlagBits::eTransferSrc;
+            else if(resource.type == FGBResourceType::DepthStencil)
+                depthStencilUsages[resource.location] |= vk::ImageUsageFlagBits::eTransferSrc;
+        }
+
+        // Calculate image lifetimes in pass order, the backbuffer and exports have to outlive every pass
+        std::unordered_map<FGBResourceRef, FGBImageLifetime> imageLifetimes;
+        for (uint32_t i = 0; i < passOrder.size(); ++i) {
+            for (const auto& usage: getPassImageUsages(m_passes[passOrder[i]], m_uniforms)) {
+                auto [it, inserted] = imageLifetimes.try_emplace(usage.image, FGBImageLifetime{ .firstUse = i, .lastUse = i });
+                if(!inserted) {
+                    it->second.lastUse = i;
+                }
+                it->second.queues |= 1u << static_cast<uint32_t>(getPassQueue(m_passes[passOrder[i]]));
+            }
+        }
+        imageLifetimes[m_backbuffer].lastUse = UINT32_MAX;
+        for (const auto& resource: m_exports) {
+            if(resource.type == FGBResourceType::Image || resource.type == FGBResourceType::DepthStencil)
+                imageLifetimes[resource].lastUse = UINT32_MAX;
+        }
 
         FrameGraph graph;
 
-        // Create images
-        std::unordered_map<FGBResourceRef, ResourceRef> imageLocations;
+        std::vector<std::pair<FGBResourceRef, ImageInfo>> imageInfos;
         for (int i = 0; i < m_images.size(); ++i) {
             if(imageUsages.find(i) == imageUsages.end())
                 continue;
 
             const auto& info = m_images[i];
-            graph.m_images.push_back(RENDER_SYSTEM.getResourceManager().createImage(ImageInfo{
+            imageInfos.emplace_back(FGBResourceRef{ FGBResourceType::Image, static_cast<uint32_t>(i) }, ImageInfo{
                     .format = info.format,
                     .usage = imageUsages[i],
                     .aspect = vk::ImageAspectFlagBits::eColor,
                     .width = toActualWidth(info.extent.width),
-                    .height = toActualHeight(info.extent.height)
-            }));
-            imageLocations.emplace(FGBResourceRef{ FGBResourceType::Image, static_cast<uint32_t>(i) }, graph.m_images.back());
+                    .height = toActualHeight(info.extent.height),
+                    .name = "frame graph image"
+            });
         }
         for (int i = 0; i < m_depthStencils.size(); ++i) {
             if(depthStencilUsages.find(i) == depthStencilUsages.end())
                 continue;
 
             const auto& info = m_depthStencils[i];
-            graph.m_images.push_back(RENDER_SYSTEM.getResourceManager().createImage(ImageInfo{
+            imageInfos.emplace_back(FGBResourceRef{ FGBResourceType::DepthStencil, static_cast<uint32_t>(i) }, ImageInfo{
                     .format = info.format,
                     .usage = depthStencilUsages[i],
                     .aspect = vk::ImageAspectFlagBits::eDepth,
                     .width = toActualWidth(info.extent.width),
-                    .height = toActualHeight(info.extent.height)
+                    .height = toActualHeight(info.extent.height),
+                    .name = "frame graph depth stencil"
+            });
+        }
+
+        // Alias image memory, every image in a shared heap has to wait on the previous occupant before its first use.
+        // Occupants wrap around so the first one also waits on the last one from the previous frame.
+        std::unordered_map<FGBResourceRef, FGBResourceRef> aliasPredecessors;
+        if(m_memoryAliasing) {
+            std::vector<vk::MemoryRequirements> requirements;
+            requirements.reserve(imageInfos.size());
+            vk::DeviceSize unaliasedSize = 0;
+            for (const auto& [_, info]: imageInfos) {
+                requirements.push_back(ImagePool::getMemoryRequirements(info));
+                unaliasedSize += requirements.back().size;
+            }
+
+            vk::DeviceSize aliasedSize = 0;
+            uint32_t aliasedImages = 0;
+            for (auto& heap: aliasImageMemory(imageInfos, requirements, imageLifetimes)) {
+                aliasedSize += heap.requirements.size;
+                if(heap.images.size() < 2)
+                    continue;
+
+                graph.m_memory.push_back(RENDER_SYSTEM.getResourceManager().createMemory(MemoryInfo{ .requirements = heap.requirements, .name = "frame graph aliased memory" }));
+                for (size_t index: heap.images) {
+                    imageInfos[index].second.memory = graph.m_memory.back();
+                }
+
+                std::sort(heap.images.begin(), heap.images.end(), [&](size_t a, size_t b) {
+                    return imageLifetimes[imageInfos[a].first].firstUse < imageLifetimes[imageInfos[b].first].firstUse;
+                });
+                for (size_t j = 0; j < heap.images.size(); ++j) {
+                    const auto& image = imageInfos[heap.images[j]].first;
+                    const auto& previous = imageInfos[heap.images[(j + heap.images.size() - 1) % heap.images.size()]].first;
+                    aliasPredecessors.emplace(image, previous);
+                }
+                aliasedImages += heap.images.size();
+            }
+            INFO("Frame graph aliased {} of {} images, {} bytes -> {} bytes ({} bytes saved)",
+                 aliasedImages, imageInfos.size(), unaliasedSize, aliasedSize, unaliasedSize - aliasedSize);
+        }
+
+        // Create images
+        std::unordered_map<FGBResourceRef, ResourceRef> imageLocations;
+        for (const auto& [reference, info]: imageInfos) {
+            graph.m_images.push_back(RENDER_SYSTEM.getResourceManager().createImage(info));
+            imageLocations.emplace(reference, graph.m_images.back());
+
+            FGBExtent extent = reference.type == FGBResourceType::Image ? m_images[reference.location].extent : m_depthStencils[reference.location].extent;
+            if(extent.width == FGB_SWAPCHAIN_EXTENT || extent.height == FGB_SWAPCHAIN_EXTENT)
+                graph.m_swapchainImages.emplace_back(graph.m_images.back(), extent);
+        }
+        for (const auto& resource: m_exports) {
+            if(imageLocations.find(resource) != imageLocations.end())
+                graph.m_exportedImages.emplace(resource, imageLocations[resource]);
+        }
+
+        // Create the graph buffers live passes or exports use, imported buffers resolve to themselves
+        std::unordered_map<FGBResourceRef, ResourceRef> bufferLocations;
+        auto resolveBuffer = [&](const FGBResourceRef& reference) {
+            if(bufferLocations.find(reference) != bufferLocations.end())
+                return;
+            if(isImportedBuffer(reference)) {
+                bufferLocations.emplace(reference, (*std::get<FGBUniformStorageBufferInfo>(m_uniforms[reference.location]).storageBuffer)->getBuffer());
+                return;
+            }
+            const auto& info = m_buffers[reference.location];
+            graph.m_buffers.push_back(RENDER_SYSTEM.getResourceManager().createBuffer(BufferInfo{
+                    .size = info.size,
+                    .usage = vk::BufferUsageFlagBits::eStorageBuffer | info.usage,
+                    .memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+                    .concurrent = true,
+                    .name = "frame graph buffer",
             }));
-            imageLocations.emplace(FGBResourceRef{ FGBResourceType::DepthStencil, static_cast<uint32_t>(i) }, graph.m_images.back());
+            bufferLocations.emplace(reference, graph.m_buffers.back());
+        };
+        for (uint32_t passIndex: passOrder) {
+            for (const auto& usage: getPassBufferUsages(m_passes[passIndex], m_uniforms)) {
+                resolveBuffer(usage.buffer);
+            }
+        }
+        for (const auto& resource: m_exports) {
+            if(resource.type != FGBResourceType::Buffer)
+                continue;
+            resolveBuffer(resource);
+            graph.m_exportedBuffers.emplace(resource, bufferLocations[resource]);
         }
 
         std::vector<ResourceRef> samplers;
@@ -224,7 +963,11 @@ namespace vanguard {
         std::unordered_map<uint32_t, uint32_t> uniformLocations;
         std::unordered_map<uint32_t, ResourceRef> uniformDescriptorMap;
         std::unordered_map<uint32_t, std::vector<std::vector<DescriptorSetWrite>>> descriptorWrites;
+        std::vector<const FGBUniformStorageBufferInfo*> importedStorageBuffers;
         for (int i = 0; i < m_uniforms.size(); i++) {
+            if(liveUniforms.find(i) == liveUniforms.end())
+                continue;
+
             const auto& reference = m_uniforms[i];
             auto [location, binding] = std::visit([&](const auto& uniform) {
                 using T = std::decay_t<decltype(uniform)>;
@@ -246,6 +989,27 @@ namespace vanguard {
                         .count = 1
                     }};
                 }
+                else if constexpr (std::is_same_v<T, FGBUniformStorageBufferInfo>) {
+                    descriptorWrites[uniform.location].resize(FRAMES_IN_FLIGHT);
+                    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+                        if(uniform.storageBuffer.has_value()) {
+                            descriptorWrites[uniform.location][i].push_back((*uniform.storageBuffer)->getDescriptorWrite(uniform.binding, i));
+                            continue;
+                        }
+                        descriptorWrites[uniform.location][i].push_back(DescriptorSetWrite{
+                                .binding = uniform.binding,
+                                .type = vk::DescriptorType::eStorageBuffer,
+                                .buffer = DescriptorBufferInfo{ .buffer = bufferLocations[*uniform.buffer] }
+                        });
+                    }
+                    if(uniform.storageBuffer.has_value())
+                        importedStorageBuffers.push_back(&uniform);
+                    return std::pair<uint32_t, DescriptorSetBinding>{uniform.location, DescriptorSetBinding{
+                            .binding = uniform.binding,
+                            .type = vk::DescriptorType::eStorageBuffer,
+                            .count = 1
+                    }};
+                }
                 else if constexpr (std::is_same_v<T, FGBUniformSampledImageInfo>) {
                     ResourceRef image = uniform.image.has_value() ? imageLocations[*uniform.image] : (*uniform.texture)->getImage();
                     descriptorWrites[uniform.location].resize(FRAMES_IN_FLIGHT);
@@ -288,7 +1052,32 @@ namespace vanguard {
                             .count = 1
                     }};
                 }
+                else if constexpr (std::is_same_v<T, FGBUniformTransientBufferInfo>) {
+                    // The whole buffer is host written and coherent, so there's nothing to track. Frames in flight
+                    // write different slices, the offsets include the slice.
+                    auto type = uniform.storage ? vk::DescriptorType::eStorageBufferDynamic : vk::DescriptorType::eUniformBufferDynamic;
+                    descriptorWrites[uniform.location].resize(FRAMES_IN_FLIGHT);
+                    for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+                        descriptorWrites[uniform.location][i].push_back(DescriptorSetWrite{
+                                .binding = uniform.binding,
+                                .type = type,
+                                .buffer = DescriptorBufferInfo{
+                                        .buffer = RENDER_SYSTEM.getTransientBuffers().getBuffer(),
+                                        .offset = 0,
+                                        .size = uniform.range
+                                }
+                        });
+                    return std::pair<uint32_t, DescriptorSetBinding>{uniform.location, DescriptorSetBinding{
+                            .binding = uniform.binding,
+                            .type = type,
+                            .count = 1
+                    }};
+                }
             }, reference);
+            if(location == m_bindlessLocation)
+                throw std::runtime_error("Uniform uses the bindless descriptor set's location");
+            if(location == m_pushDescriptorLocation)
+                throw std::runtime_error("Uniform uses the push descriptor set's location");
             descriptorBindings[location].push_back(binding);
             uniformLocations[i] = location;
         }
@@ -296,202 +1085,352 @@ namespace vanguard {
         for (const auto& [location, bindings]: descriptorBindings) {
             descriptorLayouts[location] = RENDER_SYSTEM.getResourceManager().createDescriptorSetLayout({ .bindings = bindings });
         }
-        for (int i = 0; i < m_uniforms.size(); i++) {
+        for (uint32_t i: liveUniforms) {
             uniformDescriptorMap.emplace(i, descriptorLayouts[uniformLocations[i]]);
         }
         std::unordered_map<uint32_t, FrameGraph::DescriptorSet> descriptorSets;
         for (const auto& [location, layout]: descriptorLayouts) {
-            std::vector<ResourceRef> sets;
+            std::vector<ResourceRef> sets = RENDER_SYSTEM.getResourceManager().createDescriptorSets({ .layout = layout }, FRAMES_IN_FLIGHT);
             const auto& writes = descriptorWrites[location];
             for(int i = 0; i < FRAMES_IN_FLIGHT; i++) {
-                sets.push_back(RENDER_SYSTEM.getResourceManager().createDescriptorSet({ .layout = layout }));
-                RENDER_SYSTEM.getResourceManager().updateDescriptorSet(sets.back(), writes[i]);
+                RENDER_SYSTEM.getResourceManager().updateDescriptorSet(sets[i], writes[i]);
+                for (const auto* uniform: importedStorageBuffers) {
+                    if(uniform->location != location)
+                        continue;
+                    (*uniform->storageBuffer)->addDescriptorSet(sets[i], uniform->binding, i);
+                    graph.m_storageBufferBindings.emplace_back(*uniform->storageBuffer, sets[i]);
+                }
             }
-            descriptorSets.emplace(location, FrameGraph::DescriptorSet(location, layout, sets));
+            const auto& bindings = descriptorBindings[location];
+            auto dynamicOffsetCount = static_cast<uint32_t>(std::count_if(bindings.begin(), bindings.end(), [](const DescriptorSetBinding& binding) {
+                return binding.type == vk::DescriptorType::eUniformBufferDynamic || binding.type == vk::DescriptorType::eStorageBufferDynamic;
+            }));
+            descriptorSets.emplace(location, FrameGraph::DescriptorSet(location, layout, sets, dynamicOffsetCount));
         }
         graph.m_descriptorSets = std::move(descriptorSets);
+        graph.m_descriptorWrites = std::move(descriptorWrites);
 
-        std::vector<ResourceRef> renderPasses;
-        std::vector<ResourceRef> computePasses;
-        std::unordered_set<FGBResourceRef> imagesUsed;
+        // Resolve the barriers in front of every pass. The tracker is run over the schedule once to find the state
+        // each image ends the frame in, which is what the next frame starts from. Aliased images start from the
+        // state of the previous occupant of their memory instead, and everything starts undefined as it's rewritten.
+        std::vector<std::vector<std::pair<ResourceRef, FGBImageUsage>>> passImageUsages;
+        passImageUsages.reserve(passOrder.size());
+        for (uint32_t passIndex: passOrder) {
+            std::vector<std::pair<ResourceRef, FGBImageUsage>> usages;
+            for (const auto& usage: getPassImageUsages(m_passes[passIndex], m_uniforms)) {
+                ResourceRef image = imageLocations[usage.image];
+                auto existing = std::find_if(usages.begin(), usages.end(), [&](const auto& other) { return other.first == image; });
+                if(existing == usages.end()) {
+                    usages.emplace_back(image, usage);
+                    continue;
+                }
+                if(existing->second.layout != usage.layout)
+                    throw std::runtime_error("Image is used with conflicting layouts in the same pass");
+                existing->second.stages |= usage.stages;
+                existing->second.access |= usage.access;
+                existing->second.write |= usage.write;
+            }
+            passImageUsages.push_back(std::move(usages));
+        }
+        // Buffers go through the same tracking minus layouts, imported ones start the frame where the last one left them
+        std::vector<std::vector<std::pair<ResourceRef, FGBBufferUsage>>> passBufferUsages;
+        passBufferUsages.reserve(passOrder.size());
+        for (uint32_t passIndex: passOrder) {
+            std::vector<std::pair<ResourceRef, FGBBufferUsage>> usages;
+            for (const auto& usage: getPassBufferUsages(m_passes[passIndex], m_uniforms)) {
+                ResourceRef buffer = bufferLocations[usage.buffer];
+                auto existing = std::find_if(usages.begin(), usages.end(), [&](const auto& other) { return other.first == buffer; });
+                if(existing == usages.end()) {
+                    usages.emplace_back(buffer, usage);
+                    continue;
+                }
+                existing->second.stages |= usage.stages;
+                existing->second.access |= usage.access;
+                existing->second.write |= usage.write;
+            }
+            passBufferUsages.push_back(std::move(usages));
+        }
+        std::unordered_map<ResourceRef, FGBBufferState> bufferStates;
+        for (uint32_t i = 0; i < passOrder.size(); ++i) {
+            CommandQueue queue = getPassQueue(m_passes[passOrder[i]]);
+            for (const auto& [buffer, usage]: passBufferUsages[i]) {
+                auto& state = bufferStates[buffer];
+                if(state.queue != queue)
+                    state = FGBBufferState{ .queue = queue };
 
-        std::unordered_map<ResourceRef, vk::ImageLayout> imageLayouts;
-        std::unordered_map<ResourceRef, vk::AccessFlags> imageAccesses;
-        std::unordered_set<ResourceRef> nativeImages;
-        for (int i = 0; i < m_images.size(); ++i) {
-            imageLayouts.emplace(imageLocations[FGBResourceRef{ FGBResourceType::Image, static_cast<uint32_t>(i) }], vk::ImageLayout::eUndefined);
-            imageAccesses.emplace(imageLocations[FGBResourceRef{ FGBResourceType::Image, static_cast<uint32_t>(i) }], vk::AccessFlagBits::eNoneKHR);
+                vk::PipelineStageFlags srcStage, dstStage;
+                transitionBuffer(state, buffer, usage, srcStage, dstStage);
+            }
         }
-        for (int i = 0; i < m_depthStencils.size(); ++i) {
-            imageLayouts.emplace(imageLocations[FGBResourceRef{ FGBResourceType::DepthStencil, static_cast<uint32_t>(i) }], vk::ImageLayout::eUndefined);
-            imageAccesses.emplace(imageLocations[FGBResourceRef{ FGBResourceType::DepthStencil, static_cast<uint32_t>(i) }], vk::AccessFlagBits::eNoneKHR);
+        for (auto& [buffer, state]: bufferStates) {
+            state.submission = UINT32_MAX;
         }
-        for (const auto& uniform: m_uniforms) {
-            std::visit([&](const auto& uniform) {
-                using T = std::decay_t<decltype(uniform)>;
-                if constexpr (std::is_same_v<T, FGBUniformSampledImageInfo>) {
-                    if(uniform.texture.has_value()) {
-                        auto imageRef = (*uniform.texture)->getImage();
-                        imageLayouts.emplace(imageRef, vk::ImageLayout::eShaderReadOnlyOptimal);
-                        imageAccesses.emplace(imageRef, vk::AccessFlagBits::eShaderRead);
-                    }
-                }
-            }, uniform);
+
+        std::unordered_map<ResourceRef, FGBImageState> imageStates;
+        for (uint32_t i = 0; i < passOrder.size(); ++i) {
+            CommandQueue queue = getPassQueue(m_passes[passOrder[i]]);
+            for (const auto& [image, usage]: passImageUsages[i]) {
+                // Stages from another queue are meaningless here, the semaphore between them covers those
+                auto& state = imageStates[image];
+                if(state.queue != queue)
+                    state = FGBImageState{ .layout = state.layout, .queue = queue };
+
+                vk::PipelineStageFlags srcStage, dstStage;
+                transitionImage(state, image, usage, srcStage, dstStage);
+            }
+        }
+        // The blit reads the backbuffer on the graphics queue after the graph, the next frame has to wait for it
+        ResourceRef backbufferImage = imageLocations[m_backbuffer];
+        if(imageStates[backbufferImage].queue != CommandQueue::Graphics)
+            imageStates[backbufferImage] = FGBImageState{ .queue = CommandQueue::Graphics };
+        imageStates[backbufferImage].readStages |= vk::PipelineStageFlagBits::eTransfer;
+
+        std::unordered_map<ResourceRef, FGBImageState> finalImageStates = imageStates;
+        for (auto& [image, state]: imageStates) {
+            state.layout = vk::ImageLayout::eUndefined;
+        }
+        for (const auto& [reference, previous]: aliasPredecessors) {
+            auto& state = imageStates[imageLocations[reference]];
+            state = finalImageStates[imageLocations[previous]];
+            state.layout = vk::ImageLayout::eUndefined;
         }
 
-        std::vector<std::pair<PipelineBarrierCommand, uint32_t>> pipelineBarriers;
+        std::vector<ResourceRef> renderPipelines;
+        std::vector<ResourceRef> computePipelines;
+        std::unordered_set<ResourceRef> imagesUsed;
+        uint32_t barrierCount = 0;
+        uint32_t elidedTransitions = 0;
+        uint32_t ownershipTransfers = 0;
+        std::vector<std::string> profiledPasses;
+
+        // Consecutive passes on the same queue share a submission. Every queue remembers the latest submission on the
+        // other queue it waited on, anything before that is already covered by queue order.
+        std::vector<CommandSubmission> submissions;
+        std::unordered_map<CommandQueue, int64_t> lastWaitedSubmission = {
+                { CommandQueue::Graphics, -1 },
+                { CommandQueue::Compute, -1 },
+        };
+        auto waitOnSubmission = [&](CommandQueue queue, uint32_t submission) {
+            if(static_cast<int64_t>(submission) <= lastWaitedSubmission[queue])
+                return;
+            submissions.back().waits.push_back(submission);
+            lastWaitedSubmission[queue] = submission;
+        };
+        // Hands the image over to the current submission's queue, releasing it at the end of the submission that
+        // used it last. The acquire half goes into the given barrier.
+        auto transferOwnership = [&](ResourceRef image, FGBImageState& state, vk::ImageLayout newLayout, vk::AccessFlags dstAccess,
+                                     vk::PipelineStageFlags dstStages, PipelineBarrierCommand& acquire) {
+            CommandQueue queue = submissions.back().queue;
+            uint32_t srcFamily = getQueueFamilyIndex(state.queue);
+            uint32_t dstFamily = getQueueFamilyIndex(queue);
+            vk::PipelineStageFlags srcStages = state.writeStages | state.readStages;
+            submissions[state.submission].commands.emplace_back(PipelineBarrierCommand{
+                .srcStage = srcStages ? srcStages : vk::PipelineStageFlagBits::eTopOfPipe,
+                .dstStage = vk::PipelineStageFlagBits::eBottomOfPipe,
+                .imageMemoryBarriers = { ImageBarrierInfo{
+                        .image = image,
+                        .oldLayout = state.layout,
+                        .newLayout = newLayout,
+                        .srcAccessMask = state.writeAccess,
+                        .srcQueueFamilyIndex = srcFamily,
+                        .dstQueueFamilyIndex = dstFamily,
+                }},
+            });
+            acquire.srcStage |= vk::PipelineStageFlagBits::eTopOfPipe;
+            acquire.dstStage |= dstStages;
+            acquire.imageMemoryBarriers.push_back(ImageBarrierInfo{
+                    .image = image,
+                    .oldLayout = state.layout,
+                    .newLayout = newLayout,
+                    .dstAccessMask = dstAccess,
+                    .srcQueueFamilyIndex = srcFamily,
+                    .dstQueueFamilyIndex = dstFamily,
+            });
+            waitOnSubmission(queue, state.submission);
+            ownershipTransfers++;
+        };
+
+        for (uint32_t i = 0; i < passOrder.size(); ++i) {
+            const auto& passInfo = m_passes[passOrder[i]];
+            CommandQueue queue = getPassQueue(passInfo);
+            if(submissions.empty() || submissions.back().queue != queue)
+                submissions.push_back(CommandSubmission{ .queue = queue });
+            auto submission = static_cast<uint32_t>(submissions.size() - 1);
+
+            // All transitions in front of a pass are merged into a single barrier
+            PipelineBarrierCommand barrier{};
+            for (const auto& [image, usage]: passImageUsages[i]) {
+                auto& state = imageStates[image];
+                if(state.queue != queue && state.submission != UINT32_MAX) {
+                    transferOwnership(image, state, usage.layout, usage.access, usage.stages, barrier);
+                    state = FGBImageState{
+                        .layout = usage.layout,
+                        .writeStages = usage.stages,
+                        .writeAccess = usage.write ? usage.access : vk::AccessFlags{},
+                        .readStages = usage.write ? vk::PipelineStageFlags{} : usage.stages,
+                        .visibleAccess = usage.write ? vk::AccessFlags{} : usage.access,
+                    };
+                } else {
+                    // First use this frame after the previous frame left it on the other queue, frame order covers it
+                    if(state.queue != queue)
+                        state = FGBImageState{};
+
+                    auto transition = transitionImage(state, image, usage, barrier.srcStage, barrier.dstStage);
+                    if(transition.has_value())
+                        barrier.imageMemoryBarriers.push_back(*transition);
+                    else
+                        elidedTransitions++;
+                }
+                state.queue = queue;
+                state.submission = submission;
+            }
+            for (const auto& [buffer, usage]: passBufferUsages[i]) {
+                // Buffers are concurrent, crossing queues only needs the submission that last used it to be waited on
+                auto& state = bufferStates[buffer];
+                if(state.queue != queue) {
+                    if(state.submission != UINT32_MAX)
+                        waitOnSubmission(queue, state.submission);
+                    state = FGBBufferState{};
+                }
+
+                auto transition = transitionBuffer(state, buffer, usage, barrier.srcStage, barrier.dstStage);
+                if(transition.has_value())
+                    barrier.bufferMemoryBarriers.push_back(*transition);
+                state.queue = queue;
+                state.submission = submission;
+            }
+            if(!barrier.imageMemoryBarriers.empty() || !barrier.bufferMemoryBarriers.empty()) {
+                submissions.back().commands.emplace_back(barrier);
+                barrierCount++;
+            }
 
-        std::vector<Command> commands;
-        for (int i = 0; i < m_passes.size(); ++i) {
-            const auto& passInfo = m_passes[i];
-            std::optional<PipelineBarrierCommand> barrier;
             Command command = std::visit([&](const auto& pass) {
                 using T = std::decay_t<decltype(pass)>;
+                // Sets are laid out by location, the pipeline layout needs a layout for every set index so gaps get
+                // an empty one
+                auto& data = *graph.m_passData.emplace_back(std::make_unique<FrameGraph::PassData>());
+                data.bindPoint = std::is_same_v<T, FGBComputePassInfo> ? vk::PipelineBindPoint::eCompute : vk::PipelineBindPoint::eGraphics;
+                auto useUniform = [&](const FGBResourceRef& resource) {
+                    if(!isUniformResource(resource.type))
+                        return;
+                    uint32_t location = uniformLocations[resource.location];
+                    if(data.descriptorSets.size() <= location)
+                        data.descriptorSets.resize(location + 1, nullptr);
+                    data.descriptorSets[location] = &graph.m_descriptorSets.at(location);
+                    if(resource.type == FGBResourceType::UniformTransientBuffer)
+                        data.transientRanges.emplace_back(resource, std::get<FGBUniformTransientBufferInfo>(m_uniforms[resource.location]).range);
+                };
+                std::for_each(pass.inputs.begin(), pass.inputs.end(), useUniform);
+                std::for_each(pass.outputs.begin(), pass.outputs.end(), useUniform);
+
+                data.pushConstants = pass.pushConstants;
+                for (const auto& range: pass.pushConstants) {
+                    if(range.offset + range.size > Vulkan::getPhysicalDevice().getProperties().limits.maxPushConstantsSize)
+                        throw std::runtime_error("Push constant range exceeds the device's push constant size");
+                }
+                if(m_bindlessLocation != UINT32_MAX) {
+                    data.bindlessLocation = m_bindlessLocation;
+                    if(data.descriptorSets.size() <= m_bindlessLocation)
+                        data.descriptorSets.resize(m_bindlessLocation + 1, nullptr);
+                }
+                if(m_pushDescriptorLocation != UINT32_MAX) {
+                    data.pushDescriptorLocation = m_pushDescriptorLocation;
+                    if(data.descriptorSets.size() <= m_pushDescriptorLocation)
+                        data.descriptorSets.resize(m_pushDescriptorLocation + 1, nullptr);
+                }
+
+                std::vector<ResourceRef> descriptorSetLayouts;
+                for (uint32_t location = 0; location < data.descriptorSets.size(); location++) {
+                    if(data.descriptorSets[location] != nullptr) {
+                        descriptorSetLayouts.push_back(descriptorLayouts[location]);
+                        continue;
+                    }
+                    if(location == m_bindlessLocation) {
+                        descriptorSetLayouts.push_back(RENDER_SYSTEM.getResourceManager().getBindlessDescriptors().getLayout());
+                        continue;
+                    }
+                    if(location == m_pushDescriptorLocation) {
+                        if(graph.m_pushDescriptorSetLayout == UNDEFINED_RESOURCE)
+                            graph.m_pushDescriptorSetLayout = RENDER_SYSTEM.getResourceManager().createDescriptorSetLayout({
+                                    .bindings = m_pushDescriptorBindings,
+                                    .pushDescriptor = true
+                            });
+                        descriptorSetLayouts.push_back(graph.m_pushDescriptorSetLayout);
+                        continue;
+                    }
+                    if(graph.m_emptyDescriptorSetLayout == UNDEFINED_RESOURCE)
+                        graph.m_emptyDescriptorSetLayout = RENDER_SYSTEM.getResourceManager().createDescriptorSetLayout({});
+                    descriptorSetLayouts.push_back(graph.m_emptyDescriptorSetLayout);
+                }
+                for (const auto& usage: getPassImageUsages(passInfo, m_uniforms)) {
+                    ResourceRef image = imageLocations[usage.image];
+                    if(std::find(data.images.begin(), data.images.end(), std::make_pair(usage.image, image)) == data.images.end())
+                        data.images.emplace_back(usage.image, image);
+                }
+                auto useBuffer = [&](const FGBResourceRef& resource) {
+                    if(resource.type == FGBResourceType::Buffer)
+                        data.buffers.emplace_back(resource, bufferLocations[resource]);
+                    else if(resource.type == FGBResourceType::UniformStorageBuffer)
+                        data.buffers.emplace_back(resource, bufferLocations[getStorageBufferKey(std::get<FGBUniformStorageBufferInfo>(m_uniforms[resource.location]), m_uniforms)]);
+                };
+                std::for_each(pass.inputs.begin(), pass.inputs.end(), useBuffer);
+                std::for_each(pass.outputs.begin(), pass.outputs.end(), useBuffer);
+
                 if constexpr (std::is_same_v<T, FGBRenderPassInfo>) {
-                    std::unordered_set<ResourceRef> descriptorSetsUsed;
                     std::vector<RenderPipelineImageInfo> inputAttachments;
                     std::vector<RenderPipelineImageInfo> colorAttachments;
                     RenderPipelineImageInfo depthStencilAttachment{};
 
-                    std::vector<std::pair<ResourceRef, vk::ImageLayout>> imageLayoutsToTransition;
-                    std::vector<std::pair<ResourceRef, vk::AccessFlags>> imageAccessesToTransition;
-
+                    // Layouts are already transitioned by the barrier, the render pass keeps them as is
                     for(const auto& input: pass.inputs) {
-                        switch(input.type) {
-                            case FGBResourceType::Image:
-                                if(imageLayouts[imageLocations[input]] != vk::ImageLayout::eShaderReadOnlyOptimal) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[input], vk::ImageLayout::eShaderReadOnlyOptimal);
-                                }
-                                if(imageAccesses[imageLocations[input]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[input], vk::AccessFlagBits::eShaderRead);
-                                }
-                                inputAttachments.push_back(RenderPipelineImageInfo{
-                                        .image = imageLocations[input],
-                                        .initialLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-                                        .finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-                                        .loadOp = vk::AttachmentLoadOp::eLoad,
-                                        .storeOp = vk::AttachmentStoreOp::eDontCare,
-                                });
-                                break;
-                            case FGBResourceType::DepthStencil:
-                                if(imageLayouts[imageLocations[input]] != vk::ImageLayout::eDepthStencilReadOnlyOptimal) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[input], vk::ImageLayout::eDepthStencilReadOnlyOptimal);
-                                }
-                                if(imageAccesses[imageLocations[input]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[input], vk::AccessFlagBits::eShaderRead);
-                                }
-                                inputAttachments.push_back(RenderPipelineImageInfo{
-                                        .image = imageLocations[input],
-                                        .initialLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
-                                        .finalLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
-                                        .loadOp = vk::AttachmentLoadOp::eLoad,
-                                        .storeOp = vk::AttachmentStoreOp::eDontCare,
-                                });
-                                break;
-                            case FGBResourceType::UniformSampledImage: {
-                                const auto& uniform = std::get<FGBUniformSampledImageInfo>(m_uniforms[input.location]);
-                                ResourceRef imageRef = uniform.image.has_value() ? imageLocations[*uniform.image] : (*uniform.texture)->getImage();
-                                if(imageLayouts[imageRef] != vk::ImageLayout::eShaderReadOnlyOptimal) {
-                                    imageLayoutsToTransition.emplace_back(imageRef, vk::ImageLayout::eShaderReadOnlyOptimal);
-                                }
-                                if(imageAccesses[imageRef] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageRef, vk::AccessFlagBits::eShaderRead);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            case FGBResourceType::UniformStorageImage: {
-                                const auto& imageRef = std::get<FGBUniformStorageImageInfo>(m_uniforms[input.location]).image;
-                                if(imageLayouts[imageLocations[imageRef]] != vk::ImageLayout::eGeneral) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[imageRef], vk::ImageLayout::eGeneral);
-                                }
-                                if(imageAccesses[imageLocations[imageRef]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[input], vk::AccessFlagBits::eShaderRead);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            case FGBResourceType::UniformBuffer: {
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            default:
-                                throw std::runtime_error("Invalid input type");
-                        }
+                        if(input.type != FGBResourceType::Image && input.type != FGBResourceType::DepthStencil)
+                            continue;
+
+                        ResourceRef image = imageLocations[input];
+                        inputAttachments.push_back(RenderPipelineImageInfo{
+                                .image = image,
+                                .initialLayout = imageStates[image].layout,
+                                .finalLayout = imageStates[image].layout,
+                                .loadOp = vk::AttachmentLoadOp::eLoad,
+                                .storeOp = vk::AttachmentStoreOp::eDontCare,
+                        });
                     }
                     for(const auto& output: pass.outputs) {
                         switch(output.type) {
                             case FGBResourceType::Image: {
-                                auto [_, shouldClear] = imagesUsed.insert(output);
+                                auto [_, shouldClear] = imagesUsed.insert(imageLocations[output]);
                                 colorAttachments.push_back(RenderPipelineImageInfo{
                                         .image = imageLocations[output],
-                                        .initialLayout = imageLayouts[imageLocations[output]],
+                                        .initialLayout = vk::ImageLayout::eColorAttachmentOptimal,
                                         .finalLayout = vk::ImageLayout::eColorAttachmentOptimal,
                                         .loadOp = shouldClear ? vk::AttachmentLoadOp::eClear
                                                               : vk::AttachmentLoadOp::eLoad,
                                         .storeOp = vk::AttachmentStoreOp::eStore,
                                 });
-                                imageLayouts[imageLocations[output]] = vk::ImageLayout::eColorAttachmentOptimal;
-                                imageAccesses[imageLocations[output]] = vk::AccessFlagBits::eColorAttachmentWrite;
                                 break;
                             }
                             case FGBResourceType::DepthStencil: {
-                                auto [_, shouldClear] = imagesUsed.insert(output);
+                                auto [_, shouldClear] = imagesUsed.insert(imageLocations[output]);
                                 depthStencilAttachment = RenderPipelineImageInfo{
                                         .image = imageLocations[output],
-                                        .initialLayout = imageLayouts[imageLocations[output]],
+                                        .initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
                                         .finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
                                         .loadOp = shouldClear ? vk::AttachmentLoadOp::eClear
                                                               : vk::AttachmentLoadOp::eLoad,
                                         .storeOp = vk::AttachmentStoreOp::eStore,
                                 };
-                                imageLayouts[imageLocations[output]] = vk::ImageLayout::eDepthStencilAttachmentOptimal;
-                                imageAccesses[imageLocations[output]] = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
                                 break;
                             }
-                            case FGBResourceType::UniformStorageImage: {
-                                const auto& imageRef = std::get<FGBUniformStorageImageInfo>(m_uniforms[output.location]).image;
-                                if(imageLayouts[imageLocations[imageRef]] != vk::ImageLayout::eGeneral) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[imageRef], vk::ImageLayout::eGeneral);
-                                }
-                                if(imageAccesses[imageLocations[imageRef]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[output], vk::AccessFlagBits::eShaderWrite);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[output.location]);
+                            case FGBResourceType::UniformStorageImage:
+                                imagesUsed.insert(imageLocations[std::get<FGBUniformStorageImageInfo>(m_uniforms[output.location]).image]);
+                                break;
+                            case FGBResourceType::UniformStorageBuffer:
                                 break;
-                            }
                             default:
                                 throw std::runtime_error("Invalid output type");
                         }
                     }
 
-                    if(!imageLayoutsToTransition.empty()) {
-                        std::vector<ImageBarrierInfo> imageBarriers;
-                        for(const auto& [image, layout]: imageLayoutsToTransition) {
-                            vk::AccessFlags newAccess;
-                            for (const auto& item: imageAccessesToTransition) {
-                                if(item.first == image) {
-                                    newAccess = item.second;
-                                    break;
-                                }
-                            }
-                            imageBarriers.push_back(ImageBarrierInfo{
-                                    .image = image,
-                                    .oldLayout = imageLayouts[image],
-                                    .newLayout = layout,
-                                    .srcAccessMask = imageAccesses[image],
-                                    .dstAccessMask = newAccess,
-                            });
-                        }
-
-                        barrier = PipelineBarrierCommand{
-                            .srcStage = vk::PipelineStageFlagBits::eAllCommands,
-                            .dstStage = vk::PipelineStageFlagBits::eAllGraphics,
-                            .imageMemoryBarriers = imageBarriers,
-                            .bufferMemoryBarriers = {},
-                        };
-                    }
-
                     std::vector<vk::ClearValue> clearValues;
                     for(const auto& colorAttachment: colorAttachments) {
                         clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
@@ -502,13 +1441,9 @@ namespace vanguard {
                         clearValues.emplace_back(dv);
                     }
 
-                    std::vector<ResourceRef> descriptorSetLayouts;
-                    for(const auto& descriptorSet: descriptorSetsUsed) {
-                        descriptorSetLayouts.push_back(uniformDescriptorMap[descriptorSet]);
-                    }
-
                     ResourceRef pipeline = RENDER_SYSTEM.getResourceManager().createRenderPipeline(RenderPipelineInfo{
                             .descriptorSetLayouts = descriptorSetLayouts,
+                            .pushConstantRanges = pass.pushConstants,
                             .inputAttachments = inputAttachments,
                             .colorAttachments = colorAttachments,
                             .depthStencilAttachment = depthStencilAttachment,
@@ -520,138 +1455,188 @@ namespace vanguard {
                             .fragmentShaderPath = pass.fragmentShaderPath,
                             .vertexInputData = pass.vertexInputData,
                     });
-                    renderPasses.push_back(pipeline);
-                    return Command(RenderPipelineCommand{
+                    renderPipelines.push_back(pipeline);
+                    graph.m_pipelineExtents.emplace_back(pipeline, pass.extent);
+                    data.pipeline = pipeline;
+                    RenderPipelineCommand command{
                         .pipeline = pipeline,
                         .clearValues = clearValues,
-                        .execution = [callback = pass.callback, pipeline, descriptorSets = graph.m_descriptorSets](vk::CommandBuffer commandBuffer) {
-                            callback(commandBuffer, pipeline, descriptorSets);
+                        .execution = [callback = pass.callback, data = &data](vk::CommandBuffer commandBuffer) {
+                            callback(FGBPassContext(commandBuffer, *data));
                         },
-                    });
-                } else if constexpr (std::is_same_v<T, FGBComputePassInfo>) {
-                    std::unordered_set<ResourceRef> descriptorSetsUsed;
-                    std::vector<std::pair<ResourceRef, vk::ImageLayout>> imageLayoutsToTransition;
-                    std::vector<std::pair<ResourceRef, vk::AccessFlags>> imageAccessesToTransition;
-
-                    for(const auto& input: pass.inputs) {
-                        switch(input.type) {
-                            case FGBResourceType::UniformSampledImage: {
-                                const auto& uniform = std::get<FGBUniformSampledImageInfo>(m_uniforms[input.location]);
-                                ResourceRef imageRef = uniform.image.has_value() ? imageLocations[*uniform.image] : (*uniform.texture)->getImage();
-                                if(imageLayouts[imageRef] != vk::ImageLayout::eShaderReadOnlyOptimal) {
-                                    imageLayoutsToTransition.emplace_back(imageRef, vk::ImageLayout::eShaderReadOnlyOptimal);
-                                }
-                                if(imageAccesses[imageRef] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageRef, vk::AccessFlagBits::eShaderRead);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            case FGBResourceType::UniformStorageImage: {
-                                const auto& imageRef = std::get<FGBUniformStorageImageInfo>(m_uniforms[input.location]).image;
-                                if(imageLayouts[imageLocations[imageRef]] != vk::ImageLayout::eGeneral) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[imageRef], vk::ImageLayout::eGeneral);
-                                }
-                                if(imageAccesses[imageLocations[imageRef]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[input], vk::AccessFlagBits::eShaderRead);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            case FGBResourceType::UniformBuffer: {
-                                descriptorSetsUsed.insert(uniformDescriptorMap[input.location]);
-                                break;
-                            }
-                            default:
-                                throw std::runtime_error("Invalid input type");
-                        }
+                    };
+                    if(m_profiling) {
+                        command.profileIndex = static_cast<uint32_t>(profiledPasses.size());
+                        profiledPasses.push_back(getPassName(passInfo));
                     }
-                    for(const auto& output: pass.outputs) {
-                        switch(output.type) {
-                            case FGBResourceType::UniformStorageImage: {
-                                const auto& imageRef = std::get<FGBUniformStorageImageInfo>(m_uniforms[output.location]).image;
-                                if(imageLayouts[imageLocations[imageRef]] != vk::ImageLayout::eGeneral) {
-                                    imageLayoutsToTransition.emplace_back(imageLocations[imageRef], vk::ImageLayout::eGeneral);
-                                }
-                                if(imageAccesses[imageLocations[imageRef]] != vk::AccessFlagBits::eShaderRead) {
-                                    imageAccessesToTransition.emplace_back(imageLocations[output], vk::AccessFlagBits::eShaderWrite);
-                                }
-                                descriptorSetsUsed.insert(uniformDescriptorMap[output.location]);
-                                break;
-                            }
-                            default:
-                                throw std::runtime_error("Invalid output type");
-                        }
-                    }
-
-                    if(!imageLayoutsToTransition.empty()) {
-                        std::vector<ImageBarrierInfo> imageBarriers;
-                        for(const auto& [image, layout]: imageLayoutsToTransition) {
-                            vk::AccessFlags newAccess;
-                            for (const auto& item: imageAccessesToTransition) {
-                                if(item.first == image) {
-                                    newAccess = item.second;
-                                    break;
-                                }
-                            }
-                            imageBarriers.push_back(ImageBarrierInfo{
-                                    .image = image,
-                                    .oldLayout = imageLayouts[image],
-                                    .newLayout = layout,
-                                    .srcAccessMask = imageAccesses[image],
-                                    .dstAccessMask = newAccess,
-                            });
-                        }
-
-                        barrier = PipelineBarrierCommand{
-                                .srcStage = vk::PipelineStageFlagBits::eAllCommands,
-                                .dstStage = vk::PipelineStageFlagBits::eAllGraphics,
-                                .imageMemoryBarriers = imageBarriers,
-                                .bufferMemoryBarriers = {},
+                    if(pass.batchCallback && pass.batchCount > 0) {
+                        command.batchCount = pass.batchCount;
+                        command.batchExecution = [callback = pass.batchCallback, data = &data](vk::CommandBuffer commandBuffer, uint32_t batch) {
+                            callback(FGBPassContext(commandBuffer, *data), batch);
                         };
                     }
-
-                    std::vector<ResourceRef> descriptorSetLayouts;
-                    for(const auto& descriptorSet: descriptorSetsUsed) {
-                        descriptorSetLayouts.push_back(uniformDescriptorMap[descriptorSet]);
+                    return Command(command);
+                } else if constexpr (std::is_same_v<T, FGBComputePassInfo>) {
+                    for(const auto& output: pass.outputs) {
+                        if(output.type != FGBResourceType::UniformStorageImage && output.type != FGBResourceType::UniformStorageBuffer)
+                            throw std::runtime_error("Invalid output type");
                     }
 
                     ResourceRef pipeline = RENDER_SYSTEM.getResourceManager().createComputePipeline(ComputePipelineInfo{
                         .descriptorSetLayouts = descriptorSetLayouts,
+                        .pushConstantRanges = pass.pushConstants,
                         .computeShaderPath = pass.computeShaderPath,
                     });
-
-                    return Command(ComputePipelineCommand{
+                    computePipelines.push_back(pipeline);
+                    data.pipeline = pipeline;
+                    ComputePipelineCommand command{
                         .pipeline = pipeline,
-                        .execution = [callback = pass.callback, pipeline, descriptorSets = graph.m_descriptorSets](vk::CommandBuffer commandBuffer) {
-                            callback(commandBuffer, pipeline, descriptorSets);
+                        .execution = [callback = pass.callback, data = &data](vk::CommandBuffer commandBuffer) {
+                            callback(FGBPassContext(commandBuffer, *data));
                         },
-                    });
+                    };
+                    if(m_profiling) {
+                        command.profileIndex = static_cast<uint32_t>(profiledPasses.size());
+                        profiledPasses.push_back(getPassName(passInfo));
+                    }
+                    return Command(command);
                 } else {
                     static_assert(always_false<T>, "non-exhaustive visitor!");
                 }
             }, passInfo);
-            if(barrier.has_value()) {
-                commands.emplace_back(*barrier);
-            }
-            commands.emplace_back(command);
+            submissions.back().commands.emplace_back(command);
         }
 
-        std::unordered_map<uint32_t, PipelineBarrierCommand> pipelineBarrierMap;
-        for(const auto& [barrier, index]: pipelineBarriers) {
-            pipelineBarrierMap[index] = barrier;
+        // Every pipeline was queued above, so waiting here overlaps all of their compilation
+        if(m_pipelineCompilation == FGBPipelineCompilation::Wait) {
+            Timer compileTimer;
+            for (ResourceRef pipeline: renderPipelines)
+                RENDER_SYSTEM.getResourceManager().getRenderPipeline(pipeline).pipeline->wait();
+            for (ResourceRef pipeline: computePipelines)
+                RENDER_SYSTEM.getResourceManager().getComputePipeline(pipeline).pipeline->wait();
+            DEBUG("Frame graph waited {:.2f}ms for {} pipelines to compile", compileTimer.elapsedMillis(),
+                  renderPipelines.size() + computePipelines.size());
         }
 
+        // The blit and present follow the last graphics submission, which has to cover all the compute work
+        // and own the backbuffer
+        int64_t lastComputeSubmission = -1;
+        for (uint32_t i = 0; i < submissions.size(); ++i) {
+            if(submissions[i].queue == CommandQueue::Compute)
+                lastComputeSubmission = i;
+        }
+        if(submissions.empty() || submissions.back().queue != CommandQueue::Graphics)
+            submissions.push_back(CommandSubmission{ .queue = CommandQueue::Graphics });
+        if(lastComputeSubmission >= 0)
+            waitOnSubmission(CommandQueue::Graphics, static_cast<uint32_t>(lastComputeSubmission));
+
+        auto& backbufferState = imageStates[backbufferImage];
+        if(backbufferState.queue != CommandQueue::Graphics) {
+            PipelineBarrierCommand acquire{};
+            transferOwnership(backbufferImage, backbufferState, vk::ImageLayout::eTransferSrcOptimal, vk::AccessFlagBits::eTransferRead,
+                              vk::PipelineStageFlagBits::eTransfer, acquire);
+            submissions.back().commands.emplace_back(acquire);
+            backbufferState = FGBImageState{
+                .layout = vk::ImageLayout::eTransferSrcOptimal,
+                .writeAccess = vk::AccessFlagBits::eTransferRead,
+            };
+        }
+        DEBUG("Frame graph generated {} barriers for {} passes, {} transitions elided, {} submissions with {} ownership transfers",
+              barrierCount, passOrder.size(), elidedTransitions, submissions.size(), ownershipTransfers);
+
         CommandsInfo commandsInfo;
-        commandsInfo.backbufferImage = imageLocations[m_backbuffer];
-        commandsInfo.backbufferImageAccessMask = imageAccesses[imageLocations[m_backbuffer]];
-        commandsInfo.backbufferImageLayout = imageLayouts[imageLocations[m_backbuffer]];
-        commandsInfo.commands = commands;
+        commandsInfo.backbufferImage = backbufferImage;
+        commandsInfo.backbufferImageAccessMask = backbufferState.writeAccess;
+        commandsInfo.backbufferImageLayout = backbufferState.layout;
+        commandsInfo.submissions = submissions;
+        commandsInfo.profiledPasses = profiledPasses;
 
+        graph.m_passSchedule = passOrder;
         graph.m_samplers = samplers;
-        graph.m_pipelines = renderPasses;
+        graph.m_pipelines = renderPipelines;
+        graph.m_computePipelines = computePipelines;
         graph.m_commands = commandsInfo;
 
         return graph;
     }
-}
\ No newline at end of file
+
+    void FrameGraph::resize() {
+        Timer timer;
+        auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+
+        std::unordered_map<ResourceRef, vk::Extent2D> resizedImages;
+        for (const auto& [image, extent]: m_swapchainImages) {
+            vk::Extent2D actual{ toActualWidth(extent.width), toActualHeight(extent.height) };
+            const auto& info = resourceManager.getImage(image).info;
+            if(info.width != actual.width || info.height != actual.height)
+                resizedImages.emplace(image, actual);
+        }
+        if(resizedImages.empty())
+            return;
+
+        // Aliased memory is sized for the largest image living in it, so it's reallocated for the new sizes and
+        // every image in it is rebound, including the ones that kept their size
+        std::unordered_set<ResourceRef> resizedMemory;
+        for (const auto& [image, _]: resizedImages) {
+            ResourceRef memory = resourceManager.getImage(image).info.memory;
+            if(memory != UNDEFINED_RESOURCE)
+                resizedMemory.insert(memory);
+        }
+        for (ResourceRef memory: resizedMemory) {
+            vk::MemoryRequirements requirements{ .memoryTypeBits = ~0u };
+            for (ResourceRef image: m_images) {
+                ImageInfo info = resourceManager.getImage(image).info;
+                if(info.memory != memory)
+                    continue;
+                auto resized = resizedImages.find(image);
+                if(resized != resizedImages.end()) {
+                    info.width = resized->second.width;
+                    info.height = resized->second.height;
+                }
+                else {
+                    resizedImages.emplace(image, vk::Extent2D{ info.width, info.height });
+                }
+                auto imageRequirements = ImagePool::getMemoryRequirements(info);
+                requirements.size = std::max(requirements.size, imageRequirements.size);
+                requirements.alignment = std::max(requirements.alignment, imageRequirements.alignment);
+                requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+            }
+            resourceManager.resizeMemory(memory, requirements);
+        }
+        for (const auto& [image, extent]: resizedImages)
+            resourceManager.resizeImage(image, extent.width, extent.height);
+
+        uint32_t framebufferCount = 0;
+        for (const auto& [pipeline, extent]: m_pipelineExtents) {
+            const auto& info = resourceManager.getRenderPipeline(pipeline).info;
+            bool attachmentResized = resizedImages.contains(info.depthStencilAttachment.image);
+            for (const auto& attachment: info.inputAttachments)
+                attachmentResized |= resizedImages.contains(attachment.image);
+            for (const auto& attachment: info.colorAttachments)
+                attachmentResized |= resizedImages.contains(attachment.image);
+            if(!attachmentResized && extent.width != FGB_SWAPCHAIN_EXTENT && extent.height != FGB_SWAPCHAIN_EXTENT)
+                continue;
+            resourceManager.resizeFramebuffer(pipeline, { toActualWidth(extent.width), toActualHeight(extent.height) });
+            framebufferCount++;
+        }
+
+        // Sets of frames still in flight can't be touched, each frame's sets are rewritten once its fence signals
+        uint32_t descriptorSetCount = 0;
+        for (const auto& [location, frameWrites]: m_descriptorWrites) {
+            for (uint32_t i = 0; i < frameWrites.size(); i++) {
+                std::vector<DescriptorSetWrite> writes;
+                for (const auto& write: frameWrites[i]) {
+                    if(write.image.has_value() && resizedImages.contains(write.image->image))
+                        writes.push_back(write);
+                }
+                if(writes.empty())
+                    continue;
+                RENDER_SYSTEM.updateDescriptorSetForFrame(i, m_descriptorSets.at(location).getDescriptorSet(i), std::move(writes));
+                descriptorSetCount++;
+            }
+        }
+
+        INFO("Frame graph resized {} images, {} framebuffers and {} descriptor sets in {:.2f}ms",
+             resizedImages.size(), framebufferCount, descriptorSetCount, timer.elapsedMillis());
+    }
+}
@@ -7,6 +7,51 @@
 #include "Texture.h"
 
 namespace vanguard {
+    // Frame Graph Builder Resource Ref
+    enum class FGBResourceType {
+        Image,
+        DepthStencil,
+        Buffer,
+        UniformBuffer,
+        UniformStorageBuffer,
+        UniformSampledImage,
+        UniformStorageImage,
+        UniformTransientBuffer,
+        RenderPass,
+        ComputePass
+    };
+
+    const uint32_t FGB_UNDEFINED_RESOURCE = UINT32_MAX;
+    const uint32_t FGB_SWAPCHAIN_EXTENT = UINT32_MAX;
+
+    struct FGBResourceRef {
+        FGBResourceRef() = default;
+        FGBResourceRef(FGBResourceType type, uint32_t location) : type(type), location(location) {}
+
+        bool operator == (const FGBResourceRef& other) const {
+            return type == other.type && location == other.location;
+        }
+
+        FGBResourceRef& operator=(const FGBResourceRef&) = default;
+
+        FGBResourceType type = FGBResourceType::Image;
+        uint32_t location = FGB_UNDEFINED_RESOURCE;
+    };
+}
+
+template <>
+struct std::hash<vanguard::FGBResourceRef> {
+    std::size_t operator()(const vanguard::FGBResourceRef& ref) const {
+        return (std::hash<uint32_t>()(ref.location) << 4) | std::hash<uint32_t>()(static_cast<uint32_t>(ref.type));
+    }
+};
+
+namespace vanguard {
+    struct FGBExtent {
+        uint32_t width = FGB_SWAPCHAIN_EXTENT;
+        uint32_t height = FGB_SWAPCHAIN_EXTENT;
+    };
+
     class FrameGraph {
     public:
         FrameGraph() = default;
@@ -20,11 +65,15 @@ namespace vanguard {
 
         [[nodiscard]] const CommandsInfo& getCommands() const { return m_commands; }
 
+        // Recreates the images sized relative to the swapchain along with the framebuffers and descriptors using
+        // them. References stay the same, so the baked commands remain valid and nothing waits for the device.
+        void resize();
+
         class DescriptorSet {
         public:
             DescriptorSet() = default;
-            DescriptorSet(uint32_t location, ResourceRef layout, std::vector<ResourceRef> descriptorSets) :
-                m_location(location), m_descriptorSetLayout(layout), m_descriptorSets(std::move(descriptorSets)) {}
+            DescriptorSet(uint32_t location, ResourceRef layout, std::vector<ResourceRef> descriptorSets, uint32_t dynamicOffsetCount = 0) :
+                m_location(location), m_descriptorSetLayout(layout), m_descriptorSets(std::move(descriptorSets)), m_dynamicOffsetCount(dynamicOffsetCount) {}
             void destroy() {
                 if(m_descriptorSetLayout == UNDEFINED_RESOURCE) return;
 
@@ -34,68 +83,85 @@ namespace vanguard {
                 RENDER_SYSTEM.getResourceManager().destroyDescriptorSetLayout(m_descriptorSetLayout);
             }
 
-            void bindGraphics(ResourceRef pipeline, vk::CommandBuffer cmd) const {
-                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *RENDER_SYSTEM.getResourceManager().getRenderPipeline(pipeline).pipelineLayout,
-                                       0, *getDescriptorSet().set, {});
+            // Sets with transient buffers take one dynamic offset per transient buffer, in binding order
+            void bindGraphics(ResourceRef pipeline, vk::CommandBuffer cmd, vk::ArrayProxy<const uint32_t> dynamicOffsets = {}) const {
+                validateDynamicOffsets(dynamicOffsets.size());
+                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, **RENDER_SYSTEM.getResourceManager().getRenderPipeline(pipeline).pipelineLayout,
+                                       m_location, *getDescriptorSet().set, dynamicOffsets);
             }
-            void bindCompute(ResourceRef pipeline, vk::CommandBuffer cmd) const {
-                cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *RENDER_SYSTEM.getResourceManager().getComputePipeline(pipeline).pipelineLayout,
-                                       0, *getDescriptorSet().set, {});
+            void bindCompute(ResourceRef pipeline, vk::CommandBuffer cmd, vk::ArrayProxy<const uint32_t> dynamicOffsets = {}) const {
+                validateDynamicOffsets(dynamicOffsets.size());
+                cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, **RENDER_SYSTEM.getResourceManager().getComputePipeline(pipeline).pipelineLayout,
+                                       m_location, *getDescriptorSet().set, dynamicOffsets);
             }
             [[nodiscard]] const vanguard::DescriptorSet& getDescriptorSet() const {
                 return RENDER_SYSTEM.getResourceManager().getDescriptorSet(m_descriptorSets[RENDER_SYSTEM.getFrameIndex()]);
             }
+            [[nodiscard]] ResourceRef getDescriptorSet(uint32_t frameIndex) const { return m_descriptorSets[frameIndex]; }
             [[nodiscard]] uint32_t getLocation() const { return m_location; }
+            [[nodiscard]] uint32_t getDynamicOffsetCount() const { return m_dynamicOffsetCount; }
+        private:
+            void validateDynamicOffsets(uint32_t count) const {
+                if(count != m_dynamicOffsetCount)
+                    throw std::runtime_error("Descriptor set needs one dynamic offset per transient buffer");
+            }
         private:
             uint32_t m_location = 0;
             ResourceRef m_descriptorSetLayout = UNDEFINED_RESOURCE;
             std::vector<ResourceRef> m_descriptorSets;
+            uint32_t m_dynamicOffsetCount = 0;
+        };
+
+        // Everything a pass needs while recording, resolved once at bake time
+        struct PassData {
+            ResourceRef pipeline = UNDEFINED_RESOURCE;
+            vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+            // Indexed by set location, null where the pass doesn't use a set
+            std::vector<const DescriptorSet*> descriptorSets;
+            // Location of the global bindless set in the pipeline layout, UINT32_MAX when the graph doesn't use it
+            uint32_t bindlessLocation = UINT32_MAX;
+            // Location of the push descriptor set, UINT32_MAX when the graph doesn't use one
+            uint32_t pushDescriptorLocation = UINT32_MAX;
+            std::vector<vk::PushConstantRange> pushConstants;
+            std::vector<std::pair<FGBResourceRef, ResourceRef>> images;
+            // Keyed by both the graph buffer and the storage buffer uniforms referring to it
+            std::vector<std::pair<FGBResourceRef, ResourceRef>> buffers;
+            // Declared range of every transient buffer the pass uses
+            std::vector<std::pair<FGBResourceRef, uint32_t>> transientRanges;
         };
 
         [[nodiscard]] const std::unordered_map<uint32_t, FrameGraph::DescriptorSet>& getDescriptorSets() const { return m_descriptorSets; }
+        // Builder pass indices in the order they are executed, culled passes are left out
+        [[nodiscard]] const std::vector<uint32_t>& getPassSchedule() const { return m_passSchedule; }
+        // Image behind a resource passed to FrameGraphBuilder::exportResource
+        [[nodiscard]] ResourceRef getExportedImage(const FGBResourceRef& resource) const { return m_exportedImages.at(resource); }
+        [[nodiscard]] ResourceRef getExportedBuffer(const FGBResourceRef& resource) const { return m_exportedBuffers.at(resource); }
 
         friend class FrameGraphBuilder;
     private:
         CommandsInfo m_commands;
 
         std::vector<ResourceRef> m_images;
+        std::vector<ResourceRef> m_memory;
+        std::vector<ResourceRef> m_buffers;
+        // Imported storage buffers rewrite these descriptor sets when they grow
+        std::vector<std::pair<UniformStorageBuffer*, ResourceRef>> m_storageBufferBindings;
         std::vector<ResourceRef> m_samplers;
         std::vector<ResourceRef> m_pipelines;
+        std::vector<ResourceRef> m_computePipelines;
         std::unordered_map<uint32_t, DescriptorSet> m_descriptorSets;
-    };
-
-    // Frame Graph Builder Resource Ref
-    enum class FGBResourceType {
-        Image,
-        DepthStencil,
-        UniformBuffer,
-        UniformStorageBuffer,
-        UniformSampledImage,
-        UniformStorageImage,
-        RenderPass,
-        ComputePass
-    };
-
-    const uint32_t FGB_UNDEFINED_RESOURCE = UINT32_MAX;
-    const uint32_t FGB_SWAPCHAIN_EXTENT = UINT32_MAX;
-
-    struct FGBResourceRef {
-        FGBResourceRef() = default;
-        FGBResourceRef(FGBResourceType type, uint32_t location) : type(type), location(location) {}
-
-        bool operator == (const FGBResourceRef& other) const {
-            return type == other.type && location == other.location;
-        }
-
-        FGBResourceRef& operator=(const FGBResourceRef&) = default;
-
-        FGBResourceType type = FGBResourceType::Image;
-        uint32_t location = FGB_UNDEFINED_RESOURCE;
-    };
-
-    struct FGBExtent {
-        uint32_t width = FGB_SWAPCHAIN_EXTENT;
-        uint32_t height = FGB_SWAPCHAIN_EXTENT;
+        // Per location and frame, kept to rewrite image descriptors after a resize
+        std::unordered_map<uint32_t, std::vector<std::vector<DescriptorSetWrite>>> m_descriptorWrites;
+        // Images which follow the swapchain extent, and the extent every render pipeline was baked with
+        std::vector<std::pair<ResourceRef, FGBExtent>> m_swapchainImages;
+        std::vector<std::pair<ResourceRef, FGBExtent>> m_pipelineExtents;
+        ResourceRef m_emptyDescriptorSetLayout = UNDEFINED_RESOURCE;
+        ResourceRef m_pushDescriptorSetLayout = UNDEFINED_RESOURCE;
+        // Heap allocated so the command callbacks can point at them across moves
+        std::vector<std::unique_ptr<PassData>> m_passData;
+        std::unordered_map<FGBResourceRef, ResourceRef> m_exportedImages;
+        std::unordered_map<FGBResourceRef, ResourceRef> m_exportedBuffers;
+        std::vector<uint32_t> m_passSchedule;
     };
 
     struct FGBImageInfo {
@@ -108,9 +174,115 @@ namespace vanguard {
         FGBExtent extent{};
     };
 
-    // Command Buffer, Pipeline, Descriptor Sets
-    typedef std::function<void(vk::CommandBuffer, ResourceRef, std::unordered_map<uint32_t, FrameGraph::DescriptorSet>)> FGBPassCallback;
+    struct FGBBufferInfo {
+        vk::DeviceSize size = 0;
+        // On top of storage usage, eg. eIndirectBuffer for GPU generated draws
+        vk::BufferUsageFlags usage{};
+    };
+
+    // Handed to pass callbacks by reference, only points at data the frame graph owns so creating one is free
+    class FGBPassContext {
+    public:
+        FGBPassContext(vk::CommandBuffer commandBuffer, const FrameGraph::PassData& data) : m_commandBuffer(commandBuffer), m_data(data) {}
+
+        [[nodiscard]] vk::CommandBuffer getCommandBuffer() const { return m_commandBuffer; }
+        [[nodiscard]] ResourceRef getPipeline() const { return m_data.pipeline; }
+        [[nodiscard]] vk::PipelineLayout getPipelineLayout() const {
+            auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+            if(m_data.bindPoint == vk::PipelineBindPoint::eGraphics)
+                return **resourceManager.getRenderPipeline(m_data.pipeline).pipelineLayout;
+            return **resourceManager.getComputePipeline(m_data.pipeline).pipelineLayout;
+        }
+
+        [[nodiscard]] const FrameGraph::DescriptorSet& getDescriptorSet(uint32_t location) const {
+            if(location >= m_data.descriptorSets.size() || m_data.descriptorSets[location] == nullptr)
+                throw std::runtime_error("Pass doesn't use a descriptor set at this location");
+            return *m_data.descriptorSets[location];
+        }
+        // Binds the current frame's set at its location, sets with transient buffers take one offset from
+        // writeTransient per transient buffer in binding order
+        void bindDescriptorSet(uint32_t location, vk::ArrayProxy<const uint32_t> dynamicOffsets = {}) const {
+            const auto& set = getDescriptorSet(location);
+            if(m_data.bindPoint == vk::PipelineBindPoint::eGraphics)
+                set.bindGraphics(m_data.pipeline, m_commandBuffer, dynamicOffsets);
+            else
+                set.bindCompute(m_data.pipeline, m_commandBuffer, dynamicOffsets);
+        }
+        // Copies per draw data into this frame's slice of the transient buffer, returns its dynamic offset
+        template <typename T> requires std::is_trivially_copyable_v<T>
+        [[nodiscard]] uint32_t writeTransient(const FGBResourceRef& buffer, const T& data) const {
+            for (const auto& [reference, range]: m_data.transientRanges) {
+                if(!(reference == buffer))
+                    continue;
+                if(sizeof(T) > range)
+                    throw std::runtime_error("Transient data is larger than the buffer's declared range");
+                return RENDER_SYSTEM.getTransientBuffers().write(data);
+            }
+            throw std::runtime_error("Transient buffer isn't used by this pass");
+        }
+        // Bound once per pass, draws pick their resources by index instead of rebinding sets
+        void bindBindlessDescriptorSet() const {
+            if(m_data.bindlessLocation == UINT32_MAX)
+                throw std::runtime_error("Frame graph doesn't use bindless descriptors");
+            m_commandBuffer.bindDescriptorSets(m_data.bindPoint, getPipelineLayout(), m_data.bindlessLocation,
+                                               RENDER_SYSTEM.getResourceManager().getBindlessDescriptors().getDescriptorSet(), {});
+        }
+        // Writes the pass' push descriptor set straight into the command buffer, meant for small bindings which
+        // change per draw
+        void pushDescriptorSet(const std::vector<DescriptorSetWrite>& writes) const {
+            if(m_data.pushDescriptorLocation == UINT32_MAX)
+                throw std::runtime_error("Frame graph doesn't use a push descriptor set");
+            ResourceManager::cmdPushDescriptorSet(m_commandBuffer, m_data.bindPoint, getPipelineLayout(), m_data.pushDescriptorLocation, writes);
+        }
+        // Every declared range overlapping the written bytes has its stages included, as vkCmdPushConstants requires
+        template <typename T> requires std::is_trivially_copyable_v<T>
+        void pushConstants(const T& data, uint32_t offset = 0) const {
+            vk::ShaderStageFlags stages{};
+            for (const auto& range: m_data.pushConstants) {
+                if(offset < range.offset + range.size && range.offset < offset + sizeof(T))
+                    stages |= range.stageFlags;
+            }
+            if(!stages)
+                throw std::runtime_error("Push constants are outside of the pass' declared ranges");
+            m_commandBuffer.pushConstants(getPipelineLayout(), stages, offset, sizeof(T), &data);
+        }
+        // Sets with transient buffers are left out, they're bound per draw with their offsets
+        void bindDescriptorSets() const {
+            for (uint32_t location = 0; location < m_data.descriptorSets.size(); location++) {
+                if(m_data.descriptorSets[location] != nullptr && m_data.descriptorSets[location]->getDynamicOffsetCount() == 0)
+                    bindDescriptorSet(location);
+            }
+            if(m_data.bindlessLocation != UINT32_MAX)
+                bindBindlessDescriptorSet();
+        }
+
+        // Image behind one of the pass' graph images
+        [[nodiscard]] ResourceRef getImage(const FGBResourceRef& image) const {
+            for (const auto& [reference, resolved]: m_data.images) {
+                if(reference == image)
+                    return resolved;
+            }
+            throw std::runtime_error("Image isn't used by this pass");
+        }
+        // Buffer behind one of the pass' graph buffers or storage buffer uniforms
+        [[nodiscard]] ResourceRef getBuffer(const FGBResourceRef& buffer) const {
+            for (const auto& [reference, resolved]: m_data.buffers) {
+                if(reference == buffer)
+                    return resolved;
+            }
+            throw std::runtime_error("Buffer isn't used by this pass");
+        }
+    private:
+        vk::CommandBuffer m_commandBuffer;
+        const FrameGraph::PassData& m_data;
+    };
+
+    typedef std::function<void(const FGBPassContext&)> FGBPassCallback;
+    // Same as FGBPassCallback plus the batch index, batches are recorded concurrently and executed in order
+    typedef std::function<void(const FGBPassContext&, uint32_t)> FGBPassBatchCallback;
     struct FGBRenderPassInfo {
+        // Only used for debugging output such as the schedule dump
+        std::string name;
         std::string vertexShaderPath;
         std::string fragmentShaderPath;
         std::vector<FGBResourceRef> inputs;
@@ -120,25 +292,50 @@ namespace vanguard {
         std::optional<VertexInputData> vertexInputData;
         bool depthTest = true;
         bool depthWrite = true;
+        // Splits large draw lists, called batchCount times after callback, possibly from worker threads
+        FGBPassBatchCallback batchCallback;
+        uint32_t batchCount = 0;
+        // Written per draw through FGBPassContext::pushConstants
+        std::vector<vk::PushConstantRange> pushConstants;
     };
     struct FGBComputePassInfo {
+        std::string name;
         std::string computeShaderPath;
         std::vector<FGBResourceRef> inputs;
         std::vector<FGBResourceRef> outputs;
         FGBPassCallback callback;
+        // Runs on the dedicated compute queue when the device has one, otherwise this does nothing
+        bool asyncCompute = false;
+        std::vector<vk::PushConstantRange> pushConstants;
     };
     typedef std::variant<FGBComputePassInfo, FGBRenderPassInfo> FGBPassInfo;
 
+    enum class FGBPipelineCompilation {
+        // Bake blocks until every pipeline has compiled, the graph's pipelines compile in parallel across all cores
+        Wait,
+        // Bake returns immediately and passes are skipped until their pipeline is ready
+        Skip
+    };
+
+    enum class FGBPassScheduling {
+        // Passes execute in the order they were added
+        InsertionOrder,
+        // Independent passes are reordered to push consumers as far away from their producers as possible
+        Dependency
+    };
+
     struct FGBUniformBufferInfo {
         uint32_t location = 0;
         uint32_t binding = 0;
         const UniformBuffer* buffer = nullptr;
     };
-//    struct FGBUniformStorageBufferInfo {
-//        uint32_t location = 0;
-//        uint32_t binding = 0;
-//        const UniformBuffer* buffer = nullptr;
-//    };
+    // Either a graph buffer or an imported one
+    struct FGBUniformStorageBufferInfo {
+        uint32_t location = 0;
+        uint32_t binding = 0;
+        std::optional<FGBResourceRef> buffer{};
+        std::optional<UniformStorageBuffer*> storageBuffer{};
+    };
     struct FGBUniformSampledImageInfo {
         uint32_t location = 0;
         uint32_t binding = 0;
@@ -151,7 +348,15 @@ namespace vanguard {
         uint32_t binding = 0;
         FGBResourceRef image{};
     };
-    typedef std::variant<FGBUniformBufferInfo, FGBUniformSampledImageInfo, FGBUniformStorageImageInfo> FGBUniformInfo;
+    // Window of range bytes into the transient buffer, moved per draw by its dynamic offset
+    struct FGBUniformTransientBufferInfo {
+        uint32_t location = 0;
+        uint32_t binding = 0;
+        uint32_t range = 0;
+        bool storage = false;
+    };
+    typedef std::variant<FGBUniformBufferInfo, FGBUniformStorageBufferInfo, FGBUniformSampledImageInfo, FGBUniformStorageImageInfo,
+                         FGBUniformTransientBufferInfo> FGBUniformInfo;
 
     class FrameGraphBuilder {
     public:
@@ -165,33 +370,62 @@ namespace vanguard {
 
         FGBResourceRef createImage(const FGBImageInfo& info = FGBImageInfo{});
         FGBResourceRef createDepthStencil(const FGBDepthStencilInfo& info = FGBDepthStencilInfo{});
+        // Transient buffer owned by the graph, as input of a render pass it's read as an indirect, vertex or index buffer
+        FGBResourceRef createBuffer(const FGBBufferInfo& info);
 
         FGBResourceRef addRenderPass(const FGBRenderPassInfo& info);
         FGBResourceRef addComputePass(const FGBComputePassInfo& info);
 
         FGBResourceRef addUniformBuffer(uint32_t location, uint32_t binding, const UniformBuffer* buffer);
+        // Read as an input, read and written as an output. Imported buffers have to outlive the baked graph.
+        FGBResourceRef addUniformStorageBuffer(uint32_t location, uint32_t binding, FGBResourceRef buffer);
+        FGBResourceRef addUniformStorageBuffer(uint32_t location, uint32_t binding, UniformStorageBuffer* buffer);
         FGBResourceRef addUniformSampledImage(uint32_t location, uint32_t binding, FGBResourceRef image, const SamplerInfo& samplerInfo = SamplerInfo{});
         FGBResourceRef addUniformSampledImage(uint32_t location, uint32_t binding, const Texture* texture, const SamplerInfo& samplerInfo = SamplerInfo{});
         FGBResourceRef addUniformStorageImage(uint32_t location, uint32_t binding, FGBResourceRef image);
+        // Per draw data bound as a dynamic uniform or storage buffer, written with FGBPassContext::writeTransient and
+        // bound by passing the offsets to FGBPassContext::bindDescriptorSet. Range is at most TRANSIENT_BUFFER_MAX_RANGE and
+        // the device's maxUniformBufferRange or maxStorageBufferRange.
+        FGBResourceRef addUniformTransientBuffer(uint32_t location, uint32_t binding, uint32_t range);
+        FGBResourceRef addStorageTransientBuffer(uint32_t location, uint32_t binding, uint32_t range);
 
         void setBackbuffer(FGBResourceRef image);
+        // Keeps an image, a buffer, or a pass, alive even if nothing leading to the backbuffer depends on it
+        void exportResource(FGBResourceRef resource);
+        // Lets images whose pass lifetimes don't overlap share the same memory, enabled by default
+        void setMemoryAliasing(bool enabled);
+        // Dependency scheduling by default, both are deterministic for the same graph
+        void setPassScheduling(FGBPassScheduling scheduling);
+        // Collects GPU timings of every pass, read them through RenderSystem::getGpuProfiler
+        void setProfiling(bool enabled);
+        // Waits by default
+        void setPipelineCompilation(FGBPipelineCompilation compilation);
+        // Adds the global BindlessDescriptors set to every pass' pipeline layout at this location, which no uniform may
+        // use. Requires Vulkan::isBindlessSupported.
+        void setBindlessLocation(uint32_t location);
+        // Adds a push descriptor set with these bindings to every pass' pipeline layout at this location, which no
+        // uniform may use. Passes write it per draw through FGBPassContext::pushDescriptorSet. Requires
+        // Vulkan::isPushDescriptorSupported.
+        void setPushDescriptorLocation(uint32_t location, std::vector<DescriptorSetBinding> bindings);
 
         [[nodiscard]] FrameGraph bake();
     private:
         std::vector<FGBImageInfo> m_images;
         std::vector<FGBDepthStencilInfo> m_depthStencils;
+        std::vector<FGBBufferInfo> m_buffers;
 
         std::vector<FGBPassInfo> m_passes;
 
         std::vector<FGBUniformInfo> m_uniforms;
 
         FGBResourceRef m_backbuffer = { FGBResourceType::Image, FGB_UNDEFINED_RESOURCE };
+        std::vector<FGBResourceRef> m_exports;
+        bool m_memoryAliasing = true;
+        FGBPassScheduling m_passScheduling = FGBPassScheduling::Dependency;
+        bool m_profiling = false;
+        FGBPipelineCompilation m_pipelineCompilation = FGBPipelineCompilation::Wait;
+        uint32_t m_bindlessLocation = UINT32_MAX;
+        uint32_t m_pushDescriptorLocation = UINT32_MAX;
+        std::vector<DescriptorSetBinding> m_pushDescriptorBindings;
     };
 }
-
-template <>
-struct std::hash<vanguard::FGBResourceRef> {
-    std::size_t operator()(const vanguard::FGBResourceRef& ref) const {
-        return (std::hash<uint32_t>()(ref.location) << 4) | std::hash<uint32_t>()(static_cast<uint32_t>(ref.type));
-    }
-};
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "GpuProfiler.h"
+#include "../Logger.h"
+#include "../Application.h"
+
+#include <numeric>
+
+namespace vanguard {
+    static constexpr vk::QueryPipelineStatisticFlags PROFILER_STATISTICS =
+            vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+            vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+            vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+            vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+    void GpuProfiler::init() {
+        auto& physicalDevice = Vulkan::getPhysicalDevice();
+        m_timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+        for (const auto& family: physicalDevice.getQueueFamilyProperties()) {
+            m_timestampValidBits.push_back(family.timestampValidBits);
+        }
+        m_frames.resize(FRAMES_IN_FLIGHT);
+    }
+
+    void GpuProfiler::setPasses(const std::vector<std::string>& passes) {
+        std::vector<PassHistory> histories;
+        for (const auto& name: passes) {
+            auto previous = std::find_if(m_passes.begin(), m_passes.end(), [&](const PassHistory& history) { return history.name == name; });
+            histories.push_back(previous != m_passes.end() ? std::move(*previous) : PassHistory{ .name = name });
+        }
+        m_passes = std::move(histories);
+
+        if(m_passes.size() > m_capacity) {
+            m_capacity = std::max<uint32_t>(m_passes.size(), m_capacity * 2);
+            for (auto& frame: m_frames) {
+                // Frames still in flight may write the old pools, they're retired instead of destroyed
+                if(frame.timestamps.has_value())
+                    RENDER_SYSTEM.getResourceManager().retire(std::move(*frame.timestamps));
+                if(frame.statistics.has_value())
+                    RENDER_SYSTEM.getResourceManager().retire(std::move(*frame.statistics));
+                frame.timestamps = Vulkan::getDevice().createQueryPool(vk::QueryPoolCreateInfo{
+                        .queryType = vk::QueryType::eTimestamp,
+                        .queryCount = m_capacity * 2,
+                });
+                frame.statistics.reset();
+                if(Vulkan::getEnabledFeatures().pipelineStatisticsQuery) {
+                    frame.statistics = Vulkan::getDevice().createQueryPool(vk::QueryPoolCreateInfo{
+                            .queryType = vk::QueryType::ePipelineStatistics,
+                            .queryCount = m_capacity,
+                            .pipelineStatistics = PROFILER_STATISTICS,
+                    });
+                }
+            }
+        }
+        // Queries already in flight belong to the old passes
+        for (auto& frame: m_frames) {
+            frame.timestampsWritten.assign(m_capacity, false);
+            frame.statisticsWritten.assign(m_capacity, false);
+        }
+    }
+
+    void GpuProfiler::resolve(uint32_t frameIndex) {
+        if(!isEnabled()) return;
+
+        auto& frame = m_frames[frameIndex];
+        for (uint32_t pass = 0; pass < m_passes.size(); pass++) {
+            auto& history = m_passes[pass];
+            if(frame.timestampsWritten[pass]) {
+                auto [result, timestamps] = frame.timestamps->getResults<uint64_t>(pass * 2, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+                if(result == vk::Result::eSuccess) {
+                    history.lastMillis = static_cast<float>(static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6);
+                    if(history.millis.size() < GPU_PROFILER_HISTORY)
+                        history.millis.push_back(history.lastMillis);
+                    else
+                        history.millis[history.next] = history.lastMillis;
+                    history.next = (history.next + 1) % GPU_PROFILER_HISTORY;
+                }
+            }
+            if(frame.statisticsWritten[pass]) {
+                auto [result, values] = frame.statistics->getResults<uint64_t>(pass, 1, 4 * sizeof(uint64_t), 4 * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+                if(result == vk::Result::eSuccess) {
+                    // Results come in the order of the flag bits
+                    history.statistics = GpuPipelineStatistics{
+                        .inputAssemblyVertices = values[0],
+                        .vertexShaderInvocations = values[1],
+                        .fragmentShaderInvocations = values[2],
+                        .computeShaderInvocations = values[3],
+                    };
+                }
+            }
+        }
+        frame.timestampsWritten.assign(m_capacity, false);
+        frame.statisticsWritten.assign(m_capacity, false);
+    }
+
+    void GpuProfiler::reset(vk::CommandBuffer commandBuffer, uint32_t frameIndex) {
+        if(!isEnabled()) return;
+
+        auto& frame = m_frames[frameIndex];
+        commandBuffer.resetQueryPool(**frame.timestamps, 0, m_capacity * 2);
+        if(frame.statistics.has_value())
+            commandBuffer.resetQueryPool(**frame.statistics, 0, m_capacity);
+    }
+
+    void GpuProfiler::beginPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t pass, uint32_t queueFamilyIndex, bool secondaries) {
+        if(pass >= m_passes.size() || m_timestampValidBits[queueFamilyIndex] == 0) return;
+
+        auto& frame = m_frames[frameIndex];
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, **frame.timestamps, pass * 2);
+        if(collectsStatistics(queueFamilyIndex, secondaries))
+            commandBuffer.beginQuery(**frame.statistics, pass, {});
+    }
+
+    void GpuProfiler::endPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t pass, uint32_t queueFamilyIndex, bool secondaries) {
+        if(pass >= m_passes.size() || m_timestampValidBits[queueFamilyIndex] == 0) return;
+
+        auto& frame = m_frames[frameIndex];
+        if(collectsStatistics(queueFamilyIndex, secondaries)) {
+            commandBuffer.endQuery(**frame.statistics, pass);
+            frame.statisticsWritten[pass] = true;
+        }
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, **frame.timestamps, pass * 2 + 1);
+        frame.timestampsWritten[pass] = true;
+    }
+
+    vk::QueryPipelineStatisticFlags GpuProfiler::getInheritedStatistics(uint32_t queueFamilyIndex) const {
+        return isEnabled() && collectsStatistics(queueFamilyIndex, true) ? PROFILER_STATISTICS : vk::QueryPipelineStatisticFlags{};
+    }
+
+    bool GpuProfiler::collectsStatistics(uint32_t queueFamilyIndex, bool secondaries) const {
+        // Graphics statistics can only be queried on graphics capable queues, and secondaries only run inside an
+        // active query with inherited queries
+        return Vulkan::getEnabledFeatures().pipelineStatisticsQuery &&
+               queueFamilyIndex == Vulkan::getQueueFamilyIndex() &&
+               (!secondaries || Vulkan::getEnabledFeatures().inheritedQueries);
+    }
+
+    std::vector<GpuPassTiming> GpuProfiler::getPassTimings() const {
+        std::vector<GpuPassTiming> timings;
+        timings.reserve(m_passes.size());
+        for (const auto& history: m_passes) {
+            timings.push_back(GpuPassTiming{
+                .name = history.name,
+                .averageMillis = history.millis.empty() ? 0.0f : std::accumulate(history.millis.begin(), history.millis.end(), 0.0f) / static_cast<float>(history.millis.size()),
+                .lastMillis = history.lastMillis,
+                .samples = static_cast<uint32_t>(history.millis.size()),
+                .statistics = history.statistics,
+            });
+        }
+        return timings;
+    }
+}
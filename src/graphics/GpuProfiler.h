@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Vulkan.h"
+#include "../Config.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vanguard {
+    struct GpuPipelineStatistics {
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t fragmentShaderInvocations = 0;
+        uint64_t computeShaderInvocations = 0;
+    };
+
+    struct GpuPassTiming {
+        std::string name;
+        // Averaged over the last GPU_PROFILER_HISTORY resolved frames
+        float averageMillis = 0.0f;
+        float lastMillis = 0.0f;
+        uint32_t samples = 0;
+        // Only filled on devices with pipelineStatisticsQuery and for passes on a graphics capable queue
+        std::optional<GpuPipelineStatistics> statistics;
+    };
+
+    constexpr uint32_t GPU_PROFILER_HISTORY = 64;
+
+    // Timestamps every profiled pass, queries of a frame are read back once its fence has been waited on again
+    // FRAMES_IN_FLIGHT frames later, so nothing ever stalls on the GPU
+    class GpuProfiler {
+    public:
+        void init();
+        // Called whenever new commands are baked, history is kept for passes that keep their name
+        void setPasses(const std::vector<std::string>& passes);
+
+        // The frame's fence has to be signaled
+        void resolve(uint32_t frameIndex);
+        // Has to be recorded before any pass of the frame, on every queue
+        void reset(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+        void beginPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t pass, uint32_t queueFamilyIndex, bool secondaries);
+        void endPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t pass, uint32_t queueFamilyIndex, bool secondaries);
+
+        // Pipeline statistics secondary command buffers have to inherit, empty if they don't collect any
+        [[nodiscard]] vk::QueryPipelineStatisticFlags getInheritedStatistics(uint32_t queueFamilyIndex) const;
+
+        [[nodiscard]] bool isEnabled() const { return !m_passes.empty(); }
+        [[nodiscard]] std::vector<GpuPassTiming> getPassTimings() const;
+    private:
+        [[nodiscard]] bool collectsStatistics(uint32_t queueFamilyIndex, bool secondaries) const;
+    private:
+        struct FrameQueries {
+            std::optional<vk::raii::QueryPool> timestamps;
+            std::optional<vk::raii::QueryPool> statistics;
+            std::vector<bool> timestampsWritten;
+            std::vector<bool> statisticsWritten;
+        };
+        struct PassHistory {
+            std::string name;
+            std::vector<float> millis;
+            uint32_t next = 0;
+            float lastMillis = 0.0f;
+            std::optional<GpuPipelineStatistics> statistics;
+        };
+
+        std::vector<FrameQueries> m_frames;
+        std::vector<PassHistory> m_passes;
+        uint32_t m_capacity = 0;
+        float m_timestampPeriod = 1.0f;
+        std::vector<uint32_t> m_timestampValidBits;
+    };
+}
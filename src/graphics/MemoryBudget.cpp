@@ -0,0 +1,133 @@
+#include "MemoryBudget.h"
+#include "Allocator.h"
+#include "../Logger.h"
+
+namespace vanguard {
+    static const char* toString(MemoryCategory category) {
+        switch(category) {
+            case MemoryCategory::Image: return "image";
+            case MemoryCategory::Buffer: return "buffer";
+            case MemoryCategory::Memory: return "memory";
+        }
+        return "unknown";
+    }
+
+    void MemoryBudget::add(MemoryCategory category, const std::string& name, vk::DeviceSize bytes) {
+        m_categoryBytes[static_cast<size_t>(category)] += bytes;
+        m_namedBytes[name] += bytes;
+    }
+
+    void MemoryBudget::remove(MemoryCategory category, const std::string& name, vk::DeviceSize bytes) {
+        m_categoryBytes[static_cast<size_t>(category)] -= bytes;
+        auto it = m_namedBytes.find(name);
+        if(it == m_namedBytes.end())
+            return;
+        it->second -= bytes;
+        if(it->second == 0)
+            m_namedBytes.erase(it);
+    }
+
+    uint32_t MemoryBudget::addCallback(float threshold, MemoryBudgetCallback callback) {
+        uint32_t id = m_nextCallbackId++;
+        m_thresholds.push_back(Threshold{
+                .id = id,
+                .threshold = threshold,
+                .callback = std::move(callback),
+        });
+        return id;
+    }
+
+    void MemoryBudget::removeCallback(uint32_t id) {
+        std::erase_if(m_thresholds, [&](const Threshold& threshold) { return threshold.id == id; });
+    }
+
+    void MemoryBudget::update() {
+        if(m_thresholds.empty())
+            return;
+
+        auto heaps = queryHeaps();
+        // Collected first, callbacks may add or remove callbacks
+        std::vector<std::pair<MemoryBudgetCallback, MemoryBudgetEvent>> events;
+        for (auto& threshold: m_thresholds) {
+            threshold.crossed.resize(heaps.size(), false);
+            for (uint32_t heap = 0; heap < heaps.size(); heap++) {
+                if(!heaps[heap].deviceLocal || heaps[heap].budget == 0)
+                    continue;
+                float usage = static_cast<float>(heaps[heap].usage) / static_cast<float>(heaps[heap].budget);
+                bool crossed = usage >= threshold.threshold;
+                if(crossed && !threshold.crossed[heap]) {
+                    events.emplace_back(threshold.callback, MemoryBudgetEvent{
+                            .heap = heap,
+                            .usage = usage,
+                            .threshold = threshold.threshold,
+                            .usageBytes = heaps[heap].usage,
+                            .budgetBytes = heaps[heap].budget,
+                    });
+                }
+                threshold.crossed[heap] = crossed;
+            }
+        }
+        for (const auto& [callback, event]: events) {
+            WARN("Device local heap {} is at {:.0f}% of its budget", event.heap, event.usage * 100.0f);
+            callback(event);
+        }
+    }
+
+    std::vector<MemoryHeapBudget> MemoryBudget::queryHeaps() const {
+        const VkPhysicalDeviceMemoryProperties* properties;
+        vmaGetMemoryProperties(*Vulkan::getAllocator(), &properties);
+        std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+        vmaGetHeapBudgets(*Vulkan::getAllocator(), budgets.data());
+
+        std::vector<MemoryHeapBudget> heaps(properties->memoryHeapCount);
+        for (uint32_t heap = 0; heap < heaps.size(); heap++) {
+            heaps[heap] = MemoryHeapBudget{
+                    .usage = budgets[heap].usage,
+                    .budget = budgets[heap].budget,
+                    .allocated = budgets[heap].statistics.allocationBytes,
+                    .deviceLocal = (properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+            };
+        }
+        return heaps;
+    }
+
+    MemoryStats MemoryBudget::getStats() const {
+        return MemoryStats{
+                .categoryBytes = m_categoryBytes,
+                .namedBytes = m_namedBytes,
+                .heaps = queryHeaps(),
+        };
+    }
+
+    static std::string escapeJson(const std::string& string) {
+        std::string escaped;
+        for (char c: string) {
+            if(c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    std::string MemoryBudget::toJson() const {
+        MemoryStats stats = getStats();
+        std::string json = "{\"categories\":{";
+        for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+            json += fmt::format("{}\"{}\":{}", i == 0 ? "" : ",", toString(static_cast<MemoryCategory>(i)), stats.categoryBytes[i]);
+        }
+        json += "},\"names\":{";
+        bool first = true;
+        for (const auto& [name, bytes]: stats.namedBytes) {
+            json += fmt::format("{}\"{}\":{}", first ? "" : ",", escapeJson(name), bytes);
+            first = false;
+        }
+        json += "},\"heaps\":[";
+        for (size_t i = 0; i < stats.heaps.size(); i++) {
+            const auto& heap = stats.heaps[i];
+            json += fmt::format("{}{{\"usage\":{},\"budget\":{},\"allocated\":{},\"deviceLocal\":{}}}", i == 0 ? "" : ",",
+                                heap.usage, heap.budget, heap.allocated, heap.deviceLocal);
+        }
+        json += "]}";
+        return json;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Vulkan.h"
+
+#include <array>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace vanguard {
+    // The pools whose allocations are accounted for
+    enum class MemoryCategory {
+        Image,
+        Buffer,
+        Memory,
+    };
+    constexpr size_t MEMORY_CATEGORY_COUNT = 3;
+
+    struct MemoryHeapBudget {
+        // Bytes the whole process uses and may use on this heap, from VK_EXT_memory_budget when enabled and estimated
+        // from the heap size otherwise
+        vk::DeviceSize usage = 0;
+        vk::DeviceSize budget = 0;
+        // Bytes of our own allocations
+        vk::DeviceSize allocated = 0;
+        bool deviceLocal = false;
+    };
+
+    struct MemoryStats {
+        std::array<vk::DeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes{};
+        // Keyed by the debug name resources were created with, unnamed resources are under ""
+        std::unordered_map<std::string, vk::DeviceSize> namedBytes;
+        std::vector<MemoryHeapBudget> heaps;
+    };
+
+    // Handed to threshold callbacks, usage is the fraction of the heap's budget in use
+    struct MemoryBudgetEvent {
+        uint32_t heap = 0;
+        float usage = 0.0f;
+        float threshold = 0.0f;
+        vk::DeviceSize usageBytes = 0;
+        vk::DeviceSize budgetBytes = 0;
+    };
+    typedef std::function<void(const MemoryBudgetEvent&)> MemoryBudgetCallback;
+
+    // Accounts for the bytes the resource manager allocates and watches the device local heaps' budgets. Callbacks
+    // fire once when a heap's usage rises past their threshold and are re-armed when it drops below again, that's
+    // where streaming systems evict. Not thread safe.
+    class MemoryBudget {
+    public:
+        void add(MemoryCategory category, const std::string& name, vk::DeviceSize bytes);
+        void remove(MemoryCategory category, const std::string& name, vk::DeviceSize bytes);
+
+        // Threshold is a fraction of the heap's budget, returns an id for removeCallback
+        uint32_t addCallback(float threshold, MemoryBudgetCallback callback);
+        void removeCallback(uint32_t id);
+
+        // Queries the heap budgets and fires crossed thresholds, called once per frame
+        void update();
+
+        [[nodiscard]] MemoryStats getStats() const;
+        [[nodiscard]] std::string toJson() const;
+    private:
+        struct Threshold {
+            uint32_t id;
+            float threshold;
+            MemoryBudgetCallback callback;
+            // Per heap, whether usage is currently past the threshold
+            std::vector<bool> crossed;
+        };
+
+        [[nodiscard]] std::vector<MemoryHeapBudget> queryHeaps() const;
+    private:
+        std::array<vk::DeviceSize, MEMORY_CATEGORY_COUNT> m_categoryBytes{};
+        std::unordered_map<std::string, vk::DeviceSize> m_namedBytes;
+        std::vector<Threshold> m_thresholds;
+        uint32_t m_nextCallbackId = 0;
+    };
+}
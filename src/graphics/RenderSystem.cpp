@@ -1,27 +1,62 @@
 #include "RenderSystem.h"
 #include "Vulkan.h"
 #include "../Logger.h"
+#include "../util/AllocationCounter.h"
 #include "../util/Timer.h"
 #include "../util/TypeTraits.h"
 
 namespace vanguard {
+    // Render pipelines keep viewport and scissor dynamic, they always cover the whole framebuffer
+    static void setViewportAndScissor(vk::CommandBuffer commandBuffer, vk::Extent2D extent) {
+        commandBuffer.setViewport(0, vk::Viewport{
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = static_cast<float>(extent.width),
+                .height = static_cast<float>(extent.height),
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f
+        });
+        commandBuffer.setScissor(0, vk::Rect2D{ .offset = vk::Offset2D{0, 0}, .extent = extent });
+    }
+
     void RenderSystem::init() {
         auto& device = Vulkan::getDevice();
 
+        // The main thread only stitches the recorded buffers together, so leave it one core
+        uint32_t recordingThreads = std::min(std::thread::hardware_concurrency(), 8u);
+        recordingThreads = recordingThreads > 1 ? recordingThreads - 1 : 0;
+        if(recordingThreads > 0)
+            m_recordingThreads = std::make_unique<ThreadPool>(recordingThreads);
+        INFO("Recording commands on {} worker threads", recordingThreads);
+
+        m_gpuProfiler.init();
+        m_stager.init();
+        m_asyncUploader.init();
+        m_transientBuffers.init();
+
         m_frameData.reserve(FRAMES_IN_FLIGHT);
         for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
             vk::raii::CommandPool commandPool = device.createCommandPool({ .queueFamilyIndex = Vulkan::getQueueFamilyIndex() });
+            vk::raii::CommandPool computeCommandPool = device.createCommandPool({ .queueFamilyIndex = Vulkan::getComputeQueueFamilyIndex() });
             auto commandBuffers = device.allocateCommandBuffers({ .commandPool = *commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 2 });
 
             m_frameData.push_back(FrameData{
                 .imageAvailableSemaphore = device.createSemaphore({}),
                 .commandsFinishedSemaphore = device.createSemaphore({}),
                 .blitFinishedSemaphore = device.createSemaphore({}),
+                .uploadsFinishedSemaphore = device.createSemaphore({}),
                 .inFlightFence = device.createFence({ .flags = vk::FenceCreateFlagBits::eSignaled }),
                 .commandPool = std::move(commandPool),
                 .generalCommandBuffer = std::move(commandBuffers.at(0)),
-                .blitCommandBuffer = std::move(commandBuffers.at(1))
+                .blitCommandBuffer = std::move(commandBuffers.at(1)),
+                .computeCommandPool = std::move(computeCommandPool),
             });
+            for (uint32_t j = 0; j < recordingThreads; j++) {
+                m_frameData.back().recordingWorkers.push_back(RecordingWorker{
+                    .graphicsCommandPool = device.createCommandPool({ .queueFamilyIndex = Vulkan::getQueueFamilyIndex() }),
+                    .computeCommandPool = device.createCommandPool({ .queueFamilyIndex = Vulkan::getComputeQueueFamilyIndex() }),
+                });
+            }
         }
     }
 
@@ -32,32 +67,299 @@ namespace vanguard {
         }
 #endif
         m_commands = commandsInfo;
+        m_gpuProfiler.setPasses(commandsInfo.profiledPasses);
+    }
+
+    void RenderSystem::recordPipelineBarrier(FrameData& frame, vk::CommandBuffer commandBuffer, const PipelineBarrierCommand& barrier) {
+        auto& imageMemoryBarriers = frame.imageBarriers;
+        auto& bufferMemoryBarriers = frame.bufferBarriers;
+        imageMemoryBarriers.clear();
+        bufferMemoryBarriers.clear();
+
+        for(const ImageBarrierInfo& imageBarrier: barrier.imageMemoryBarriers) {
+            auto& image = m_resourceManager.getImage(imageBarrier.image);
+            imageMemoryBarriers.push_back(vk::ImageMemoryBarrier{
+                .srcAccessMask = imageBarrier.srcAccessMask,
+                .dstAccessMask = imageBarrier.dstAccessMask,
+                .oldLayout = imageBarrier.oldLayout,
+                .newLayout = imageBarrier.newLayout,
+                .srcQueueFamilyIndex = imageBarrier.srcQueueFamilyIndex,
+                .dstQueueFamilyIndex = imageBarrier.dstQueueFamilyIndex,
+                .image = *image.image,
+                .subresourceRange = vk::ImageSubresourceRange{
+                    .aspectMask = image.info.aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = image.info.arrayLayers
+                }
+            });
+        }
+        for(const BufferBarrierInfo& bufferBarrier: barrier.bufferMemoryBarriers) {
+            auto& buffer = m_resourceManager.getBuffer(bufferBarrier.buffer);
+            bufferMemoryBarriers.push_back(vk::BufferMemoryBarrier{
+                .srcAccessMask = bufferBarrier.srcAccessMask,
+                .dstAccessMask = bufferBarrier.dstAccessMask,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = *buffer.buffer,
+                .offset = bufferBarrier.offset,
+                .size = bufferBarrier.size
+            });
+        }
+        commandBuffer.pipelineBarrier(barrier.srcStage, barrier.dstStage, {}, {}, bufferMemoryBarriers, imageMemoryBarriers);
+    }
+
+    void RenderSystem::recordCommands(FrameData& frame, vk::CommandBuffer commandBuffer, const std::vector<Command>& commands, CommandQueue queue) {
+        // Only worth handing out to other threads if there is more than one piece to record
+        uint32_t recordingJobs = 0;
+        for (const auto& command : commands) {
+            if(const auto* renderCommand = std::get_if<RenderPipelineCommand>(&command))
+                recordingJobs += 1 + renderCommand->batchCount;
+            else if(std::holds_alternative<ComputePipelineCommand>(command))
+                recordingJobs++;
+        }
+        if(m_recordingThreads != nullptr && recordingJobs > 1) {
+            recordCommandsParallel(frame, commandBuffer, commands, queue);
+            return;
+        }
+
+        uint32_t queueFamilyIndex = queue == CommandQueue::Graphics ? Vulkan::getQueueFamilyIndex() : Vulkan::getComputeQueueFamilyIndex();
+        for (const auto& command : commands) {
+            std::visit([&](const auto& cmd) {
+                using T = std::decay_t<decltype(cmd)>;
+                if constexpr(std::is_same_v<T, GeneralCommand>) {
+                    cmd.execution(commandBuffer);
+                } else if constexpr(std::is_same_v<T, RenderPipelineCommand>) {
+                    auto& pipeline = m_resourceManager.getRenderPipeline(cmd.pipeline);
+                    // A pass whose pipeline is still compiling only clears and transitions its attachments
+                    bool ready = pipeline.pipeline->isReady();
+
+                    m_gpuProfiler.beginPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, false);
+                    commandBuffer.beginRenderPass(vk::RenderPassBeginInfo{
+                            .renderPass = **pipeline.renderPass,
+                            .framebuffer = **pipeline.framebuffer,
+                            .renderArea = vk::Rect2D{
+                                    .offset = vk::Offset2D{0, 0},
+                                    .extent = pipeline.info.extent
+                            },
+                            .clearValueCount = static_cast<uint32_t>(cmd.clearValues.size()),
+                            .pClearValues = cmd.clearValues.data()
+                    }, vk::SubpassContents::eInline);
+                    if(ready) {
+                        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline.pipeline);
+                        setViewportAndScissor(commandBuffer, pipeline.info.extent);
+
+                        cmd.execution(commandBuffer);
+                        for (uint32_t batch = 0; batch < cmd.batchCount; batch++) {
+                            cmd.batchExecution(commandBuffer, batch);
+                        }
+                    }
+
+                    commandBuffer.endRenderPass();
+                    m_gpuProfiler.endPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, false);
+                } else if constexpr(std::is_same_v<T, ComputePipelineCommand>) {
+                    auto& pipeline = m_resourceManager.getComputePipeline(cmd.pipeline);
+
+                    m_gpuProfiler.beginPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, false);
+                    if(pipeline.pipeline->isReady()) {
+                        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, **pipeline.pipeline);
+                        cmd.execution(commandBuffer);
+                    }
+                    m_gpuProfiler.endPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, false);
+                } else if constexpr(std::is_same_v<T, PipelineBarrierCommand>) {
+                    recordPipelineBarrier(frame, commandBuffer, cmd);
+                } else {
+                    static_assert(always_false<T>, "Non-exhaustive visitor");
+                }
+            }, command);
+        }
+    }
+
+    void RenderSystem::recordCommandsParallel(FrameData& frame, vk::CommandBuffer commandBuffer, const std::vector<Command>& commands, CommandQueue queue) {
+        TIMER("RenderSystem::recordCommandsParallel");
+        bool graphics = queue == CommandQueue::Graphics;
+        uint32_t queueFamilyIndex = graphics ? Vulkan::getQueueFamilyIndex() : Vulkan::getComputeQueueFamilyIndex();
+        vk::QueryPipelineStatisticFlags inheritedStatistics = m_gpuProfiler.getInheritedStatistics(queueFamilyIndex);
+
+        // Every pipeline command, and every batch of one, is recorded into its own secondary command buffer by
+        // whichever worker picks it up. The primary buffer then executes them in graph order.
+        auto& secondaries = frame.secondaries;
+        if(secondaries.size() < commands.size())
+            secondaries.resize(commands.size());
+        auto& tasks = frame.recordingTasks;
+        tasks.clear();
+        for (uint32_t i = 0; i < commands.size(); ++i) {
+            const auto& command = commands[i];
+            uint32_t pieces = 0;
+            bool ready = false;
+            if(const auto* renderCommand = std::get_if<RenderPipelineCommand>(&command)) {
+                pieces = 1 + renderCommand->batchCount;
+                ready = m_resourceManager.getRenderPipeline(renderCommand->pipeline).pipeline->isReady();
+            } else if(const auto* computeCommand = std::get_if<ComputePipelineCommand>(&command)) {
+                pieces = 1;
+                ready = m_resourceManager.getComputePipeline(computeCommand->pipeline).pipeline->isReady();
+            }
+            secondaries[i].resize(pieces);
+
+            for (uint32_t piece = 0; piece < pieces; ++piece) {
+                tasks.push_back(RecordingTask{
+                        .frame = &frame,
+                        .command = &command,
+                        .commandIndex = i,
+                        .piece = piece,
+                        .graphics = graphics,
+                        .ready = ready,
+                        .inheritedStatistics = inheritedStatistics
+                });
+            }
+        }
+        // Submitted once the task list is complete, growing it would move the tasks the workers point at
+        for (const RecordingTask& task: tasks) {
+            m_recordingThreads->submit([this, task = &task](uint32_t worker) { recordSecondary(*task, worker); });
+        }
+        m_recordingThreads->wait();
+
+        for (uint32_t i = 0; i < commands.size(); ++i) {
+            std::visit([&](const auto& cmd) {
+                using T = std::decay_t<decltype(cmd)>;
+                if constexpr(std::is_same_v<T, GeneralCommand>) {
+                    cmd.execution(commandBuffer);
+                } else if constexpr(std::is_same_v<T, RenderPipelineCommand>) {
+                    auto& pipeline = m_resourceManager.getRenderPipeline(cmd.pipeline);
+                    m_gpuProfiler.beginPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, true);
+                    commandBuffer.beginRenderPass(vk::RenderPassBeginInfo{
+                            .renderPass = **pipeline.renderPass,
+                            .framebuffer = **pipeline.framebuffer,
+                            .renderArea = vk::Rect2D{
+                                    .offset = vk::Offset2D{0, 0},
+                                    .extent = pipeline.info.extent
+                            },
+                            .clearValueCount = static_cast<uint32_t>(cmd.clearValues.size()),
+                            .pClearValues = cmd.clearValues.data()
+                    }, vk::SubpassContents::eSecondaryCommandBuffers);
+                    commandBuffer.executeCommands(secondaries[i]);
+                    commandBuffer.endRenderPass();
+                    m_gpuProfiler.endPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, true);
+                } else if constexpr(std::is_same_v<T, ComputePipelineCommand>) {
+                    m_gpuProfiler.beginPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, true);
+                    commandBuffer.executeCommands(secondaries[i]);
+                    m_gpuProfiler.endPass(commandBuffer, m_currentFrame, cmd.profileIndex, queueFamilyIndex, true);
+                } else if constexpr(std::is_same_v<T, PipelineBarrierCommand>) {
+                    recordPipelineBarrier(frame, commandBuffer, cmd);
+                } else {
+                    static_assert(always_false<T>, "Non-exhaustive visitor");
+                }
+            }, commands[i]);
+        }
+    }
+
+    void RenderSystem::recordSecondary(const RecordingTask& task, uint32_t worker) {
+        auto& recorder = task.frame->recordingWorkers[worker];
+        auto& pool = task.graphics ? recorder.graphicsCommandPool : recorder.computeCommandPool;
+        auto& buffers = task.graphics ? recorder.graphicsCommandBuffers : recorder.computeCommandBuffers;
+        auto& used = task.graphics ? recorder.graphicsCommandBuffersUsed : recorder.computeCommandBuffersUsed;
+        if(used == buffers.size()) {
+            auto allocated = Vulkan::getDevice().allocateCommandBuffers({ .commandPool = *pool, .level = vk::CommandBufferLevel::eSecondary, .commandBufferCount = 1 });
+            buffers.push_back(std::move(allocated.at(0)));
+        }
+        vk::CommandBuffer secondary = *buffers[used++];
+
+        std::visit([&](const auto& cmd) {
+            using T = std::decay_t<decltype(cmd)>;
+            if constexpr(std::is_same_v<T, RenderPipelineCommand>) {
+                auto& pipeline = m_resourceManager.getRenderPipeline(cmd.pipeline);
+                vk::CommandBufferInheritanceInfo inheritance{
+                        .renderPass = **pipeline.renderPass,
+                        .subpass = 0,
+                        .framebuffer = **pipeline.framebuffer,
+                        .pipelineStatistics = cmd.profileIndex != UINT32_MAX ? task.inheritedStatistics : vk::QueryPipelineStatisticFlags{},
+                };
+                secondary.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                                  .pInheritanceInfo = &inheritance });
+                if(task.ready) {
+                    // Secondary command buffers don't inherit bound state, every batch binds the pipeline again
+                    secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline.pipeline);
+                    setViewportAndScissor(secondary, pipeline.info.extent);
+                    if(task.piece == 0)
+                        cmd.execution(secondary);
+                    else
+                        cmd.batchExecution(secondary, task.piece - 1);
+                }
+            } else if constexpr(std::is_same_v<T, ComputePipelineCommand>) {
+                auto& pipeline = m_resourceManager.getComputePipeline(cmd.pipeline);
+                vk::CommandBufferInheritanceInfo inheritance{
+                        .pipelineStatistics = cmd.profileIndex != UINT32_MAX ? task.inheritedStatistics : vk::QueryPipelineStatisticFlags{},
+                };
+                secondary.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit, .pInheritanceInfo = &inheritance });
+                if(task.ready) {
+                    secondary.bindPipeline(vk::PipelineBindPoint::eCompute, **pipeline.pipeline);
+                    cmd.execution(secondary);
+                }
+            }
+        }, *task.command);
+        secondary.end();
+        task.frame->secondaries[task.commandIndex][task.piece] = secondary;
+    }
+
+    void RenderSystem::recreateSwapchain(Window& window) {
+        Timer timer;
+        // Frames in flight may still present from the old swapchain
+        m_resourceManager.retire(Vulkan::recreateSwapchain(window.getWidth(), window.getHeight()));
+        m_swapchainRecreated = true;
+        INFO("Recreated swapchain at {}x{} in {:.2f}ms", window.getWidth(), window.getHeight(), timer.elapsedMillis());
+    }
+
+    void RenderSystem::updateDescriptorSetForFrame(uint32_t frameIndex, ResourceRef descriptorSet, std::vector<DescriptorSetWrite> writes) {
+        m_frameData[frameIndex].pendingDescriptorWrites.emplace_back(descriptorSet, std::move(writes));
+    }
+
+    void RenderSystem::waitForFrame() {
+        TIMER("RenderSystem::fenceWaiting");
+        auto result = Vulkan::getDevice().waitForFences({*m_frameData[m_currentFrame].inFlightFence}, VK_TRUE, UINT64_MAX);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to wait for fence");
+        }
+        // Once per frame, allocations made while updating and while recording share the slice
+        if(m_transientFrame != m_frameCount) {
+            m_transientBuffers.beginFrame(m_currentFrame);
+            m_transientFrame = m_frameCount;
+        }
     }
 
     void RenderSystem::render(Window& window) {
         auto& device = Vulkan::getDevice();
         auto& frameData = m_frameData[m_currentFrame];
 
-        {
-            TIMER("RenderSystem::fenceWaiting");
-            auto result = device.waitForFences({*frameData.inFlightFence}, VK_TRUE, UINT64_MAX);
-            if (result != vk::Result::eSuccess) {
-                throw std::runtime_error("Failed to wait for fence");
-            }
-            device.resetFences({*frameData.inFlightFence});
-        }
+        // Usually already waited on before the frame was updated, then this returns right away
+        waitForFrame();
 
         uint32_t imageIndex;
         {
             TIMER("RenderSystem::acquireImage");
-            auto [imageResult, i] = Vulkan::getSwapchain().acquireNextImage(UINT64_MAX, *frameData.imageAvailableSemaphore);
-            if (imageResult == vk::Result::eSuboptimalKHR | imageResult == vk::Result::eErrorOutOfDateKHR) {
-                Vulkan::recreateSwapchain(window.getWidth(), window.getHeight());
-                //rebake();
+            vk::Result imageResult;
+            try {
+                std::tie(imageResult, imageIndex) = Vulkan::getSwapchain().acquireNextImage(UINT64_MAX, *frameData.imageAvailableSemaphore);
+            } catch (const vk::OutOfDateKHRError&) {
+                imageResult = vk::Result::eErrorOutOfDateKHR;
+            }
+            // Nothing was acquired, the fence stays signaled so the frame can simply be tried again. Suboptimal images
+            // are still presented and the swapchain is recreated after.
+            if (imageResult == vk::Result::eErrorOutOfDateKHR) {
+                recreateSwapchain(window);
                 return;
             }
-            imageIndex = i;
         }
+        device.resetFences({*frameData.inFlightFence});
+        m_resourceManager.nextFrame();
+        m_asyncUploader.beginFrame();
+        m_gpuProfiler.resolve(m_currentFrame);
+        for (const auto& [descriptorSet, writes]: frameData.pendingDescriptorWrites) {
+            // The set may have been destroyed since, e.g. by a rebake
+            if(m_resourceManager.isDescriptorSetValid(descriptorSet))
+                m_resourceManager.updateDescriptorSet(descriptorSet, writes);
+        }
+        frameData.pendingDescriptorWrites.clear();
 
         // Execute Commands
         auto& frame = m_frameData[m_currentFrame];
@@ -66,87 +368,139 @@ namespace vanguard {
         // General Commands
         {
             TIMER("RenderSystem::generalCommands");
-            auto& commandBuffer = *frame.generalCommandBuffer;
-            commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+            const auto& submissions = m_commands.submissions;
+            bool asyncCompute = std::any_of(submissions.begin(), submissions.end(), [](const CommandSubmission& submission) {
+                return submission.queue == CommandQueue::Compute;
+            });
+
+            frame.computeCommandPool.reset();
+            for (auto& recorder: frame.recordingWorkers) {
+                recorder.graphicsCommandPool.reset();
+                recorder.computeCommandPool.reset();
+                recorder.graphicsCommandBuffersUsed = 0;
+                recorder.computeCommandBuffersUsed = 0;
+            }
+            uint32_t graphicsSubmissions = 0;
+            uint32_t computeSubmissions = 0;
+            for (const auto& submission: submissions) {
+                (submission.queue == CommandQueue::Graphics ? graphicsSubmissions : computeSubmissions)++;
+            }
+            if(frame.graphicsCommandBuffers.size() < graphicsSubmissions) {
+                auto commandBuffers = device.allocateCommandBuffers({ .commandPool = *frame.commandPool, .level = vk::CommandBufferLevel::ePrimary,
+                                                                      .commandBufferCount = static_cast<uint32_t>(graphicsSubmissions - frame.graphicsCommandBuffers.size()) });
+                std::move(commandBuffers.begin(), commandBuffers.end(), std::back_inserter(frame.graphicsCommandBuffers));
+            }
+            if(frame.computeCommandBuffers.size() < computeSubmissions) {
+                auto commandBuffers = device.allocateCommandBuffers({ .commandPool = *frame.computeCommandPool, .level = vk::CommandBufferLevel::ePrimary,
+                                                                      .commandBufferCount = static_cast<uint32_t>(computeSubmissions - frame.computeCommandBuffers.size()) });
+                std::move(commandBuffers.begin(), commandBuffers.end(), std::back_inserter(frame.computeCommandBuffers));
+            }
+            while(frame.submissionSemaphores.size() < submissions.size()) {
+                frame.submissionSemaphores.push_back(device.createSemaphore({}));
+            }
 
-            // Stager
-            m_stager.bakeCommands(commandBuffer);
+            // Uploads go first, with async compute they get their own submission so compute can start right after them
+            auto& generalCommandBuffer = *frame.generalCommandBuffer;
+            generalCommandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+            m_gpuProfiler.reset(generalCommandBuffer, m_currentFrame);
+            m_stager.bakeCommands(generalCommandBuffer);
             m_stager.flush();
+            // Async uploads the frame sees as complete are made visible by waiting on the value observed for them,
+            // later submissions on the queue and the compute submissions waiting on the uploads are ordered after it
+            vk::Semaphore asyncUploadSemaphore = m_asyncUploader.getSemaphore();
+            uint64_t asyncUploadValue = m_asyncUploader.getCompletedValue();
+            vk::PipelineStageFlags asyncUploadStage = vk::PipelineStageFlagBits::eAllCommands;
+            if(asyncCompute) {
+                generalCommandBuffer.end();
+                vk::TimelineSemaphoreSubmitInfo timelineInfo{
+                        .waitSemaphoreValueCount = 1,
+                        .pWaitSemaphoreValues = &asyncUploadValue
+                };
+                Vulkan::getQueue().submit(vk::SubmitInfo{
+                        .pNext = &timelineInfo,
+                        .waitSemaphoreCount = 1,
+                        .pWaitSemaphores = &asyncUploadSemaphore,
+                        .pWaitDstStageMask = &asyncUploadStage,
+                        .commandBufferCount = 1,
+                        .pCommandBuffers = &generalCommandBuffer,
+                        .signalSemaphoreCount = 1,
+                        .pSignalSemaphores = &*frame.uploadsFinishedSemaphore
+                });
+            }
 
-            for (auto& command : m_commands.commands) {
-                std::visit([&](auto& cmd) {
-                    using T = std::decay_t<decltype(cmd)>;
-                    if constexpr(std::is_same_v<T, GeneralCommand>) {
-                        cmd.execution(commandBuffer);
-                    } else if constexpr(std::is_same_v<T, RenderPipelineCommand>) {
-                        auto& pipeline = m_resourceManager.getRenderPipeline(cmd.pipeline);
-
-                        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline.pipeline);
-                        commandBuffer.beginRenderPass(vk::RenderPassBeginInfo{
-                                .renderPass = *pipeline.renderPass,
-                                .framebuffer = *pipeline.framebuffer,
-                                .renderArea = vk::Rect2D{
-                                        .offset = vk::Offset2D{0, 0},
-                                        .extent = pipeline.info.extent
-                                },
-                                .clearValueCount = static_cast<uint32_t>(cmd.clearValues.size()),
-                                .pClearValues = cmd.clearValues.data()
-                        }, vk::SubpassContents::eInline);
+            auto& waitedOn = frame.submissionWaitedOn;
+            waitedOn.assign(submissions.size(), false);
+            for (const auto& submission: submissions) {
+                for (uint32_t wait: submission.waits) {
+                    waitedOn[wait] = true;
+                }
+            }
 
-                        cmd.execution(commandBuffer);
+            ScopedAllocationCounter recordingAllocations;
+            bool uploadsWaited = false;
+            uint32_t graphicsIndex = 0;
+            uint32_t computeIndex = 0;
+            for (uint32_t i = 0; i < submissions.size(); ++i) {
+                const auto& submission = submissions[i];
+                bool graphics = submission.queue == CommandQueue::Graphics;
 
-                        commandBuffer.endRenderPass();
-                    } else if constexpr(std::is_same_v<T, ComputePipelineCommand>) {
-                        auto& pipeline = m_resourceManager.getComputePipeline(cmd.pipeline);
+                vk::CommandBuffer commandBuffer;
+                bool waitsOnAsyncUploads = false;
+                if(graphics && !asyncCompute && graphicsIndex == 0) {
+                    commandBuffer = generalCommandBuffer;
+                    waitsOnAsyncUploads = true;
+                    graphicsIndex++;
+                } else {
+                    commandBuffer = graphics ? *frame.graphicsCommandBuffers[graphicsIndex++] : *frame.computeCommandBuffers[computeIndex++];
+                    commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+                }
+                recordCommands(frame, commandBuffer, submission.commands, submission.queue);
+                commandBuffer.end();
 
-                        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline.pipeline);
-                        cmd.execution(commandBuffer);
-                    } else if constexpr(std::is_same_v<T, PipelineBarrierCommand>) {
-                        std::vector<vk::ImageMemoryBarrier> imageMemoryBarriers;
-                        std::vector<vk::BufferMemoryBarrier> bufferMemoryBarriers;
-
-                        for(const ImageBarrierInfo& barrier: cmd.imageMemoryBarriers) {
-                            auto& image = m_resourceManager.getImage(barrier.image);
-                            imageMemoryBarriers.push_back(vk::ImageMemoryBarrier{
-                                .srcAccessMask = barrier.srcAccessMask,
-                                .dstAccessMask = barrier.dstAccessMask,
-                                .oldLayout = barrier.oldLayout,
-                                .newLayout = barrier.newLayout,
-                                .image = *image.image,
-                                .subresourceRange = vk::ImageSubresourceRange{
-                                    .aspectMask = image.info.aspect,
-                                    .baseMipLevel = 0,
-                                    .levelCount = 1,
-                                    .baseArrayLayer = 0,
-                                    .layerCount = 1
-                                }
-                            });
-                        }
-                        for(const BufferBarrierInfo& barrier: cmd.bufferMemoryBarriers) {
-                            auto& buffer = m_resourceManager.getBuffer(barrier.buffer);
-                            bufferMemoryBarriers.push_back(vk::BufferMemoryBarrier{
-                                .srcAccessMask = barrier.srcAccessMask,
-                                .dstAccessMask = barrier.dstAccessMask,
-                                .buffer = *buffer.buffer,
-                                .offset = barrier.offset,
-                                .size = barrier.size
-                            });
-                        }
-                        commandBuffer.pipelineBarrier(cmd.srcStage, cmd.dstStage, {}, {}, bufferMemoryBarriers, imageMemoryBarriers);
-                    } else {
-                        static_assert(always_false<T>, "Non-exhaustive visitor");
-                    }
-                }, command);
-            }
-            commandBuffer.end();
+                // Semaphore waits only cover the stages named here in this and later batches, so wait on everything
+                auto& waitSemaphores = frame.waitSemaphores;
+                waitSemaphores.clear();
+                for (uint32_t wait: submission.waits) {
+                    waitSemaphores.push_back(*frame.submissionSemaphores[wait]);
+                }
+                if(!graphics && !uploadsWaited) {
+                    waitSemaphores.push_back(*frame.uploadsFinishedSemaphore);
+                    uploadsWaited = true;
+                }
+                if(waitsOnAsyncUploads)
+                    waitSemaphores.push_back(asyncUploadSemaphore);
+                auto& waitStages = frame.waitStages;
+                waitStages.assign(waitSemaphores.size(), vk::PipelineStageFlagBits::eAllCommands);
+                // Values of the binary semaphores are ignored
+                auto& waitValues = frame.waitValues;
+                waitValues.assign(waitSemaphores.size(), 0);
+                if(waitsOnAsyncUploads)
+                    waitValues.back() = asyncUploadValue;
+                vk::TimelineSemaphoreSubmitInfo timelineInfo{
+                        .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+                        .pWaitSemaphoreValues = waitValues.data()
+                };
 
-            vk::SubmitInfo submitInfo{
-                    .commandBufferCount = 1,
-                    .pCommandBuffers = &commandBuffer,
-                    .signalSemaphoreCount = 1,
-                    .pSignalSemaphores = &*frameData.commandsFinishedSemaphore
-            };
-            Vulkan::getQueue().submit(submitInfo);
+                auto& signalSemaphores = frame.signalSemaphores;
+                signalSemaphores.clear();
+                if(waitedOn[i])
+                    signalSemaphores.push_back(*frame.submissionSemaphores[i]);
+                if(i == submissions.size() - 1)
+                    signalSemaphores.push_back(*frame.commandsFinishedSemaphore);
+
+                vk::SubmitInfo submitInfo{
+                        .pNext = waitsOnAsyncUploads ? &timelineInfo : nullptr,
+                        .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
+                        .pWaitSemaphores = waitSemaphores.data(),
+                        .pWaitDstStageMask = waitStages.data(),
+                        .commandBufferCount = 1,
+                        .pCommandBuffers = &commandBuffer,
+                        .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+                        .pSignalSemaphores = signalSemaphores.data()
+                };
+                (graphics ? Vulkan::getQueue() : Vulkan::getComputeQueue()).submit(submitInfo);
+            }
+            m_recordingAllocations = recordingAllocations.getCount();
         }
 
         // Blit the backbuffer image to swapchain image and transition the swapchain image to present
@@ -205,7 +559,8 @@ namespace vanguard {
                     });
                 }
 
-                frame.blitCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllGraphics, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barriers);
+                // Both semaphores are waited on at the transfer stage which already orders this after the graph's commands
+                frame.blitCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barriers);
 
                 frame.blitCommandBuffer.blitImage(*backbufferImage.image,
                                                   vk::ImageLayout::eTransferSrcOptimal,
@@ -229,8 +584,8 @@ namespace vanguard {
                 frame.blitCommandBuffer.end();
             }
 
-            std::vector<vk::PipelineStageFlags> waitFlags = {vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer};
-            std::vector<vk::Semaphore> waitSemaphores = {*frameData.imageAvailableSemaphore, *frameData.commandsFinishedSemaphore};
+            std::array<vk::PipelineStageFlags, 2> waitFlags = {vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer};
+            std::array<vk::Semaphore, 2> waitSemaphores = {*frameData.imageAvailableSemaphore, *frameData.commandsFinishedSemaphore};
             Vulkan::getQueue().submit(vk::SubmitInfo{
                     .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
                     .pWaitSemaphores = waitSemaphores.data(),
@@ -245,17 +600,21 @@ namespace vanguard {
         // Present the swapchain image
         {
             TIMER("RenderSystem::submitPresentation");
-            auto result = Vulkan::getQueue().presentKHR(vk::PresentInfoKHR{
-                    .waitSemaphoreCount = 1,
-                    .pWaitSemaphores = &*frameData.blitFinishedSemaphore,
-                    .swapchainCount = 1,
-                    .pSwapchains = &*Vulkan::getSwapchain(),
-                    .pImageIndices = &imageIndex,
-            });
+            vk::Result result;
+            try {
+                result = Vulkan::getQueue().presentKHR(vk::PresentInfoKHR{
+                        .waitSemaphoreCount = 1,
+                        .pWaitSemaphores = &*frameData.blitFinishedSemaphore,
+                        .swapchainCount = 1,
+                        .pSwapchains = &*Vulkan::getSwapchain(),
+                        .pImageIndices = &imageIndex,
+                });
+            } catch (const vk::OutOfDateKHRError&) {
+                result = vk::Result::eErrorOutOfDateKHR;
+            }
+            // The frame was submitted either way, so it still counts
             if (result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR) {
-                Vulkan::recreateSwapchain(window.getWidth(), window.getHeight());
-                //rebake();
-                return;
+                recreateSwapchain(window);
             }
         }
 
@@ -5,32 +5,41 @@
 #include "../Window.h"
 #include "ResourceManager.h"
 #include "Stager.h"
+#include "AsyncUploader.h"
+#include "TransientBufferAllocator.h"
+#include "GpuProfiler.h"
+#include "../util/ThreadPool.h"
 #include <vulkan/vulkan_raii.hpp>
 
 #include <mutex>
 #include <variant>
 
 namespace vanguard {
-    struct FrameData {
-        vk::raii::Semaphore imageAvailableSemaphore;
-        vk::raii::Semaphore commandsFinishedSemaphore;
-        vk::raii::Semaphore blitFinishedSemaphore;
-        vk::raii::Fence inFlightFence;
-
-        vk::raii::CommandPool commandPool;
-        vk::raii::CommandBuffer generalCommandBuffer;
-        vk::raii::CommandBuffer blitCommandBuffer;
+    // Secondary command buffers recorded by one worker thread, every worker has its own pools so no locking is needed
+    struct RecordingWorker {
+        vk::raii::CommandPool graphicsCommandPool;
+        vk::raii::CommandPool computeCommandPool;
+        std::vector<vk::raii::CommandBuffer> graphicsCommandBuffers;
+        std::vector<vk::raii::CommandBuffer> computeCommandBuffers;
+        uint32_t graphicsCommandBuffersUsed = 0;
+        uint32_t computeCommandBuffersUsed = 0;
     };
 
     struct RenderPipelineCommand {
         ResourceRef pipeline = UNDEFINED_RESOURCE;
         std::vector<vk::ClearValue> clearValues;
         std::function<void(vk::CommandBuffer)> execution;
+        // Recorded after execution in batchCount independent pieces, possibly on different threads
+        uint32_t batchCount = 0;
+        std::function<void(vk::CommandBuffer, uint32_t)> batchExecution;
+        // Index into CommandsInfo::profiledPasses
+        uint32_t profileIndex = UINT32_MAX;
     };
 
     struct ComputePipelineCommand {
         ResourceRef pipeline = UNDEFINED_RESOURCE;
         std::function<void(vk::CommandBuffer)> execution;
+        uint32_t profileIndex = UINT32_MAX;
     };
 
     struct ImageBarrierInfo {
@@ -39,6 +48,9 @@ namespace vanguard {
         vk::ImageLayout newLayout;
         vk::AccessFlags srcAccessMask;
         vk::AccessFlags dstAccessMask;
+        // Set for queue ownership transfers, the same barrier is recorded on both queues
+        uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     };
     struct BufferBarrierInfo {
         ResourceRef buffer;
@@ -59,32 +71,124 @@ namespace vanguard {
     };
     typedef std::variant<RenderPipelineCommand, ComputePipelineCommand, PipelineBarrierCommand, GeneralCommand> Command;
 
-    struct CommandsInfo {
+    enum class CommandQueue {
+        Graphics,
+        Compute
+    };
+
+    struct CommandSubmission {
+        CommandQueue queue = CommandQueue::Graphics;
         std::vector<Command> commands;
+        // Earlier submissions on the other queue which have to finish first
+        std::vector<uint32_t> waits;
+    };
+
+    struct CommandsInfo {
+        // Submitted in order, the last one is always on the graphics queue and covers all the others
+        std::vector<CommandSubmission> submissions;
         ResourceRef backbufferImage = UNDEFINED_RESOURCE;
         vk::ImageLayout backbufferImageLayout = vk::ImageLayout::eUndefined;
         vk::AccessFlags backbufferImageAccessMask = vk::AccessFlagBits::eNone;
+        // Names of the passes GPU timings are collected for, empty when profiling is off
+        std::vector<std::string> profiledPasses;
+    };
+
+    struct FrameData;
+    // One piece of a pipeline command recorded into a secondary command buffer. Worker tasks only hold a pointer to
+    // it, which keeps them small enough for std::function to store without allocating.
+    struct RecordingTask {
+        FrameData* frame;
+        const Command* command;
+        uint32_t commandIndex;
+        uint32_t piece;
+        bool graphics;
+        // Decided once per command so every piece agrees on whether the pass is skipped
+        bool ready;
+        vk::QueryPipelineStatisticFlags inheritedStatistics;
     };
 
+    struct FrameData {
+        vk::raii::Semaphore imageAvailableSemaphore;
+        vk::raii::Semaphore commandsFinishedSemaphore;
+        vk::raii::Semaphore blitFinishedSemaphore;
+        vk::raii::Semaphore uploadsFinishedSemaphore;
+        vk::raii::Fence inFlightFence;
+
+        vk::raii::CommandPool commandPool;
+        vk::raii::CommandBuffer generalCommandBuffer;
+        vk::raii::CommandBuffer blitCommandBuffer;
+
+        // Grown on demand when the commands are split across queues, one per submission
+        vk::raii::CommandPool computeCommandPool;
+        std::vector<vk::raii::CommandBuffer> graphicsCommandBuffers;
+        std::vector<vk::raii::CommandBuffer> computeCommandBuffers;
+        std::vector<vk::raii::Semaphore> submissionSemaphores;
+
+        std::vector<RecordingWorker> recordingWorkers;
+
+        // Applied once the frame's fence has been waited on, the sets are no longer in use by then
+        std::vector<std::pair<ResourceRef, std::vector<DescriptorSetWrite>>> pendingDescriptorWrites;
+
+        // Scratch storage for recording and submitting, cleared but never shrunk so steady state frames don't allocate
+        std::vector<vk::ImageMemoryBarrier> imageBarriers;
+        std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+        std::vector<RecordingTask> recordingTasks;
+        // Per command, the secondary command buffers of its pieces. Only the first commands.size() entries are used.
+        std::vector<std::vector<vk::CommandBuffer>> secondaries;
+        std::vector<bool> submissionWaitedOn;
+        std::vector<vk::Semaphore> waitSemaphores;
+        std::vector<vk::PipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        std::vector<vk::Semaphore> signalSemaphores;
+    };
+
+
     class RenderSystem {
     public:
         void init();
         void bakeCommands(const CommandsInfo& commandsInfo);
 
+        // Waits until the GPU is done with the current frame's resources, call before writing the frame's host
+        // visible memory directly
+        void waitForFrame();
         void render(Window& window);
+        // Rewrites a descriptor set only used by the given frame index once that frame is done on the GPU
+        void updateDescriptorSetForFrame(uint32_t frameIndex, ResourceRef descriptorSet, std::vector<DescriptorSetWrite> writes);
+        // True once after the swapchain was recreated, swapchain sized resources have to be resized then
+        [[nodiscard]] inline bool consumeSwapchainRecreated() { return std::exchange(m_swapchainRecreated, false); }
 
         [[nodiscard]] inline uint32_t getFrameCount() const { return m_frameCount; }
         [[nodiscard]] inline uint32_t getFrameIndex() const { return m_currentFrame; }
 
         [[nodiscard]] inline ResourceManager& getResourceManager() { return m_resourceManager; }
         [[nodiscard]] inline Stager& getStager() { return m_stager; }
+        [[nodiscard]] inline AsyncUploader& getAsyncUploader() { return m_asyncUploader; }
+        [[nodiscard]] inline TransientBufferAllocator& getTransientBuffers() { return m_transientBuffers; }
+        [[nodiscard]] inline const GpuProfiler& getGpuProfiler() const { return m_gpuProfiler; }
+        // Heap allocations made while recording and submitting the last frame, needs VANGUARD_TRACK_ALLOCATIONS
+        [[nodiscard]] inline uint64_t getRecordingAllocations() const { return m_recordingAllocations; }
+    private:
+        void recordCommands(FrameData& frame, vk::CommandBuffer commandBuffer, const std::vector<Command>& commands, CommandQueue queue);
+        void recordCommandsParallel(FrameData& frame, vk::CommandBuffer commandBuffer, const std::vector<Command>& commands, CommandQueue queue);
+        void recordSecondary(const RecordingTask& task, uint32_t worker);
+        void recordPipelineBarrier(FrameData& frame, vk::CommandBuffer commandBuffer, const PipelineBarrierCommand& barrier);
+        void recreateSwapchain(Window& window);
     private:
         std::vector<FrameData> m_frameData{};
         uint32_t m_currentFrame = 0;
         uint32_t m_frameCount = 0;
+        bool m_swapchainRecreated = false;
 
         ResourceManager m_resourceManager;
         Stager m_stager;
+        AsyncUploader m_asyncUploader;
+        TransientBufferAllocator m_transientBuffers;
+        // Frame count the transient buffer slice was last reset for
+        uint32_t m_transientFrame = UINT32_MAX;
+        GpuProfiler m_gpuProfiler;
+        uint64_t m_recordingAllocations = 0;
         CommandsInfo m_commands;
+
+        std::unique_ptr<ThreadPool> m_recordingThreads;
     };
 }
\ No newline at end of file
@@ -3,12 +3,14 @@
 #include "../Config.h"
 #include "../Application.h"
 
-namespace vanguard {
+#include <future>
 
-    ResourceRef ImagePool::create(const ImageInfo& info) {
-        auto& device = Vulkan::getDevice();
+namespace vanguard {
 
-        vk::raii::Image image = device.createImage(vk::ImageCreateInfo{
+    static vk::ImageCreateInfo toImageCreateInfo(const ImageInfo& info) {
+        const auto& queueFamilies = info.asyncUpload ? Vulkan::getUploadQueueFamilyIndices() : Vulkan::getQueueFamilyIndices();
+        bool concurrent = info.concurrent && queueFamilies.size() > 1;
+        return vk::ImageCreateInfo{
                 .flags = info.type == ImageType::Cube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags{},
                 .imageType = vk::ImageType::e2D,
                 .format = info.format,
@@ -18,17 +20,65 @@ namespace vanguard {
                 .samples = vk::SampleCountFlagBits::e1,
                 .tiling = vk::ImageTiling::eOptimal,
                 .usage = info.usage,
-                .sharingMode = vk::SharingMode::eExclusive,
+                .sharingMode = concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+                .queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(queueFamilies.size()) : 0,
+                .pQueueFamilyIndices = concurrent ? queueFamilies.data() : nullptr,
                 .initialLayout = info.initialLayout,
-        });
+        };
+    }
+
+    ResourceRef ImagePool::create(const ImageInfo& info) {
+        return allocate(createImage(info));
+    }
+
+    Image ImagePool::createImage(const ImageInfo& info) {
+        auto& device = Vulkan::getDevice();
+
+        vk::raii::Image image = device.createImage(toImageCreateInfo(info));
 
         Allocation allocation;
-        VmaAllocationCreateInfo allocInfo{
-               // .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-                .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        };
-        vmaAllocateMemoryForImage(*Vulkan::getAllocator(), static_cast<VkImage>(*image), &allocInfo, &allocation.allocation, &allocation.allocationInfo);
-        vmaBindImageMemory(*Vulkan::getAllocator(), allocation.allocation, static_cast<VkImage>(*image));
+        if(info.memory != UNDEFINED_RESOURCE) {
+            auto& memory = RENDER_SYSTEM.getResourceManager().getMemory(info.memory);
+            vmaBindImageMemory2(*Vulkan::getAllocator(), memory.allocation.allocation, info.memoryOffset, static_cast<VkImage>(*image), nullptr);
+        } else {
+            // Stays within the heap's budget when the budget is known. Past it the image moves to system memory, which
+            // is slower but keeps long sessions near the VRAM ceiling running. Only when the image can't live there
+            // does it over-commit device local memory.
+            VmaAllocationCreateInfo allocInfo{
+                    .flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT,
+                    .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            };
+            VkResult result = vmaAllocateMemoryForImage(*Vulkan::getAllocator(), static_cast<VkImage>(*image), &allocInfo, &allocation.allocation, &allocation.allocationInfo);
+            if(result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+                const VkPhysicalDeviceMemoryProperties* properties;
+                vmaGetMemoryProperties(*Vulkan::getAllocator(), &properties);
+                uint32_t systemMemoryTypes = 0;
+                for (uint32_t i = 0; i < properties->memoryTypeCount; i++) {
+                    if(!(properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+                        systemMemoryTypes |= 1u << i;
+                }
+                allocInfo = VmaAllocationCreateInfo{
+                        .flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT,
+                        .memoryTypeBits = systemMemoryTypes
+                };
+                result = systemMemoryTypes != 0 ? vmaAllocateMemoryForImage(*Vulkan::getAllocator(), static_cast<VkImage>(*image), &allocInfo,
+                                                                            &allocation.allocation, &allocation.allocationInfo)
+                                                : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+                if(result == VK_SUCCESS) {
+                    WARN("Out of device local memory, image {} ({}x{}) falls back to system memory", info.name, info.width, info.height);
+                } else {
+                    WARN("Out of device local memory, image {} ({}x{}) can't use system memory and over-commits the budget",
+                         info.name, info.width, info.height);
+                    allocInfo = VmaAllocationCreateInfo{
+                            .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                    };
+                    result = vmaAllocateMemoryForImage(*Vulkan::getAllocator(), static_cast<VkImage>(*image), &allocInfo, &allocation.allocation, &allocation.allocationInfo);
+                }
+            }
+            if(result != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate image memory");
+            vmaBindImageMemory(*Vulkan::getAllocator(), allocation.allocation, static_cast<VkImage>(*image));
+        }
 
         vk::raii::ImageView view = device.createImageView(vk::ImageViewCreateInfo{
                 .image = *image,
@@ -43,21 +93,73 @@ namespace vanguard {
                 }
         });
 
-        return allocate(Image{
+        return Image{
                 .info = info,
                 .image = std::move(image),
                 .view = std::move(view),
+                .allocation = std::move(allocation),
+                .serial = m_nextSerial++
+        };
+    }
+
+    Image ImagePool::resize(ResourceRef ref, uint32_t width, uint32_t height) {
+        ImageInfo info = get(ref).info;
+        info.width = width;
+        info.height = height;
+        return replace(ref, createImage(info));
+    }
+
+    vk::MemoryRequirements ImagePool::getMemoryRequirements(const ImageInfo& info) {
+        // Requirements can only be queried from a live image, it's never bound so this is cheap
+        vk::raii::Image image = Vulkan::getDevice().createImage(toImageCreateInfo(info));
+        return image.getMemoryRequirements();
+    }
+
+    ResourceRef MemoryPool::create(const MemoryInfo& info) {
+        return allocate(createMemory(info));
+    }
+
+    Memory MemoryPool::resize(ResourceRef ref, const vk::MemoryRequirements& requirements) {
+        MemoryInfo info = get(ref).info;
+        info.requirements = requirements;
+        return replace(ref, createMemory(info));
+    }
+
+    Memory MemoryPool::createMemory(const MemoryInfo& info) {
+        VkMemoryRequirements requirements = info.requirements;
+        Allocation allocation;
+        VmaAllocationCreateInfo allocInfo{
+                .requiredFlags = static_cast<VkMemoryPropertyFlags>(info.properties)
+        };
+        vmaAllocateMemory(*Vulkan::getAllocator(), &requirements, &allocInfo, &allocation.allocation, &allocation.allocationInfo);
+
+        return Memory{
+                .info = info,
                 .allocation = std::move(allocation)
-        });
+        };
     }
 
     ResourceRef BufferPool::create(const BufferInfo& info) {
+        return allocate(createBuffer(info));
+    }
+
+    Buffer BufferPool::resize(ResourceRef ref, size_t size) {
+        BufferInfo info = get(ref).info;
+        info.size = size;
+        return replace(ref, createBuffer(info));
+    }
+
+    Buffer BufferPool::createBuffer(const BufferInfo& info) {
         auto& device = Vulkan::getDevice();
 
+        const auto& queueFamilies = info.asyncUpload ? Vulkan::getUploadQueueFamilyIndices() : Vulkan::getQueueFamilyIndices();
+        bool concurrent = info.concurrent && queueFamilies.size() > 1;
         vk::raii::Buffer buffer = device.createBuffer(vk::BufferCreateInfo{
                 .size = info.size,
                 .usage = info.usage,
-                .sharingMode = vk::SharingMode::eExclusive
+                .sharingMode = concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+                .queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(queueFamilies.size()) : 0,
+                .pQueueFamilyIndices = concurrent ? queueFamilies.data() : nullptr,
         });
 
         Allocation allocation;
@@ -65,18 +167,26 @@ namespace vanguard {
                 .flags = info.memoryFlags,
               //  .usage = info.memoryUsage,
                 .requiredFlags = static_cast<VkMemoryPropertyFlags>(info.memoryProperties),
+                .preferredFlags = static_cast<VkMemoryPropertyFlags>(info.preferredMemoryProperties),
         };
         vmaAllocateMemoryForBuffer(*Vulkan::getAllocator(), static_cast<VkBuffer>(*buffer), &allocInfo, &allocation.allocation, &allocation.allocationInfo);
         vmaBindBufferMemory(*Vulkan::getAllocator(), allocation.allocation, static_cast<VkBuffer>(*buffer));
 
-        return allocate(Buffer{
+        return Buffer{
                 .info = info,
                 .buffer = std::move(buffer),
                 .allocation = std::move(allocation)
-        });
+        };
     }
 
     ResourceRef SamplerPool::create(const SamplerInfo& info) {
+        auto it = m_samplers.find(info);
+        if(it != m_samplers.end()) {
+            m_referenceCounts[it->second]++;
+            return it->second;
+        }
+
+        bool anisotropy = info.maxAnisotropy > 1.0f && Vulkan::getEnabledFeatures().samplerAnisotropy;
         vk::raii::Sampler sampler = Vulkan::getDevice().createSampler(vk::SamplerCreateInfo{
                 .magFilter = info.magFilter,
                 .minFilter = info.minFilter,
@@ -84,17 +194,39 @@ namespace vanguard {
                 .addressModeU = info.addressModeU,
                 .addressModeV = info.addressModeV,
                 .addressModeW = info.addressModeW,
+                .mipLodBias = info.mipLodBias,
+                .anisotropyEnable = anisotropy,
+                .maxAnisotropy = anisotropy ? std::min(info.maxAnisotropy, Vulkan::getPhysicalDevice().getProperties().limits.maxSamplerAnisotropy) : 1.0f,
+                .compareEnable = info.compareEnable,
+                .compareOp = info.compareOp,
+                .minLod = info.minLod,
+                .maxLod = info.maxLod,
+                .borderColor = info.borderColor,
         });
 
-        return allocate(Sampler{
+        ResourceRef ref = allocate(Sampler{
                 .info = info,
                 .sampler = std::move(sampler)
         });
+        m_samplers.emplace(info, ref);
+        m_referenceCounts[ref] = 1;
+        return ref;
+    }
+
+    std::optional<Sampler> SamplerPool::release(ResourceRef ref) {
+        if(--m_referenceCounts.at(ref) > 0)
+            return std::nullopt;
+        m_referenceCounts.erase(ref);
+        m_samplers.erase(get(ref).info);
+        return destroy(ref);
     }
 
     ResourceRef DescriptorSetLayoutPool::create(const DescriptorSetLayoutInfo& info) {
         std::vector<vk::DescriptorSetLayoutBinding> bindings;
+        std::vector<vk::DescriptorBindingFlags> bindingFlags;
         bindings.reserve(info.bindings.size());
+        bindingFlags.reserve(info.bindings.size());
+        bool updateAfterBind = false;
         for (const auto& binding : info.bindings) {
             bindings.push_back(vk::DescriptorSetLayoutBinding{
                     .binding = binding.binding,
@@ -103,9 +235,20 @@ namespace vanguard {
                     .stageFlags = binding.stages,
                     .pImmutableSamplers = nullptr
             });
+            bindingFlags.push_back(binding.flags);
+            updateAfterBind |= static_cast<bool>(binding.flags & vk::DescriptorBindingFlagBits::eUpdateAfterBind);
         }
 
+        // Only chained when needed, the flags require descriptor indexing
+        bool hasBindingFlags = std::any_of(bindingFlags.begin(), bindingFlags.end(), [](vk::DescriptorBindingFlags flags) { return static_cast<bool>(flags); });
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+                .bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+                .pBindingFlags = bindingFlags.data()
+        };
         vk::raii::DescriptorSetLayout layout = Vulkan::getDevice().createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+                .pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr,
+                .flags = (updateAfterBind ? vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool : vk::DescriptorSetLayoutCreateFlags{}) |
+                         (info.pushDescriptor ? vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR : vk::DescriptorSetLayoutCreateFlags{}),
                 .bindingCount = static_cast<uint32_t>(bindings.size()),
                 .pBindings = bindings.data()
         });
@@ -117,30 +260,52 @@ namespace vanguard {
     }
 
     ResourceRef DescriptorSetPool::create(const vanguard::DescriptorSetInfo& info) {
-        auto& device = Vulkan::getDevice();
-        auto& pool = *Vulkan::getDescriptorPool();
+        return create(info, 1).at(0);
+    }
 
-        vk::DescriptorSetLayout layout = *RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(info.layout).layout;
+    std::vector<ResourceRef> DescriptorSetPool::create(const DescriptorSetInfo& info, uint32_t count) {
+        auto& setLayout = RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(info.layout);
+        if(setLayout.info.pushDescriptor)
+            throw std::runtime_error("Descriptor sets can't be allocated from a push descriptor layout");
+        vk::DescriptorSetLayout layout = *setLayout.layout;
+        auto sets = m_allocator.allocate(std::vector<vk::DescriptorSetLayout>(count, layout));
+
+        std::vector<ResourceRef> references;
+        references.reserve(count);
+        for (auto& set: sets) {
+            references.push_back(allocate(DescriptorSet{
+                    .info = info,
+                    .set = std::move(set)
+            }));
+        }
+        return references;
+    }
 
-        auto sets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
-                .descriptorPool = pool,
-                .descriptorSetCount = 1,
-                .pSetLayouts = &layout
-        });
+    // Bytes of the state an object is created from, only trivially copyable fields without padding are added
+    class CacheKey {
+    public:
+        template <typename T> requires std::is_trivially_copyable_v<T>
+        CacheKey& add(const T& value) {
+            return addBytes(&value, sizeof(T));
+        }
+        CacheKey& addBytes(const void* data, size_t size) {
+            m_key.append(static_cast<const char*>(data), size);
+            return *this;
+        }
 
-        return allocate(DescriptorSet{
-                .info = info,
-                .set = std::move(sets[0])
-        });
-    }
+        [[nodiscard]] const std::string& get() const { return m_key; }
+    private:
+        std::string m_key;
+    };
 
-    void DescriptorSetPool::update(ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const {
-        auto& set = get(ref);
+    // Resolved descriptor infos for each write, pointed to by both raw writes and update template data
+    struct ResolvedDescriptorWrite {
+        std::optional<vk::DescriptorImageInfo> image;
+        std::optional<vk::DescriptorBufferInfo> buffer;
+    };
 
-        std::vector<vk::WriteDescriptorSet> vkWrites;
-        std::vector<std::optional<vk::DescriptorImageInfo>> imageInfos(writes.size());
-        std::vector<std::optional<vk::DescriptorBufferInfo>> bufferInfos(writes.size());
-        vkWrites.reserve(writes.size());
+    static std::vector<ResolvedDescriptorWrite> resolveDescriptorWrites(const std::vector<DescriptorSetWrite>& writes) {
+        std::vector<ResolvedDescriptorWrite> resolved(writes.size());
         for (int i = 0; i < writes.size(); ++i) {
             auto& write = writes[i];
             if(!write.image.has_value() && !write.buffer.has_value()) {
@@ -149,183 +314,237 @@ namespace vanguard {
 
             if(write.image.has_value()) {
                 auto& image = RENDER_SYSTEM.getResourceManager().getImage(write.image->image);
-                imageInfos[i] = vk::DescriptorImageInfo{
+                resolved[i].image = vk::DescriptorImageInfo{
                         .imageView = *image.view,
                         .imageLayout = write.image->imageLayout
                 };
                 if(write.image->sampler != UNDEFINED_RESOURCE) {
                     auto& sampler = RENDER_SYSTEM.getResourceManager().getSampler(write.image->sampler);
-                    imageInfos[i]->sampler = *sampler.sampler;
+                    resolved[i].image->sampler = *sampler.sampler;
                 }
             }
             if(write.buffer.has_value()) {
                 auto& buffer = RENDER_SYSTEM.getResourceManager().getBuffer(write.buffer->buffer);
-                bufferInfos[i] = vk::DescriptorBufferInfo{
+                resolved[i].buffer = vk::DescriptorBufferInfo{
                         .buffer = *buffer.buffer,
                         .offset = write.buffer->offset,
                         .range = write.buffer->size
                 };
             }
+        }
+        return resolved;
+    }
 
+    static std::vector<vk::WriteDescriptorSet> toVkWrites(vk::DescriptorSet set, const std::vector<DescriptorSetWrite>& writes,
+                                                          const std::vector<ResolvedDescriptorWrite>& resolved) {
+        std::vector<vk::WriteDescriptorSet> vkWrites;
+        vkWrites.reserve(writes.size());
+        for (int i = 0; i < writes.size(); ++i) {
             vkWrites.push_back(vk::WriteDescriptorSet{
-                    .dstSet = *set.set,
-                    .dstBinding = write.binding,
+                    .dstSet = set,
+                    .dstBinding = writes[i].binding,
                     .dstArrayElement = 0,
                     .descriptorCount = 1,
-                    .descriptorType = write.type,
-                    .pImageInfo = imageInfos[i].has_value() ? &imageInfos[i].value() : nullptr,
-                    .pBufferInfo = bufferInfos[i].has_value() ? &bufferInfos[i].value() : nullptr,
+                    .descriptorType = writes[i].type,
+                    .pImageInfo = resolved[i].image.has_value() ? &resolved[i].image.value() : nullptr,
+                    .pBufferInfo = resolved[i].buffer.has_value() ? &resolved[i].buffer.value() : nullptr,
                     .pTexelBufferView = nullptr
             });
         }
-        Vulkan::getDevice().updateDescriptorSets(vkWrites, {});
+        return vkWrites;
     }
 
-    void DescriptorSetPool::cmdUpdate(vk::CommandBuffer& cmd, ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const {
-        // TODO
+    // One tightly packed entry per write, as laid out by the update template
+    union DescriptorTemplateData {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
+    // Templates don't reference the layout after creation, so they are keyed on its bindings and shared between
+    // identically defined layouts
+    const vk::raii::DescriptorUpdateTemplate& DescriptorSetPool::getUpdateTemplate(const DescriptorSetLayout& layout,
+                                                                                 const std::vector<DescriptorSetWrite>& writes) const {
+        CacheKey key;
+        key.add(layout.info.bindings.size()).add(layout.info.pushDescriptor);
+        for (const DescriptorSetBinding& binding: layout.info.bindings)
+            key.add(binding.binding).add(binding.type).add(binding.count).add(binding.stages).add(binding.flags);
+        for (const DescriptorSetWrite& write: writes)
+            key.add(write.binding).add(write.type);
+
+        auto it = m_updateTemplates.find(key.get());
+        if(it != m_updateTemplates.end())
+            return it->second;
+
+        std::vector<vk::DescriptorUpdateTemplateEntry> entries;
+        entries.reserve(writes.size());
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            entries.push_back(vk::DescriptorUpdateTemplateEntry{
+                    .dstBinding = writes[i].binding,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = writes[i].type,
+                    .offset = i * sizeof(DescriptorTemplateData),
+                    .stride = sizeof(DescriptorTemplateData)
+            });
+        }
+        auto updateTemplate = Vulkan::getDevice().createDescriptorUpdateTemplate(vk::DescriptorUpdateTemplateCreateInfo{
+                .descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size()),
+                .pDescriptorUpdateEntries = entries.data(),
+                .templateType = vk::DescriptorUpdateTemplateType::eDescriptorSet,
+                .descriptorSetLayout = *layout.layout
+        });
+        return m_updateTemplates.emplace(key.get(), std::move(updateTemplate)).first->second;
     }
 
-    static vk::raii::ShaderModule createShaderModule(const std::vector<uint32_t>& code) {
-        return Vulkan::getDevice().createShaderModule(vk::ShaderModuleCreateInfo{
-                .codeSize = code.size() * sizeof(uint32_t),
-                .pCode = reinterpret_cast<const uint32_t*>(code.data()),
-        });
+    // Goes through a cached update template, which skips building a WriteDescriptorSet per binding
+    void DescriptorSetPool::update(ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const {
+        if(writes.empty())
+            return;
+        auto& set = get(ref);
+        auto& layout = RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(set.info.layout);
+        const auto& updateTemplate = getUpdateTemplate(layout, writes);
+
+        auto resolved = resolveDescriptorWrites(writes);
+        std::vector<DescriptorTemplateData> data(writes.size());
+        for (int i = 0; i < writes.size(); ++i) {
+            if(resolved[i].image.has_value())
+                data[i].image = *resolved[i].image;
+            else
+                data[i].buffer = *resolved[i].buffer;
+        }
+        set.set.updateWithTemplate(*updateTemplate, data.front());
     }
 
-    ResourceRef RenderPipelinePool::create(const RenderPipelineInfo& info) {
-        std::vector<vk::AttachmentDescription> attachments;
-        std::vector<vk::ImageView> attachmentViews;
-        std::vector<vk::AttachmentReference> inputReferences;
-        std::vector<vk::AttachmentReference> colorReferences;
-        std::optional<vk::AttachmentReference> depthStencilReference;
+    // Writes straight into the command buffer, the layout at this set index has to be a push descriptor layout
+    void DescriptorSetPool::cmdUpdate(vk::CommandBuffer cmd, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t set,
+                                      const std::vector<DescriptorSetWrite>& writes) {
+        if(!Vulkan::isPushDescriptorSupported())
+            throw std::runtime_error("Push descriptors aren't supported by this device");
+        auto resolved = resolveDescriptorWrites(writes);
+        // Push descriptor writes ignore dstSet
+        auto vkWrites = toVkWrites(nullptr, writes, resolved);
+        // An extension function, so it goes through the device's dispatcher
+        cmd.pushDescriptorSetKHR(bindPoint, pipelineLayout, set, vkWrites, *Vulkan::getDevice().getDispatcher());
+    }
 
-        for (const RenderPipelineImageInfo& imageInfo: info.inputAttachments) {
-            auto& image = RENDER_SYSTEM.getResourceManager().getImage(imageInfo.image);
-            attachments.push_back(vk::AttachmentDescription{
-                    .format = image.info.format,
-                    .samples = vk::SampleCountFlagBits::e1,
-                    .loadOp = imageInfo.loadOp,
-                    .storeOp = imageInfo.storeOp,
-                    .stencilLoadOp = imageInfo.loadOp,
-                    .stencilStoreOp = imageInfo.storeOp,
-                    .initialLayout = imageInfo.initialLayout,
-                    .finalLayout = imageInfo.finalLayout
-            });
-            attachmentViews.push_back(*image.view);
-            inputReferences.push_back(vk::AttachmentReference{
-                    .attachment = static_cast<uint32_t>(attachments.size() - 1),
-                    .layout = vk::ImageLayout::eShaderReadOnlyOptimal
+    static std::shared_ptr<const vk::raii::ShaderModule> createShaderModule(PipelineObjectCaches& caches, const std::vector<uint32_t>& code) {
+        CacheKey key;
+        key.addBytes(code.data(), code.size() * sizeof(uint32_t));
+        return caches.shaderModules.getOrCreate(key.get(), [&]() {
+            return Vulkan::getDevice().createShaderModule(vk::ShaderModuleCreateInfo{
+                    .codeSize = code.size() * sizeof(uint32_t),
+                    .pCode = reinterpret_cast<const uint32_t*>(code.data()),
             });
+        });
+    }
+
+    static std::shared_ptr<const vk::raii::PipelineLayout> createPipelineLayout(PipelineObjectCaches& caches,
+                                                                                 const std::vector<ResourceRef>& layoutReferences,
+                                                                                 const std::vector<vk::PushConstantRange>& pushConstantRanges) {
+        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+        descriptorSetLayouts.reserve(layoutReferences.size());
+        // Keyed on the bindings rather than the handles, identically defined set layouts are compatible
+        CacheKey key;
+        key.add(layoutReferences.size());
+        for(ResourceRef reference : layoutReferences) {
+            auto& layout = RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(reference);
+            descriptorSetLayouts.push_back(*layout.layout);
+            key.add(layout.info.bindings.size()).add(layout.info.pushDescriptor);
+            for (const DescriptorSetBinding& binding: layout.info.bindings)
+                key.add(binding.binding).add(binding.type).add(binding.count).add(binding.stages).add(binding.flags);
         }
-        for (const RenderPipelineImageInfo& imageInfo: info.colorAttachments) {
-            auto& image = RENDER_SYSTEM.getResourceManager().getImage(imageInfo.image);
-            attachments.push_back(vk::AttachmentDescription{
-                    .format = image.info.format,
-                    .samples = vk::SampleCountFlagBits::e1,
-                    .loadOp = imageInfo.loadOp,
-                    .storeOp = imageInfo.storeOp,
-                    .stencilLoadOp = imageInfo.loadOp,
-                    .stencilStoreOp = imageInfo.storeOp,
-                    .initialLayout = imageInfo.initialLayout,
-                    .finalLayout = imageInfo.finalLayout
+        key.add(pushConstantRanges.size());
+        for (const vk::PushConstantRange& range: pushConstantRanges)
+            key.add(range.stageFlags).add(range.offset).add(range.size);
+
+        return caches.pipelineLayouts.getOrCreate(key.get(), [&]() {
+            return Vulkan::getDevice().createPipelineLayout(vk::PipelineLayoutCreateInfo{
+                    .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
+                    .pSetLayouts = descriptorSetLayouts.data(),
+                    .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+                    .pPushConstantRanges = pushConstantRanges.data()
             });
+        });
+    }
+
+    // Attachments are in the same order as the render pass' attachment descriptions
+    static std::shared_ptr<const vk::raii::Framebuffer> createFramebuffer(PipelineObjectCaches& caches, const vk::raii::RenderPass& renderPass,
+                                                                          const RenderPipelineInfo& info) {
+        // The render pass outlives every framebuffer created for it, so its handle is stable. Views aren't: images are
+        // resized and destroyed under live pipelines and a new view may get an old handle, so they're keyed on the
+        // image's reference and serial together with what the view is created from.
+        CacheKey key;
+        key.add(static_cast<VkRenderPass>(*renderPass)).add(info.extent.width).add(info.extent.height);
+        std::vector<vk::ImageView> attachmentViews;
+        auto addAttachment = [&](ResourceRef ref) {
+            auto& image = RENDER_SYSTEM.getResourceManager().getImage(ref);
             attachmentViews.push_back(*image.view);
-            colorReferences.push_back(vk::AttachmentReference{
-                    .attachment = static_cast<uint32_t>(attachments.size() - 1),
-                    .layout = vk::ImageLayout::eColorAttachmentOptimal
-            });
+            key.add(ref).add(image.serial).add(image.info.format).add(image.info.aspect).add(image.info.type).add(image.info.arrayLayers);
+        };
+        for (const RenderPipelineImageInfo& imageInfo: info.inputAttachments) {
+            addAttachment(imageInfo.image);
+        }
+        for (const RenderPipelineImageInfo& imageInfo: info.colorAttachments) {
+            addAttachment(imageInfo.image);
         }
         if(info.depthStencilAttachment.image != UNDEFINED_RESOURCE) {
-            auto& image = RENDER_SYSTEM.getResourceManager().getImage(info.depthStencilAttachment.image);
-            attachments.push_back(vk::AttachmentDescription{
-                    .format = image.info.format,
-                    .samples = vk::SampleCountFlagBits::e1,
-                    .loadOp = info.depthStencilAttachment.loadOp,
-                    .storeOp = info.depthStencilAttachment.storeOp,
-                    .stencilLoadOp = info.depthStencilAttachment.loadOp,
-                    .stencilStoreOp = info.depthStencilAttachment.storeOp,
-                    .initialLayout = info.depthStencilAttachment.initialLayout,
-                    .finalLayout = info.depthStencilAttachment.finalLayout
-            });
-            attachmentViews.push_back(*image.view);
-            depthStencilReference = vk::AttachmentReference{
-                    .attachment = static_cast<uint32_t>(attachments.size() - 1),
-                    .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal
-            };
+            addAttachment(info.depthStencilAttachment.image);
         }
 
-        vk::SubpassDescription subpass{
-                .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
-                .inputAttachmentCount = static_cast<uint32_t>(inputReferences.size()),
-                .pInputAttachments = inputReferences.data(),
-                .colorAttachmentCount = static_cast<uint32_t>(colorReferences.size()),
-                .pColorAttachments = colorReferences.data(),
-                .pDepthStencilAttachment = depthStencilReference.has_value() ? &depthStencilReference.value() : nullptr
-        };
-
-        std::vector<vk::SubpassDependency> subpassDependencies;
-        subpassDependencies.push_back(vk::SubpassDependency{
-                .srcSubpass = VK_SUBPASS_EXTERNAL,
-                .dstSubpass = 0,
-                .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                .srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead,
-                .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-        });
-        if(depthStencilReference.has_value()) {
-            subpassDependencies.push_back(vk::SubpassDependency{
-                    .srcSubpass = VK_SUBPASS_EXTERNAL,
-                    .dstSubpass = 0,
-                    .srcStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests,
-                    .dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests,
-                    .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead,
-                    .dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        return caches.framebuffers.getOrCreate(key.get(), [&]() {
+            return Vulkan::getDevice().createFramebuffer(vk::FramebufferCreateInfo{
+                    .renderPass = *renderPass,
+                    .attachmentCount = static_cast<uint32_t>(attachmentViews.size()),
+                    .pAttachments = attachmentViews.data(),
+                    .width = info.extent.width,
+                    .height = info.extent.height,
+                    .layers = 1
             });
-        }
-
-        vk::raii::RenderPass renderPass = Vulkan::getDevice().createRenderPass(vk::RenderPassCreateInfo{
-                .attachmentCount = static_cast<uint32_t>(attachments.size()),
-                .pAttachments = attachments.data(),
-                .subpassCount = 1,
-                .pSubpasses = &subpass,
-                .dependencyCount = static_cast<uint32_t>(subpassDependencies.size()),
-                .pDependencies = subpassDependencies.data()
-        });
-        vk::raii::Framebuffer framebuffer = Vulkan::getDevice().createFramebuffer(vk::FramebufferCreateInfo{
-                .renderPass = *renderPass,
-                .attachmentCount = static_cast<uint32_t>(attachmentViews.size()),
-                .pAttachments = attachmentViews.data(),
-                .width = info.extent.width,
-                .height = info.extent.height,
-                .layers = 1
         });
+    }
 
-        vk::raii::ShaderModule vertexShader = createShaderModule(ASSETS.get<SpirVShaderCode>(info.vertexShaderPath));
-        vk::raii::ShaderModule fragmentShader = createShaderModule(ASSETS.get<SpirVShaderCode>(info.fragmentShaderPath));
+    std::shared_ptr<const vk::raii::Framebuffer> RenderPipelinePool::resizeFramebuffer(ResourceRef ref, vk::Extent2D extent) {
+        auto& pipeline = getMutable(ref);
+        pipeline.info.extent = extent;
+        return std::exchange(pipeline.framebuffer, createFramebuffer(m_caches, *pipeline.renderPass, pipeline.info));
+    }
 
+    // Everything a render pipeline is compiled from, held by value so it can be compiled on a worker thread
+    struct RenderPipelineState {
+        std::shared_ptr<const vk::raii::ShaderModule> vertexShader;
+        std::shared_ptr<const vk::raii::ShaderModule> fragmentShader;
+        std::shared_ptr<const vk::raii::RenderPass> renderPass;
+        std::shared_ptr<const vk::raii::PipelineLayout> pipelineLayout;
+        std::optional<VertexInputData> vertexInputData;
+        bool depthStencil = false;
+        bool depthTest = false;
+        bool depthWrite = false;
+    };
+
+    static vk::raii::Pipeline compileRenderPipeline(const RenderPipelineState& state) {
         vk::PipelineShaderStageCreateInfo shaderStageInfo[] = {
                 vk::PipelineShaderStageCreateInfo{
                         .stage = vk::ShaderStageFlagBits::eVertex,
-                        .module = *vertexShader,
+                        .module = **state.vertexShader,
                         .pName = "main"
                 },
                 vk::PipelineShaderStageCreateInfo{
                         .stage = vk::ShaderStageFlagBits::eFragment,
-                        .module = *fragmentShader,
+                        .module = **state.fragmentShader,
                         .pName = "main"
                 }
         };
 
         std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
         vk::VertexInputBindingDescription bindingDescription{};
-        if(info.vertexInputData.has_value()) {
+        if(state.vertexInputData.has_value()) {
             bindingDescription = {
                     .binding = 0,
-                    .stride = info.vertexInputData->getStride() ,
+                    .stride = state.vertexInputData->getStride() ,
                     .inputRate = vk::VertexInputRate::eVertex
             };
-            attributeDescriptions.reserve(info.vertexInputData->getAttributes().size());
-            for(const auto& attribute : info.vertexInputData->getAttributes()) {
+            attributeDescriptions.reserve(state.vertexInputData->getAttributes().size());
+            for(const auto& attribute : state.vertexInputData->getAttributes()) {
                 attributeDescriptions.push_back(vk::VertexInputAttributeDescription{
                         .location = attribute.location,
                         .binding = 0,
@@ -346,23 +565,10 @@ namespace vanguard {
                 .primitiveRestartEnable = VK_FALSE
         };
 
-        vk::Viewport viewport{
-                .x = 0.0f,
-                .y = 0.0f,
-                .width = static_cast<float>(info.extent.width),
-                .height = static_cast<float>(info.extent.height),
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f
-        };
-        vk::Rect2D scissor{
-                .offset = vk::Offset2D{0, 0},
-                .extent = info.extent
-        };
+        // Viewport and scissor are set when recording so the pipeline outlives extent changes
         vk::PipelineViewportStateCreateInfo viewportStateInfo{
                 .viewportCount = 1,
-                .pViewports = &viewport,
                 .scissorCount = 1,
-                .pScissors = &scissor
         };
 
         vk::PipelineRasterizationStateCreateInfo rasterizationStateInfo{
@@ -391,9 +597,9 @@ namespace vanguard {
                 .depthTestEnable = VK_FALSE,
                 .depthWriteEnable = VK_FALSE,
         };
-        if(info.depthStencilAttachment.image != UNDEFINED_RESOURCE) {
-            depthStencilStateInfo.depthTestEnable = info.depthTest ? VK_TRUE : VK_FALSE;
-            depthStencilStateInfo.depthWriteEnable = info.depthWrite ? VK_TRUE : VK_FALSE;
+        if(state.depthStencil) {
+            depthStencilStateInfo.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+            depthStencilStateInfo.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
             depthStencilStateInfo.depthCompareOp = vk::CompareOp::eLess;
             depthStencilStateInfo.depthBoundsTestEnable = VK_FALSE;
             depthStencilStateInfo.minDepthBounds = 0.0f;
@@ -419,27 +625,13 @@ namespace vanguard {
                 .pAttachments = &colorBlendAttachment,
                 .blendConstants = blendConstants
         };
+        std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
         vk::PipelineDynamicStateCreateInfo dynamicStateInfo{
-                .dynamicStateCount = 0,
-                .pDynamicStates = nullptr
+                .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+                .pDynamicStates = dynamicStates.data()
         };
 
-        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
-        descriptorSetLayouts.reserve(info.descriptorSetLayouts.size());
-        for(ResourceRef reference : info.descriptorSetLayouts) {
-            auto& layout = RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(reference);
-            descriptorSetLayouts.push_back(*layout.layout);
-        }
-
-        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{
-                .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-                .pSetLayouts = descriptorSetLayouts.data(),
-                .pushConstantRangeCount = 0,
-                .pPushConstantRanges = nullptr
-        };
-        vk::raii::PipelineLayout pipelineLayout = Vulkan::getDevice().createPipelineLayout(pipelineLayoutInfo);
-
-        vk::raii::Pipeline pipeline = Vulkan::getDevice().createGraphicsPipeline(nullptr, vk::GraphicsPipelineCreateInfo{
+        return Vulkan::getDevice().createGraphicsPipeline(Vulkan::getPipelineCache(), vk::GraphicsPipelineCreateInfo{
                 .stageCount = 2,
                 .pStages = shaderStageInfo,
                 .pVertexInputState = &vertexInputInfo,
@@ -450,52 +642,226 @@ namespace vanguard {
                 .pDepthStencilState = &depthStencilStateInfo,
                 .pColorBlendState = &colorBlendStateInfo,
                 .pDynamicState = &dynamicStateInfo,
-                .layout = *pipelineLayout,
-                .renderPass = *renderPass,
+                .layout = **state.pipelineLayout,
+                .renderPass = **state.renderPass,
                 .subpass = 0,
                 .basePipelineHandle = nullptr,
                 .basePipelineIndex = -1
         });
+    }
 
-        return allocate(RenderPipeline{
-            .info = info,
-            .renderPass = std::move(renderPass),
-            .framebuffer = std::move(framebuffer),
-            .pipelineLayout = std::move(pipelineLayout),
-            .pipeline = std::move(pipeline)
+    // Compiles on the resource manager's worker threads, an identical pipeline which is still compiling is shared too
+    template <typename F>
+    static std::shared_ptr<const AsyncPipeline> compilePipeline(PipelineObjectCaches& caches, const CacheKey& key, F&& compile) {
+        return caches.pipelines.getOrCreate(key.get(), [&]() {
+            auto promise = std::make_shared<std::promise<vk::raii::Pipeline>>();
+            AsyncPipeline pipeline(promise->get_future().share());
+            RENDER_SYSTEM.getResourceManager().getPipelineCompiler().submit([promise, compile = std::forward<F>(compile)](uint32_t) {
+                try {
+                    promise->set_value(compile());
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            });
+            return pipeline;
         });
     }
 
-    ResourceRef ComputePipelinePool::create(const ComputePipelineInfo& info) {
-        vk::raii::ShaderModule computeShader = createShaderModule(ASSETS.get<SpirVShaderCode>(info.computeShaderPath));
+    ResourceRef RenderPipelinePool::create(const RenderPipelineInfo& info) {
+        auto toAttachment = [](const RenderPipelineImageInfo& imageInfo) {
+            return RenderPipelineAttachmentInfo{
+                    .format = RENDER_SYSTEM.getResourceManager().getImage(imageInfo.image).info.format,
+                    .initialLayout = imageInfo.initialLayout,
+                    .finalLayout = imageInfo.finalLayout,
+                    .loadOp = imageInfo.loadOp,
+                    .storeOp = imageInfo.storeOp
+            };
+        };
+        RenderPipelineStateInfo state{
+                .descriptorSetLayouts = info.descriptorSetLayouts,
+                .pushConstantRanges = info.pushConstantRanges,
+                .depthTest = info.depthTest,
+                .depthWrite = info.depthWrite,
+                .vertexShaderPath = info.vertexShaderPath,
+                .fragmentShaderPath = info.fragmentShaderPath,
+                .vertexInputData = info.vertexInputData
+        };
+        for (const RenderPipelineImageInfo& imageInfo: info.inputAttachments)
+            state.inputAttachments.push_back(toAttachment(imageInfo));
+        for (const RenderPipelineImageInfo& imageInfo: info.colorAttachments)
+            state.colorAttachments.push_back(toAttachment(imageInfo));
+        if(info.depthStencilAttachment.image != UNDEFINED_RESOURCE)
+            state.depthStencilAttachment = toAttachment(info.depthStencilAttachment);
+
+        RenderPipeline pipeline = compile(state);
+        pipeline.info = info;
+        pipeline.framebuffer = createFramebuffer(m_caches, *pipeline.renderPass, info);
+        return allocate(std::move(pipeline));
+    }
 
-        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
-        descriptorSetLayouts.reserve(info.descriptorSetLayouts.size());
-        for(ResourceRef reference : info.descriptorSetLayouts) {
-            auto& layout = RENDER_SYSTEM.getResourceManager().getDescriptorSetLayout(reference);
-            descriptorSetLayouts.push_back(*layout.layout);
+    RenderPipeline RenderPipelinePool::compile(const RenderPipelineStateInfo& info) {
+        std::vector<vk::AttachmentDescription> attachments;
+        std::vector<vk::AttachmentReference> inputReferences;
+        std::vector<vk::AttachmentReference> colorReferences;
+        std::optional<vk::AttachmentReference> depthStencilReference;
+
+        auto addAttachment = [&](const RenderPipelineAttachmentInfo& attachment) {
+            attachments.push_back(vk::AttachmentDescription{
+                    .format = attachment.format,
+                    .samples = vk::SampleCountFlagBits::e1,
+                    .loadOp = attachment.loadOp,
+                    .storeOp = attachment.storeOp,
+                    .stencilLoadOp = attachment.loadOp,
+                    .stencilStoreOp = attachment.storeOp,
+                    .initialLayout = attachment.initialLayout,
+                    .finalLayout = attachment.finalLayout
+            });
+            return static_cast<uint32_t>(attachments.size() - 1);
+        };
+        for (const RenderPipelineAttachmentInfo& attachment: info.inputAttachments) {
+            inputReferences.push_back(vk::AttachmentReference{
+                    .attachment = addAttachment(attachment),
+                    .layout = vk::ImageLayout::eShaderReadOnlyOptimal
+            });
+        }
+        for (const RenderPipelineAttachmentInfo& attachment: info.colorAttachments) {
+            colorReferences.push_back(vk::AttachmentReference{
+                    .attachment = addAttachment(attachment),
+                    .layout = vk::ImageLayout::eColorAttachmentOptimal
+            });
+        }
+        if(info.depthStencilAttachment.has_value()) {
+            depthStencilReference = vk::AttachmentReference{
+                    .attachment = addAttachment(*info.depthStencilAttachment),
+                    .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal
+            };
         }
 
-        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{
-                .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-                .pSetLayouts = descriptorSetLayouts.data(),
-                .pushConstantRangeCount = 0,
-                .pPushConstantRanges = nullptr
+        vk::SubpassDescription subpass{
+                .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
+                .inputAttachmentCount = static_cast<uint32_t>(inputReferences.size()),
+                .pInputAttachments = inputReferences.data(),
+                .colorAttachmentCount = static_cast<uint32_t>(colorReferences.size()),
+                .pColorAttachments = colorReferences.data(),
+                .pDepthStencilAttachment = depthStencilReference.has_value() ? &depthStencilReference.value() : nullptr
         };
-        vk::raii::PipelineLayout pipelineLayout = Vulkan::getDevice().createPipelineLayout(pipelineLayoutInfo);
 
-        vk::raii::Pipeline pipeline = Vulkan::getDevice().createComputePipeline(nullptr, vk::ComputePipelineCreateInfo{
-                .stage = vk::PipelineShaderStageCreateInfo{
-                        .stage = vk::ShaderStageFlagBits::eCompute,
-                        .module = *computeShader,
-                        .pName = "main"
-                },
-                .layout = *pipelineLayout
+        std::vector<vk::SubpassDependency> subpassDependencies;
+        subpassDependencies.push_back(vk::SubpassDependency{
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                .srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead,
+                .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        });
+        if(depthStencilReference.has_value()) {
+            subpassDependencies.push_back(vk::SubpassDependency{
+                    .srcSubpass = VK_SUBPASS_EXTERNAL,
+                    .dstSubpass = 0,
+                    .srcStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests,
+                    .dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests,
+                    .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead,
+                    .dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            });
+        }
+
+        // The subpass and its dependencies only vary with which attachments exist, so the descriptions cover the rest
+        CacheKey renderPassKey;
+        renderPassKey.add(inputReferences.size()).add(colorReferences.size());
+        for (const vk::AttachmentDescription& attachment: attachments) {
+            renderPassKey.add(attachment.format).add(attachment.loadOp).add(attachment.storeOp)
+                    .add(attachment.initialLayout).add(attachment.finalLayout);
+        }
+        auto renderPass = m_caches.renderPasses.getOrCreate(renderPassKey.get(), [&]() {
+            return Vulkan::getDevice().createRenderPass(vk::RenderPassCreateInfo{
+                    .attachmentCount = static_cast<uint32_t>(attachments.size()),
+                    .pAttachments = attachments.data(),
+                    .subpassCount = 1,
+                    .pSubpasses = &subpass,
+                    .dependencyCount = static_cast<uint32_t>(subpassDependencies.size()),
+                    .pDependencies = subpassDependencies.data()
+            });
+        });
+        auto vertexShader = createShaderModule(m_caches, ASSETS.get<SpirVShaderCode>(info.vertexShaderPath));
+        auto fragmentShader = createShaderModule(m_caches, ASSETS.get<SpirVShaderCode>(info.fragmentShaderPath));
+
+        auto pipelineLayout = createPipelineLayout(m_caches, info.descriptorSetLayouts, info.pushConstantRanges);
+
+        RenderPipelineState state{
+                .vertexShader = vertexShader,
+                .fragmentShader = fragmentShader,
+                .renderPass = renderPass,
+                .pipelineLayout = pipelineLayout,
+                .vertexInputData = info.vertexInputData,
+                .depthStencil = info.depthStencilAttachment.has_value(),
+                .depthTest = info.depthTest,
+                .depthWrite = info.depthWrite,
+        };
+
+        // Everything else in the create info is fixed, the shared objects stand in for their own state
+        CacheKey pipelineKey;
+        pipelineKey.add(static_cast<VkShaderModule>(**vertexShader)).add(static_cast<VkShaderModule>(**fragmentShader))
+                .add(static_cast<VkRenderPass>(**renderPass)).add(static_cast<VkPipelineLayout>(**pipelineLayout))
+                .add(state.depthStencil).add(state.depthTest).add(state.depthWrite);
+        if(info.vertexInputData.has_value()) {
+            pipelineKey.add(info.vertexInputData->getStride());
+            for (const auto& attribute: info.vertexInputData->getAttributes())
+                pipelineKey.add(attribute.location).add(attribute.format).add(attribute.offset);
+        }
+        auto pipeline = compilePipeline(m_caches, pipelineKey, [state]() { return compileRenderPipeline(state); });
+
+        return RenderPipeline{
+            .renderPass = std::move(renderPass),
+            .pipelineLayout = std::move(pipelineLayout),
+            .shaderModules = { std::move(vertexShader), std::move(fragmentShader) },
+            .pipeline = std::move(pipeline)
+        };
+    }
+
+    ResourceRef ComputePipelinePool::create(const ComputePipelineInfo& info) {
+        auto computeShader = createShaderModule(m_caches, ASSETS.get<SpirVShaderCode>(info.computeShaderPath));
+        auto pipelineLayout = createPipelineLayout(m_caches, info.descriptorSetLayouts, info.pushConstantRanges);
+
+        CacheKey pipelineKey;
+        pipelineKey.add(static_cast<VkShaderModule>(**computeShader)).add(static_cast<VkPipelineLayout>(**pipelineLayout));
+        auto pipeline = compilePipeline(m_caches, pipelineKey, [computeShader, pipelineLayout]() {
+            return Vulkan::getDevice().createComputePipeline(Vulkan::getPipelineCache(), vk::ComputePipelineCreateInfo{
+                    .stage = vk::PipelineShaderStageCreateInfo{
+                            .stage = vk::ShaderStageFlagBits::eCompute,
+                            .module = **computeShader,
+                            .pName = "main"
+                    },
+                    .layout = **pipelineLayout
+            });
         });
         return allocate(ComputePipeline{
             .info = info,
             .pipelineLayout = std::move(pipelineLayout),
+            .shaderModule = std::move(computeShader),
             .pipeline = std::move(pipeline)
         });
     }
-}
\ No newline at end of file
+
+    void ResourceManager::prewarmPipelines(const std::vector<RenderPipelineStateInfo>& renderPipelines, const std::vector<ComputePipelineInfo>& computePipelines) {
+        for (const RenderPipelineStateInfo& info: renderPipelines)
+            m_prewarmedRenderPipelines.push_back(m_renderPipelinePool.compile(info));
+        for (const ComputePipelineInfo& info: computePipelines)
+            m_prewarmedComputePipelines.push_back(m_computePipelinePool.create(info));
+        INFO("Pre-warming {} pipelines on {} threads", renderPipelines.size() + computePipelines.size(), m_pipelineCompiler.getThreadCount());
+    }
+
+    void ResourceManager::releasePrewarmedPipelines() {
+        for (ResourceRef pipeline: m_prewarmedComputePipelines)
+            destroyComputePipeline(pipeline);
+        // Never recorded, so the objects only the pre-warm kept alive can go right away
+        m_prewarmedRenderPipelines.clear();
+        m_prewarmedComputePipelines.clear();
+    }
+
+    ResourceManager::ResourceManager()
+            : m_descriptorSetPool(m_descriptorAllocator),
+              m_renderPipelinePool(m_objectCaches),
+              m_computePipelinePool(m_objectCaches),
+              m_pipelineCompiler(std::max(std::thread::hardware_concurrency(), 2u) - 1) {}
+}
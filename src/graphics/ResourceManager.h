@@ -1,42 +1,84 @@
 #pragma once
 
 #include "Allocator.h"
+#include "BindlessDescriptors.h"
+#include "DescriptorAllocator.h"
+#include "MemoryBudget.h"
 #include "Vulkan.h"
 
 #include "../Config.h"
+#include "../util/Hash.h"
+#include "../util/ThreadPool.h"
 #include "VertexInput.h"
 
+#include <future>
+#include <unordered_map>
+
 namespace vanguard {
+    // The low bits index the pool's slot and the high bits hold the slot's generation, which is bumped whenever the
+    // slot is freed. A reference kept past its resource's destruction fails validation instead of aliasing whatever
+    // reuses the slot.
     typedef uint32_t ResourceRef;
     constexpr ResourceRef UNDEFINED_RESOURCE = UINT32_MAX;
+    constexpr uint32_t RESOURCE_INDEX_BITS = 20;
+    constexpr uint32_t RESOURCE_INDEX_MASK = (1u << RESOURCE_INDEX_BITS) - 1;
+    // The last generation is skipped so no reference can equal UNDEFINED_RESOURCE
+    constexpr uint32_t RESOURCE_GENERATION_COUNT = (1u << (32 - RESOURCE_INDEX_BITS)) - 1;
 
     template <typename T, typename U>
     class ResourcePool {
     public:
         virtual ResourceRef create(const U& info) = 0;
-        inline void destroy(ResourceRef ref) {
-            m_freeIndices.push_back(ref);
-            m_resources[ref].~T();
+        // Frees the slot right away and hands back the resource, which frames in flight may still be using
+        [[nodiscard]] inline T destroy(ResourceRef ref) {
+            uint32_t index = validate(ref);
+            T resource = std::move(*m_resources[index]);
+            m_resources[index].reset();
+            m_generations[index] = (m_generations[index] + 1) % RESOURCE_GENERATION_COUNT;
+            m_freeIndices.push_back(index);
+            return resource;
         }
 
+        [[nodiscard]] inline bool isValid(ResourceRef ref) const {
+            uint32_t index = ref & RESOURCE_INDEX_MASK;
+            return index < m_resources.size() && m_generations[index] == ref >> RESOURCE_INDEX_BITS && m_resources[index].has_value();
+        }
         [[nodiscard]] inline const T& get(ResourceRef ref) const {
-            return m_resources[ref];
+            return *m_resources[validate(ref)];
         }
     protected:
+        [[nodiscard]] inline T& getMutable(ResourceRef ref) {
+            return *m_resources[validate(ref)];
+        }
         [[nodiscard]] inline ResourceRef allocate(T&& resource) {
+            uint32_t index;
             if(m_freeIndices.empty()) {
+                index = static_cast<uint32_t>(m_resources.size());
+                if(index > RESOURCE_INDEX_MASK)
+                    throw std::runtime_error("Resource pool is full");
                 m_resources.emplace_back(std::move(resource));
-                return static_cast<ResourceRef>(m_resources.size() - 1);
+                m_generations.push_back(0);
             } else {
-                ResourceRef ref = m_freeIndices.back();
+                index = m_freeIndices.back();
                 m_freeIndices.pop_back();
-                m_resources[ref] = std::move(resource);
-                return ref;
+                m_resources[index].emplace(std::move(resource));
             }
+            return m_generations[index] << RESOURCE_INDEX_BITS | index;
+        }
+        // Swaps the resource behind an existing reference and hands back the old one
+        inline T replace(ResourceRef ref, T&& resource) {
+            return std::exchange(*m_resources[validate(ref)], std::move(resource));
+        }
+    private:
+        [[nodiscard]] inline uint32_t validate(ResourceRef ref) const {
+            if(!isValid(ref))
+                throw std::runtime_error("Stale or invalid resource reference");
+            return ref & RESOURCE_INDEX_MASK;
         }
     private:
-        std::vector<T> m_resources;
-        std::vector<ResourceRef> m_freeIndices;
+        std::vector<std::optional<T>> m_resources;
+        std::vector<uint32_t> m_generations;
+        std::vector<uint32_t> m_freeIndices;
     };
 
     enum class ImageType {
@@ -52,17 +94,56 @@ namespace vanguard {
         uint32_t height = 0;
         uint32_t arrayLayers = 1;
         ImageType type = ImageType::Image2D;
+        // When set the image is bound into this memory instead of getting its own allocation
+        ResourceRef memory = UNDEFINED_RESOURCE;
+        vk::DeviceSize memoryOffset = 0;
+        // Usable from every queue without ownership transfers, for images the frame graph doesn't track
+        bool concurrent = false;
+        // Also shared with the transfer queue, required for destinations of the async uploader
+        bool asyncUpload = false;
+        // Memory usage is accounted under this name
+        std::string name;
     };
     struct Image {
         ImageInfo info;
         vk::raii::Image image;
         vk::raii::ImageView view;
         Allocation allocation;
+        // Unique per created image, unlike the Vulkan handles which the driver may hand out again
+        uint64_t serial = 0;
     };
 
     class ImagePool : public ResourcePool<Image, ImageInfo> {
     public:
         ResourceRef create(const ImageInfo& info) override;
+        // Recreates the image with a new extent under the same reference, rebinding it if it lives in shared memory
+        Image resize(ResourceRef ref, uint32_t width, uint32_t height);
+
+        [[nodiscard]] static vk::MemoryRequirements getMemoryRequirements(const ImageInfo& info);
+    private:
+        Image createImage(const ImageInfo& info);
+    private:
+        uint64_t m_nextSerial = 1;
+    };
+
+    // Raw device memory which multiple resources can be bound into, used for aliasing
+    struct MemoryInfo {
+        vk::MemoryRequirements requirements;
+        vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        std::string name;
+    };
+    struct Memory {
+        MemoryInfo info;
+        Allocation allocation;
+    };
+
+    class MemoryPool : public ResourcePool<Memory, MemoryInfo> {
+    public:
+        ResourceRef create(const MemoryInfo& info) override;
+        // Resources bound to the old memory have to be recreated
+        Memory resize(ResourceRef ref, const vk::MemoryRequirements& requirements);
+    private:
+        static Memory createMemory(const MemoryInfo& info);
     };
 
     struct BufferInfo {
@@ -71,6 +152,13 @@ namespace vanguard {
         VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
         VmaAllocationCreateFlags memoryFlags;
         vk::MemoryPropertyFlags memoryProperties;
+        // Used when a memory type with them and the required properties exists
+        vk::MemoryPropertyFlags preferredMemoryProperties;
+        // Usable from every queue without ownership transfers
+        bool concurrent = false;
+        // Also shared with the transfer queue, required for destinations of the async uploader
+        bool asyncUpload = false;
+        std::string name;
     };
     struct Buffer {
         BufferInfo info;
@@ -81,6 +169,10 @@ namespace vanguard {
     class BufferPool : public ResourcePool<Buffer, BufferInfo> {
     public:
         ResourceRef create(const BufferInfo& info) override;
+        // Reallocates the buffer with a new size under the same reference, contents aren't kept. Returns the old one.
+        Buffer resize(ResourceRef ref, size_t size);
+    private:
+        static Buffer createBuffer(const BufferInfo& info);
     };
 
     struct SamplerInfo {
@@ -90,16 +182,57 @@ namespace vanguard {
         vk::SamplerAddressMode addressModeU = vk::SamplerAddressMode::eRepeat;
         vk::SamplerAddressMode addressModeV = vk::SamplerAddressMode::eRepeat;
         vk::SamplerAddressMode addressModeW = vk::SamplerAddressMode::eRepeat;
+        // Anisotropic filtering is used above 1 when the device supports it, clamped to the device limit
+        float maxAnisotropy = 1.0f;
+        float mipLodBias = 0.0f;
+        float minLod = 0.0f;
+        float maxLod = 0.0f;
+        // Depth comparison for shadow map lookups
+        bool compareEnable = false;
+        vk::CompareOp compareOp = vk::CompareOp::eLessOrEqual;
+        vk::BorderColor borderColor = vk::BorderColor::eFloatTransparentBlack;
+
+        bool operator==(const SamplerInfo& other) const = default;
     };
+}
+
+template <>
+struct std::hash<vanguard::SamplerInfo> {
+    std::size_t operator()(const vanguard::SamplerInfo& info) const {
+        std::size_t seed = 0;
+        vanguard::hashCombine(seed, info.magFilter);
+        vanguard::hashCombine(seed, info.minFilter);
+        vanguard::hashCombine(seed, info.mipmapMode);
+        vanguard::hashCombine(seed, info.addressModeU);
+        vanguard::hashCombine(seed, info.addressModeV);
+        vanguard::hashCombine(seed, info.addressModeW);
+        vanguard::hashCombine(seed, info.maxAnisotropy);
+        vanguard::hashCombine(seed, info.mipLodBias);
+        vanguard::hashCombine(seed, info.minLod);
+        vanguard::hashCombine(seed, info.maxLod);
+        vanguard::hashCombine(seed, info.compareEnable);
+        vanguard::hashCombine(seed, info.compareOp);
+        vanguard::hashCombine(seed, info.borderColor);
+        return seed;
+    }
+};
+
+namespace vanguard {
 
     struct Sampler {
         SamplerInfo info;
         vk::raii::Sampler sampler;
     };
 
+    // Equal infos share one sampler, every create has to be matched by a release
     class SamplerPool : public ResourcePool<Sampler, SamplerInfo> {
     public:
         ResourceRef create(const SamplerInfo& info) override;
+        // Hands back the sampler once the last reference is released
+        std::optional<Sampler> release(ResourceRef ref);
+    private:
+        std::unordered_map<SamplerInfo, ResourceRef> m_samplers;
+        std::unordered_map<ResourceRef, uint32_t> m_referenceCounts;
     };
 
     struct DescriptorSetBinding {
@@ -107,9 +240,13 @@ namespace vanguard {
         vk::DescriptorType type;
         uint32_t count = 1;
         vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eAll;
+        // Descriptor indexing flags, update after bind makes the layout require an update after bind pool
+        vk::DescriptorBindingFlags flags{};
     };
     struct DescriptorSetLayoutInfo {
         std::vector<DescriptorSetBinding> bindings;
+        // No sets can be allocated from push descriptor layouts, they are written with DescriptorSetPool::cmdUpdate
+        bool pushDescriptor = false;
     };
     struct DescriptorSetLayout {
         DescriptorSetLayoutInfo info;
@@ -148,9 +285,24 @@ namespace vanguard {
 
     class DescriptorSetPool : public ResourcePool<DescriptorSet, DescriptorSetInfo> {
     public:
+        // The allocator has to outlive the pool, the sets free themselves into it
+        explicit DescriptorSetPool(DescriptorAllocator& allocator) : m_allocator(allocator) {}
+
         ResourceRef create(const DescriptorSetInfo& info) override;
+        // Allocates all of the sets in one call
+        std::vector<ResourceRef> create(const DescriptorSetInfo& info, uint32_t count);
         void update(ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const;
-        void cmdUpdate(vk::CommandBuffer& cmd, ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const;
+        // Pushes the writes into the command buffer for the bound pipeline layout's push descriptor set, nothing is
+        // allocated. Safe to call from recording threads.
+        static void cmdUpdate(vk::CommandBuffer cmd, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t set,
+                              const std::vector<DescriptorSetWrite>& writes);
+    private:
+        [[nodiscard]] const vk::raii::DescriptorUpdateTemplate& getUpdateTemplate(const DescriptorSetLayout& layout,
+                                                                                const std::vector<DescriptorSetWrite>& writes) const;
+    private:
+        DescriptorAllocator& m_allocator;
+        // Keyed on the layout's bindings and the written bindings
+        mutable std::unordered_map<std::string, vk::raii::DescriptorUpdateTemplate> m_updateTemplates;
     };
 
     struct RenderPipelineImageInfo {
@@ -162,6 +314,7 @@ namespace vanguard {
     };
     struct RenderPipelineInfo {
         std::vector<ResourceRef> descriptorSetLayouts;
+        std::vector<vk::PushConstantRange> pushConstantRanges;
         std::vector<RenderPipelineImageInfo> inputAttachments;
         std::vector<RenderPipelineImageInfo> colorAttachments;
         RenderPipelineImageInfo depthStencilAttachment{};
@@ -173,56 +326,198 @@ namespace vanguard {
         std::optional<VertexInputData> vertexInputData;
     };
 
+    // An attachment described by its format alone, for compiling pipelines before their images exist
+    struct RenderPipelineAttachmentInfo {
+        vk::Format format = vk::Format::eUndefined;
+        vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+        vk::ImageLayout finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear;
+        vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eStore;
+    };
+    // Everything a render pipeline is compiled from, only its framebuffer needs the images and the extent
+    struct RenderPipelineStateInfo {
+        std::vector<ResourceRef> descriptorSetLayouts;
+        std::vector<vk::PushConstantRange> pushConstantRanges;
+        std::vector<RenderPipelineAttachmentInfo> inputAttachments;
+        std::vector<RenderPipelineAttachmentInfo> colorAttachments;
+        std::optional<RenderPipelineAttachmentInfo> depthStencilAttachment;
+        bool depthTest = false;
+        bool depthWrite = false;
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
+        std::optional<VertexInputData> vertexInputData;
+    };
+
+    // A pipeline which may still be compiling on one of the resource manager's worker threads
+    class AsyncPipeline {
+    public:
+        explicit AsyncPipeline(std::shared_future<vk::raii::Pipeline> pipeline) : m_pipeline(std::move(pipeline)) {}
+
+        [[nodiscard]] bool isReady() const { return m_pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+        // Blocks until compiled, rethrows if compilation failed
+        void wait() const { m_pipeline.get(); }
+
+        // Blocks until compiled
+        vk::Pipeline operator*() const { return *m_pipeline.get(); }
+    private:
+        std::shared_future<vk::raii::Pipeline> m_pipeline;
+    };
+
+    // Objects created from identical state are shared. Only weak references are held, so an object is destroyed
+    // together with the last pipeline using it.
+    template <typename T>
+    class ObjectCache {
+    public:
+        template <typename F>
+        std::shared_ptr<const T> getOrCreate(const std::string& key, F&& create) {
+            auto it = m_objects.find(key);
+            if(it != m_objects.end()) {
+                if(auto object = it->second.lock())
+                    return object;
+            }
+
+            std::erase_if(m_objects, [](const auto& entry) { return entry.second.expired(); });
+            auto object = std::make_shared<const T>(create());
+            m_objects[key] = object;
+            return object;
+        }
+    private:
+        std::unordered_map<std::string, std::weak_ptr<const T>> m_objects;
+    };
+
+    // Shared by the render and compute pipelines of one resource manager
+    struct PipelineObjectCaches {
+        ObjectCache<vk::raii::ShaderModule> shaderModules;
+        ObjectCache<vk::raii::RenderPass> renderPasses;
+        ObjectCache<vk::raii::Framebuffer> framebuffers;
+        ObjectCache<vk::raii::PipelineLayout> pipelineLayouts;
+        ObjectCache<AsyncPipeline> pipelines;
+    };
+
+    // The Vulkan objects are shared with every other pipeline created from identical state
     struct RenderPipeline {
         RenderPipelineInfo info;
-        vk::raii::RenderPass renderPass;
-        vk::raii::Framebuffer framebuffer;
-        vk::raii::PipelineLayout pipelineLayout;
-        vk::raii::Pipeline pipeline;
+        std::shared_ptr<const vk::raii::RenderPass> renderPass;
+        std::shared_ptr<const vk::raii::Framebuffer> framebuffer;
+        std::shared_ptr<const vk::raii::PipelineLayout> pipelineLayout;
+        std::vector<std::shared_ptr<const vk::raii::ShaderModule>> shaderModules;
+        std::shared_ptr<const AsyncPipeline> pipeline;
     };
 
     class RenderPipelinePool : public ResourcePool<RenderPipeline, RenderPipelineInfo> {
     public:
+        explicit RenderPipelinePool(PipelineObjectCaches& caches) : m_caches(caches) {}
+
         ResourceRef create(const RenderPipelineInfo& info) override;
+        // Everything but the framebuffer, which leaves info and framebuffer empty. Pipelines later created from the
+        // same state share the objects while they're alive.
+        RenderPipeline compile(const RenderPipelineStateInfo& info);
+        // Viewport and scissor are dynamic, so only the framebuffer depends on the extent. Returns the old one.
+        std::shared_ptr<const vk::raii::Framebuffer> resizeFramebuffer(ResourceRef ref, vk::Extent2D extent);
+    private:
+        PipelineObjectCaches& m_caches;
     };
 
     struct ComputePipelineInfo {
         std::vector<ResourceRef> descriptorSetLayouts;
+        std::vector<vk::PushConstantRange> pushConstantRanges;
         std::string computeShaderPath;
     };
 
     struct ComputePipeline {
         ComputePipelineInfo info;
-        vk::raii::PipelineLayout pipelineLayout;
-        vk::raii::Pipeline pipeline;
+        std::shared_ptr<const vk::raii::PipelineLayout> pipelineLayout;
+        std::shared_ptr<const vk::raii::ShaderModule> shaderModule;
+        std::shared_ptr<const AsyncPipeline> pipeline;
     };
 
     class ComputePipelinePool : public ResourcePool<ComputePipeline, ComputePipelineInfo> {
     public:
+        explicit ComputePipelinePool(PipelineObjectCaches& caches) : m_caches(caches) {}
+
         ResourceRef create(const ComputePipelineInfo& info) override;
+    private:
+        PipelineObjectCaches& m_caches;
     };
 
     class ResourceManager {
     public:
-        [[nodiscard]] inline ResourceRef createImage(const ImageInfo& info) { return m_imagePool.create(info); }
-        [[nodiscard]] inline ResourceRef createBuffer(const BufferInfo& info) { return m_bufferPool.create(info); }
+        ResourceManager();
+
+        [[nodiscard]] inline ResourceRef createImage(const ImageInfo& info) { ResourceRef ref = m_imagePool.create(info); return track(ref, m_imagePool.get(ref)); }
+        [[nodiscard]] inline ResourceRef createMemory(const MemoryInfo& info) { ResourceRef ref = m_memoryPool.create(info); return track(ref, m_memoryPool.get(ref)); }
+        [[nodiscard]] inline ResourceRef createBuffer(const BufferInfo& info) { ResourceRef ref = m_bufferPool.create(info); return track(ref, m_bufferPool.get(ref)); }
         [[nodiscard]] inline ResourceRef createSampler(const SamplerInfo& info) { return m_samplerPool.create(info); }
         [[nodiscard]] inline ResourceRef createDescriptorSetLayout(const DescriptorSetLayoutInfo& info) { return m_descriptorSetLayoutPool.create(info); }
         [[nodiscard]] inline ResourceRef createDescriptorSet(const DescriptorSetInfo& info) { return m_descriptorSetPool.create(info); }
+        [[nodiscard]] inline std::vector<ResourceRef> createDescriptorSets(const DescriptorSetInfo& info, uint32_t count) { return m_descriptorSetPool.create(info, count); }
         [[nodiscard]] inline ResourceRef createRenderPipeline(const RenderPipelineInfo& info) { return m_renderPipelinePool.create(info); }
         [[nodiscard]] inline ResourceRef createComputePipeline(const ComputePipelineInfo& info) { return m_computePipelinePool.create(info); }
 
+        inline void resizeBuffer(ResourceRef ref, size_t size) { retire(untrack(m_bufferPool.resize(ref, size))); track(ref, m_bufferPool.get(ref)); }
+        // The replaced objects may still be used by frames in flight, they are retired instead of destroyed
+        inline void resizeImage(ResourceRef ref, uint32_t width, uint32_t height) { retire(untrack(m_imagePool.resize(ref, width, height))); track(ref, m_imagePool.get(ref)); }
+        inline void resizeMemory(ResourceRef ref, const vk::MemoryRequirements& requirements) { retire(untrack(m_memoryPool.resize(ref, requirements))); track(ref, m_memoryPool.get(ref)); }
+        inline void resizeFramebuffer(ResourceRef ref, vk::Extent2D extent) { retire(m_renderPipelinePool.resizeFramebuffer(ref, extent)); }
+
+        // Keeps a resource alive until every frame which could still be using it has finished
+        template <typename T>
+        void retire(T&& resource) {
+            m_retiredResources.push_back(RetiredResource{ m_frame, std::make_shared<T>(std::move(resource)) });
+        }
+        // Called once the next frame's fence has been waited on
+        void nextFrame() {
+            m_frame++;
+            // VMA only re-reads the driver's budgets when the frame index changes
+            vmaSetCurrentFrameIndex(*Vulkan::getAllocator(), static_cast<uint32_t>(m_frame));
+            m_memoryBudget.update();
+            if(m_bindlessDescriptors.has_value())
+                m_bindlessDescriptors->nextFrame();
+            std::erase_if(m_retiredResources, [&](const RetiredResource& retired) { return retired.frame + FRAMES_IN_FLIGHT <= m_frame; });
+        }
         inline void updateDescriptorSet(ResourceRef ref, const std::vector<DescriptorSetWrite>& writes) const { m_descriptorSetPool.update(ref, writes); }
+        static inline void cmdPushDescriptorSet(vk::CommandBuffer cmd, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t set,
+                                                const std::vector<DescriptorSetWrite>& writes) {
+            DescriptorSetPool::cmdUpdate(cmd, bindPoint, pipelineLayout, set, writes);
+        }
+
+        // Pipelines are compiled here, creating one only queues the compilation
+        [[nodiscard]] inline ThreadPool& getPipelineCompiler() { return m_pipelineCompiler; }
+        // Blocks until every queued pipeline has compiled
+        inline void waitForPipelines() { m_pipelineCompiler.wait(); }
+        // Queues the pipelines' compilation across the worker threads right away, e.g. every pass a scene may use at
+        // startup, before any of its images exist. They're kept until released, so pipelines later created from
+        // identical state share them. The set layouts are only needed for the duration of the call.
+        void prewarmPipelines(const std::vector<RenderPipelineStateInfo>& renderPipelines, const std::vector<ComputePipelineInfo>& computePipelines);
+        void releasePrewarmedPipelines();
+
+        // The reference is invalid right away, the objects behind it are kept until the frames in flight are done
+        inline void destroyImage(ResourceRef ref) { retire(untrack(m_imagePool.destroy(ref))); }
+        inline void destroyMemory(ResourceRef ref) { retire(untrack(m_memoryPool.destroy(ref))); }
+        inline void destroyBuffer(ResourceRef ref) { retire(untrack(m_bufferPool.destroy(ref))); }
+        inline void destroySampler(ResourceRef ref) { if(auto sampler = m_samplerPool.release(ref)) retire(std::move(*sampler)); }
+        inline void destroyDescriptorSetLayout(ResourceRef ref) { retire(m_descriptorSetLayoutPool.destroy(ref)); }
+        inline void destroyDescriptorSet(ResourceRef ref) { retire(m_descriptorSetPool.destroy(ref)); }
+        inline void destroyRenderPipeline(ResourceRef ref) { retire(m_renderPipelinePool.destroy(ref)); }
+        inline void destroyComputePipeline(ResourceRef ref) { retire(m_computePipelinePool.destroy(ref)); }
+
+        // Created on first use, throws when the device doesn't support descriptor indexing
+        [[nodiscard]] inline BindlessDescriptors& getBindlessDescriptors() {
+            if(!m_bindlessDescriptors.has_value())
+                m_bindlessDescriptors.emplace(m_descriptorSetLayoutPool);
+            return *m_bindlessDescriptors;
+        }
 
-        inline void destroyImage(ResourceRef ref) { m_imagePool.destroy(ref); }
-        inline void destroyBuffer(ResourceRef ref) { m_bufferPool.destroy(ref); }
-        inline void destroySampler(ResourceRef ref) { m_samplerPool.destroy(ref); }
-        inline void destroyDescriptorSetLayout(ResourceRef ref) { m_descriptorSetLayoutPool.destroy(ref); }
-        inline void destroyDescriptorSet(ResourceRef ref) { m_descriptorSetPool.destroy(ref); }
-        inline void destroyRenderPipeline(ResourceRef ref) { m_renderPipelinePool.destroy(ref); }
-        inline void destroyComputePipeline(ResourceRef ref) { m_computePipelinePool.destroy(ref); }
+        // Bytes are accounted when resources are created and released when they are destroyed, before the retired
+        // objects are actually freed
+        [[nodiscard]] inline MemoryBudget& getMemoryBudget() { return m_memoryBudget; }
+
+        [[nodiscard]] inline bool isDescriptorSetValid(ResourceRef ref) const { return m_descriptorSetPool.isValid(ref); }
+        [[nodiscard]] inline bool isBufferValid(ResourceRef ref) const { return m_bufferPool.isValid(ref); }
+        [[nodiscard]] inline bool isImageValid(ResourceRef ref) const { return m_imagePool.isValid(ref); }
 
         [[nodiscard]] inline const Image& getImage(ResourceRef ref) const { return m_imagePool.get(ref); }
+        [[nodiscard]] inline const Memory& getMemory(ResourceRef ref) const { return m_memoryPool.get(ref); }
         [[nodiscard]] inline const Buffer& getBuffer(ResourceRef ref) const { return m_bufferPool.get(ref); }
         [[nodiscard]] inline const Sampler& getSampler(ResourceRef ref) const { return m_samplerPool.get(ref); }
         [[nodiscard]] inline const DescriptorSetLayout& getDescriptorSetLayout(ResourceRef ref) const { return m_descriptorSetLayoutPool.get(ref); }
@@ -230,12 +525,49 @@ namespace vanguard {
         [[nodiscard]] inline const RenderPipeline& getRenderPipeline(ResourceRef ref) const { return m_renderPipelinePool.get(ref); }
         [[nodiscard]] inline const ComputePipeline& getComputePipeline(ResourceRef ref) const { return m_computePipelinePool.get(ref); }
     private:
+        static MemoryCategory getMemoryCategory(const Image&) { return MemoryCategory::Image; }
+        static MemoryCategory getMemoryCategory(const Buffer&) { return MemoryCategory::Buffer; }
+        static MemoryCategory getMemoryCategory(const Memory&) { return MemoryCategory::Memory; }
+
+        // Resources bound into shared memory have no allocation of their own and account for 0 bytes
+        template <typename T>
+        ResourceRef track(ResourceRef ref, const T& resource) {
+            m_memoryBudget.add(getMemoryCategory(resource), resource.info.name, resource.allocation.allocationInfo.size);
+            return ref;
+        }
+        template <typename T>
+        T untrack(T&& resource) {
+            m_memoryBudget.remove(getMemoryCategory(resource), resource.info.name, resource.allocation.allocationInfo.size);
+            return std::move(resource);
+        }
+
+        struct RetiredResource {
+            uint64_t frame;
+            std::shared_ptr<void> resource;
+        };
+
+        // Before the pools, so it's destroyed after every set has been freed
+        DescriptorAllocator m_descriptorAllocator;
+
         ImagePool m_imagePool;
+        MemoryPool m_memoryPool;
         BufferPool m_bufferPool;
         SamplerPool m_samplerPool;
         DescriptorSetLayoutPool m_descriptorSetLayoutPool;
         DescriptorSetPool m_descriptorSetPool;
+        // Before the pipeline pools which create through it
+        PipelineObjectCaches m_objectCaches;
         RenderPipelinePool m_renderPipelinePool;
         ComputePipelinePool m_computePipelinePool;
+        std::optional<BindlessDescriptors> m_bindlessDescriptors;
+        MemoryBudget m_memoryBudget;
+
+        uint64_t m_frame = 0;
+        std::vector<RetiredResource> m_retiredResources;
+        std::vector<RenderPipeline> m_prewarmedRenderPipelines;
+        std::vector<ResourceRef> m_prewarmedComputePipelines;
+
+        // Last so it's joined before the pools are destroyed
+        ThreadPool m_pipelineCompiler;
     };
 }
\ No newline at end of file
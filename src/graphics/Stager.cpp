@@ -1,39 +1,94 @@
 #include "Stager.h"
 #include "../Application.h"
 
+#include <algorithm>
+#include <tuple>
+
 namespace vanguard {
-    void Stager::createStagingBuffer(uint32_t size) {
+    void Stager::init(vk::DeviceSize ringSize) {
+        m_segmentSize = ringSize / FRAMES_IN_FLIGHT_PLUS_ONE / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        m_ring = createStagingBuffer(m_segmentSize * FRAMES_IN_FLIGHT_PLUS_ONE);
+        m_ringData = static_cast<char*>(RENDER_SYSTEM.getResourceManager().getBuffer(m_ring).allocation.allocationInfo.pMappedData);
+        for (uint32_t i = 0; i < m_segments.size(); i++)
+            m_segments[i].offset = i * m_segmentSize;
+    }
+
+    ResourceRef Stager::createStagingBuffer(vk::DeviceSize size, const std::string& name) {
         BufferInfo info{};
         info.size = size;
         info.usage = vk::BufferUsageFlagBits::eTransferSrc;
         info.memoryUsage = VMA_MEMORY_USAGE_AUTO;
         info.memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
         info.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
-        auto stagingBuffer = RENDER_SYSTEM.getResourceManager().createBuffer(info);
-        m_stagingBuffers.push_back(stagingBuffer);
+        info.name = name;
+        return RENDER_SYSTEM.getResourceManager().createBuffer(info);
     }
 
-    void Stager::updateBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data) {
-        auto [stagingBufferRef, stagingOffset] = findStagingBuffer(size);
-
-        auto& stagingBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(stagingBufferRef);
-        void* mappedData = nullptr;
-        vmaMapMemory(*Vulkan::getAllocator(), stagingBuffer.allocation.allocation, &mappedData);
-        void* stagingDst = static_cast<char*>(mappedData) + stagingOffset;
-        memcpy(stagingDst, data, size);
-        vmaUnmapMemory(*Vulkan::getAllocator(), stagingBuffer.allocation.allocation);
-        m_jobs.push_back(CopyJob{
-            .stagingBuffer = stagingBufferRef,
+    std::pair<ResourceRef, uint32_t> Stager::stage(uint32_t size, const void* data) {
+        auto& segment = m_segments[m_currentSegment];
+        vk::DeviceSize offset = (segment.pointer + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        if(offset + size <= m_segmentSize) {
+            segment.pointer = offset + size;
+            memcpy(m_ringData + segment.offset + offset, data, size);
+            return { m_ring, static_cast<uint32_t>(segment.offset + offset) };
+        }
+
+        // Overflow, large one off uploads such as textures usually end up here
+        ResourceRef buffer = createStagingBuffer(size);
+        segment.overflowBuffers.push_back(buffer);
+        memcpy(RENDER_SYSTEM.getResourceManager().getBuffer(buffer).allocation.allocationInfo.pMappedData, data, size);
+        return { buffer, 0 };
+    }
+
+    void Stager::addJob(const CopyJob& job) {
+        // Keep only the parts of earlier writes outside the new one, so the last write to a range wins. Pending ranges
+        // of a buffer never overlap, so only the one starting before the new range can reach into it.
+        auto& jobs = m_jobs[job.dstBuffer];
+        uint32_t end = job.dstOffset + job.size;
+        auto it = jobs.lower_bound(job.dstOffset);
+        if(it != jobs.begin()) {
+            auto previous = std::prev(it);
+            if(previous->second.job.dstOffset + previous->second.job.size > job.dstOffset)
+                it = previous;
+        }
+        std::vector<PendingJob> remainders;
+        while(it != jobs.end() && it->first < end) {
+            const CopyJob& other = it->second.job;
+            uint32_t otherEnd = other.dstOffset + other.size;
+            if(other.dstOffset < job.dstOffset) {
+                CopyJob before = other;
+                before.size = job.dstOffset - other.dstOffset;
+                remainders.push_back(PendingJob{ it->second.sequence, before });
+            }
+            if(otherEnd > end) {
+                CopyJob after = other;
+                after.stagingOffset = other.stagingOffset + (end - other.dstOffset);
+                after.dstOffset = end;
+                after.size = otherEnd - end;
+                remainders.push_back(PendingJob{ it->second.sequence, after });
+            }
+            it = jobs.erase(it);
+        }
+        for (const PendingJob& remainder: remainders)
+            jobs.emplace(remainder.job.dstOffset, remainder);
+        jobs.emplace(job.dstOffset, PendingJob{ m_nextJobSequence++, job });
+    }
+
+    void Stager::updateBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data, uint32_t priority) {
+        auto [stagingBuffer, stagingOffset] = stage(size, data);
+        addJob(CopyJob{
+            .stagingBuffer = stagingBuffer,
             .dstBuffer = buffer,
             .stagingOffset = stagingOffset,
             .dstOffset = offset,
-            .size = size
+            .size = size,
+            .priority = priority
         });
     }
 
     void Stager::copyBuffer(vanguard::ResourceRef srcBuffer, vanguard::ResourceRef dstBuffer, uint32_t srcOffset,
                             uint32_t dstOffset, uint32_t size) {
-        m_jobs.push_back(CopyJob{
+        addJob(CopyJob{
             .stagingBuffer = srcBuffer,
             .dstBuffer = dstBuffer,
             .stagingOffset = srcOffset,
@@ -42,43 +97,114 @@ namespace vanguard {
         });
     }
 
-    void Stager::updateImage(vanguard::ResourceRef image, vk::ImageLayout currentLayout, uint32_t size, const void* data, uint32_t arrayLayer) {
+    void Stager::updateImage(vanguard::ResourceRef image, vk::ImageLayout currentLayout, uint32_t size, const void* data, uint32_t arrayLayer,
+                             uint32_t priority) {
         auto& imageInfo = RENDER_SYSTEM.getResourceManager().getImage(image).info;
-        auto [stagingBufferRef, stagingOffset] = findStagingBuffer(size);
-
-        auto& stagingBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(stagingBufferRef);
-        void* mappedData = nullptr;
-        vmaMapMemory(*Vulkan::getAllocator(), stagingBuffer.allocation.allocation, &mappedData);
-        void* stagingDst = static_cast<char*>(mappedData) + stagingOffset;
-        memcpy(stagingDst, data, size);
-        vmaUnmapMemory(*Vulkan::getAllocator(), stagingBuffer.allocation.allocation);
+        auto [stagingBuffer, stagingOffset] = stage(size, data);
 
+        // Layers are always written whole
+        std::erase_if(m_imageJobs, [&](const ImageCopyJob& job) { return job.dstImage == image && job.arrayLayer == arrayLayer; });
         m_imageJobs.push_back(ImageCopyJob{
-            .stagingBuffer = stagingBufferRef,
+            .stagingBuffer = stagingBuffer,
             .dstImage = image,
             .currentLayout = currentLayout,
             .stagingOffset = stagingOffset,
             .width = imageInfo.width,
             .height = imageInfo.height,
-            .arrayLayer = arrayLayer
+            .arrayLayer = arrayLayer,
+            .size = size,
+            .priority = priority
         });
     }
 
     void Stager::bakeCommands(vk::CommandBuffer commandBuffer) {
-        std::vector<vk::ImageMemoryBarrier> preBarriers;
-        std::unordered_set<ResourceRef> visitedImages;
+        auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+        m_stats = {};
+
+        // Deferred jobs may have outlived their destination
+        std::erase_if(m_jobs, [&](const auto& entry) { return !resourceManager.isBufferValid(entry.first); });
+        std::erase_if(m_imageJobs, [&](const ImageCopyJob& job) { return !resourceManager.isImageValid(job.dstImage); });
+
+        // Back in request order, so equal priorities are copied first come first served
+        std::vector<PendingJob> pendingJobs;
+        for (const auto& [buffer, jobs]: m_jobs) {
+            for (const auto& [offset, pending]: jobs)
+                pendingJobs.push_back(pending);
+        }
+        m_jobs.clear();
+        std::sort(pendingJobs.begin(), pendingJobs.end(), [](const PendingJob& a, const PendingJob& b) { return a.sequence < b.sequence; });
+
+        // Pick what's copied this frame. The layers of an image go together, as the whole image is transitioned.
+        struct Candidate {
+            uint32_t priority;
+            vk::DeviceSize bytes;
+            uint32_t jobs;
+            // Index into pendingJobs, or the image
+            uint32_t job;
+            ResourceRef image;
+        };
+        std::vector<Candidate> candidates;
+        for (uint32_t i = 0; i < pendingJobs.size(); i++) {
+            const CopyJob& job = pendingJobs[i].job;
+            candidates.push_back(Candidate{ .priority = job.priority, .bytes = job.size, .jobs = 1, .job = i, .image = UNDEFINED_RESOURCE });
+        }
         for (const auto& job: m_imageJobs) {
-            if (visitedImages.find(job.dstImage) != visitedImages.end()) {
+            auto it = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& candidate) { return candidate.image == job.dstImage; });
+            if(it == candidates.end()) {
+                candidates.push_back(Candidate{ .priority = job.priority, .bytes = job.size, .jobs = 1, .job = 0, .image = job.dstImage });
+                continue;
+            }
+            it->priority = std::max(it->priority, job.priority);
+            it->bytes += job.size;
+            it->jobs++;
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+        std::vector<bool> copyJob(pendingJobs.size(), false);
+        std::vector<ResourceRef> copyImages;
+        // Immediate uploads count against the budget, but only budgeted ones decide whether the first job still fits
+        vk::DeviceSize budgetUsed = 0;
+        vk::DeviceSize budgetedBytes = 0;
+        for (const auto& candidate: candidates) {
+            bool immediate = candidate.priority == UPLOAD_PRIORITY_IMMEDIATE;
+            bool fits = m_uploadBudget == 0 || immediate || budgetedBytes == 0 || budgetUsed + candidate.bytes <= m_uploadBudget;
+            if(!fits) {
+                m_stats.deferredJobs += candidate.jobs;
+                m_stats.deferredBytes += candidate.bytes;
                 continue;
             }
-            visitedImages.insert(job.dstImage);
-
-            auto& dstImage = RENDER_SYSTEM.getResourceManager().getImage(job.dstImage);
-            preBarriers.push_back(vk::ImageMemoryBarrier{
-                .srcAccessMask = vk::AccessFlagBits::eNone,
-                .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
-                .oldLayout = job.currentLayout,
-                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+            budgetUsed += candidate.bytes;
+            if(!immediate)
+                budgetedBytes += candidate.bytes;
+            if(candidate.image == UNDEFINED_RESOURCE)
+                copyJob[candidate.job] = true;
+            else
+                copyImages.push_back(candidate.image);
+        }
+
+        std::vector<CopyJob> jobs;
+        for (uint32_t i = 0; i < pendingJobs.size(); i++) {
+            const PendingJob& pending = pendingJobs[i];
+            if(copyJob[i])
+                jobs.push_back(pending.job);
+            else
+                m_jobs[pending.job.dstBuffer].emplace(pending.job.dstOffset, pending);
+        }
+        std::vector<ImageCopyJob> imageJobs;
+        std::vector<ImageCopyJob> deferredImageJobs;
+        for (const auto& job: m_imageJobs) {
+            bool copied = std::find(copyImages.begin(), copyImages.end(), job.dstImage) != copyImages.end();
+            (copied ? imageJobs : deferredImageJobs).push_back(job);
+        }
+        m_imageJobs = std::move(deferredImageJobs);
+
+        auto imageBarrier = [&](ResourceRef ref, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess) {
+            auto& dstImage = resourceManager.getImage(ref);
+            return vk::ImageMemoryBarrier{
+                .srcAccessMask = srcAccess,
+                .dstAccessMask = dstAccess,
+                .oldLayout = oldLayout,
+                .newLayout = newLayout,
                 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                 .image = *dstImage.image,
@@ -89,22 +215,49 @@ namespace vanguard {
                     .baseArrayLayer = 0,
                     .layerCount = dstImage.info.arrayLayers
                 }
-            });
+            };
+        };
+
+        std::vector<vk::ImageMemoryBarrier> preBarriers;
+        for (ResourceRef image: copyImages) {
+            auto job = std::find_if(imageJobs.begin(), imageJobs.end(), [&](const ImageCopyJob& job) { return job.dstImage == image; });
+            preBarriers.push_back(imageBarrier(image, job->currentLayout, vk::ImageLayout::eTransferDstOptimal,
+                                               vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite));
         }
-        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, preBarriers);
+        if(!preBarriers.empty())
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, preBarriers);
 
-        for(auto& job : m_jobs) {
-            auto& stagingBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(job.stagingBuffer);
-            auto& dstBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(job.dstBuffer);
-            vk::BufferCopy copyRegion{};
-            copyRegion.srcOffset = job.stagingOffset;
-            copyRegion.dstOffset = job.dstOffset;
-            copyRegion.size = job.size;
-            commandBuffer.copyBuffer(*stagingBuffer.buffer, *dstBuffer.buffer, copyRegion);
+        // One multi-region copy per source and destination, ranges contiguous in both are merged into one region
+        std::sort(jobs.begin(), jobs.end(), [](const CopyJob& a, const CopyJob& b) {
+            return std::tie(a.stagingBuffer, a.dstBuffer, a.stagingOffset) < std::tie(b.stagingBuffer, b.dstBuffer, b.stagingOffset);
+        });
+        std::vector<vk::BufferCopy> regions;
+        for (uint32_t i = 0; i < jobs.size(); i++) {
+            const auto& job = jobs[i];
+            m_stats.bytes += job.size;
+            auto* last = regions.empty() ? nullptr : &regions.back();
+            if(last && last->srcOffset + last->size == job.stagingOffset && last->dstOffset + last->size == job.dstOffset) {
+                last->size += job.size;
+            } else {
+                regions.push_back(vk::BufferCopy{ .srcOffset = job.stagingOffset, .dstOffset = job.dstOffset, .size = job.size });
+            }
+
+            bool groupEnds = i + 1 == jobs.size() || jobs[i + 1].stagingBuffer != job.stagingBuffer || jobs[i + 1].dstBuffer != job.dstBuffer;
+            if(groupEnds) {
+                commandBuffer.copyBuffer(*resourceManager.getBuffer(job.stagingBuffer).buffer, *resourceManager.getBuffer(job.dstBuffer).buffer, regions);
+                m_stats.copies++;
+                m_stats.regions += static_cast<uint32_t>(regions.size());
+                regions.clear();
+            }
         }
-        for (const auto& job: m_imageJobs) {
-            auto& stagingBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(job.stagingBuffer);
-            auto& dstImage = RENDER_SYSTEM.getResourceManager().getImage(job.dstImage);
+
+        std::sort(imageJobs.begin(), imageJobs.end(), [](const ImageCopyJob& a, const ImageCopyJob& b) {
+            return std::tie(a.stagingBuffer, a.dstImage, a.arrayLayer) < std::tie(b.stagingBuffer, b.dstImage, b.arrayLayer);
+        });
+        std::vector<vk::BufferImageCopy> imageRegions;
+        for (uint32_t i = 0; i < imageJobs.size(); i++) {
+            const auto& job = imageJobs[i];
+            m_stats.bytes += job.size;
             vk::BufferImageCopy copyRegion{};
             copyRegion.bufferOffset = job.stagingOffset;
             copyRegion.bufferRowLength = 0;
@@ -117,77 +270,79 @@ namespace vanguard {
 
             copyRegion.imageOffset = vk::Offset3D{0, 0, 0};
             copyRegion.imageExtent = vk::Extent3D{job.width, job.height, 1};
-            commandBuffer.copyBufferToImage(*stagingBuffer.buffer, *dstImage.image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+            imageRegions.push_back(copyRegion);
+
+            bool groupEnds = i + 1 == imageJobs.size() || imageJobs[i + 1].stagingBuffer != job.stagingBuffer || imageJobs[i + 1].dstImage != job.dstImage;
+            if(groupEnds) {
+                commandBuffer.copyBufferToImage(*resourceManager.getBuffer(job.stagingBuffer).buffer, *resourceManager.getImage(job.dstImage).image,
+                                                vk::ImageLayout::eTransferDstOptimal, imageRegions);
+                m_stats.copies++;
+                m_stats.regions += static_cast<uint32_t>(imageRegions.size());
+                imageRegions.clear();
+            }
         }
+
+        // One barrier per destination buffer, covering everything written to it
         std::vector<vk::BufferMemoryBarrier> barriers;
-        std::vector<vk::ImageMemoryBarrier> postImageBarriers;
-        for(auto& job : m_jobs) {
-            auto& dstBuffer = RENDER_SYSTEM.getResourceManager().getBuffer(job.dstBuffer);
-            vk::BufferMemoryBarrier barrier{};
-            barrier.buffer = *dstBuffer.buffer;
-            barrier.offset = job.dstOffset;
-            barrier.size = job.size;
-            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-            barriers.push_back(barrier);
-        }
-
-        visitedImages.clear();
-        for (const auto& job: m_imageJobs) {
-            if (visitedImages.find(job.dstImage) != visitedImages.end()) {
+        std::vector<ResourceRef> barrierBuffers;
+        for (const auto& job: jobs) {
+            auto it = std::find(barrierBuffers.begin(), barrierBuffers.end(), job.dstBuffer);
+            if(it == barrierBuffers.end()) {
+                barrierBuffers.push_back(job.dstBuffer);
+                vk::BufferMemoryBarrier barrier{};
+                barrier.buffer = *resourceManager.getBuffer(job.dstBuffer).buffer;
+                barrier.offset = job.dstOffset;
+                barrier.size = job.size;
+                barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+                barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+                barriers.push_back(barrier);
                 continue;
             }
-            visitedImages.insert(job.dstImage);
-
-            auto& dstImage = RENDER_SYSTEM.getResourceManager().getImage(job.dstImage);
-            postImageBarriers.push_back(vk::ImageMemoryBarrier{
-                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
-                .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
-                .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .image = *dstImage.image,
-                .subresourceRange = vk::ImageSubresourceRange{
-                    .aspectMask = vk::ImageAspectFlagBits::eColor,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = dstImage.info.arrayLayers
-                }
-            });
+            auto& barrier = barriers[it - barrierBuffers.begin()];
+            vk::DeviceSize end = std::max(barrier.offset + barrier.size, static_cast<vk::DeviceSize>(job.dstOffset) + job.size);
+            barrier.offset = std::min(barrier.offset, static_cast<vk::DeviceSize>(job.dstOffset));
+            barrier.size = end - barrier.offset;
+        }
+
+        std::vector<vk::ImageMemoryBarrier> postImageBarriers;
+        for (ResourceRef image: copyImages) {
+            postImageBarriers.push_back(imageBarrier(image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                                     vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
         }
-        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllGraphics, {}, nullptr, barriers, postImageBarriers);
+        if(!barriers.empty() || !postImageBarriers.empty())
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllGraphics | vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, barriers, postImageBarriers);
     }
 
-    void Stager::flush() {
-        m_jobs.clear();
-        m_imageJobs.clear();
-        m_stagingBufferPointers.clear();
+    void Stager::restage(ResourceRef& stagingBuffer, uint32_t& stagingOffset, uint32_t size, Segment& previousSegment) {
+        if(stagingBuffer == m_ring) {
+            std::tie(stagingBuffer, stagingOffset) = stage(size, m_ringData + stagingOffset);
+            return;
+        }
+        // Overflow buffers are handed over to the current segment instead of being copied
+        auto& segment = m_segments[m_currentSegment];
+        std::erase(previousSegment.overflowBuffers, stagingBuffer);
+        if(std::find(segment.overflowBuffers.begin(), segment.overflowBuffers.end(), stagingBuffer) == segment.overflowBuffers.end())
+            segment.overflowBuffers.push_back(stagingBuffer);
     }
 
-    std::pair<ResourceRef, uint32_t> Stager::findStagingBuffer(uint32_t size) {
-        ResourceRef stagingBufferRef = UNDEFINED_RESOURCE;
-        uint32_t stagingOffset = 0;
-
-        for(ResourceRef reference : m_stagingBuffers) {
-            auto& buf = RENDER_SYSTEM.getResourceManager().getBuffer(reference);
-            auto& stagingBufferPointer = m_stagingBufferPointers[reference];
-            if(stagingBufferPointer + size < buf.info.size) {
-                stagingBufferRef = reference;
-                stagingOffset = stagingBufferPointer;
-                stagingBufferPointer += size;
-                break;
-            }
+    // The next segment was last used FRAMES_IN_FLIGHT_PLUS_ONE submissions ago. The fence waited on before this
+    // submission covers the one FRAMES_IN_FLIGHT before it, so that segment's copies have finished. Deferred jobs
+    // move along into the next segment, their data is still intact in the previous one.
+    void Stager::flush() {
+        auto& previousSegment = m_segments[m_currentSegment];
+        m_currentSegment = (m_currentSegment + 1) % FRAMES_IN_FLIGHT_PLUS_ONE;
+        auto& segment = m_segments[m_currentSegment];
+        segment.pointer = 0;
+        for (ResourceRef buffer: segment.overflowBuffers)
+            RENDER_SYSTEM.getResourceManager().destroyBuffer(buffer);
+        segment.overflowBuffers.clear();
 
+        // Only staged uploads can be deferred, copies between buffers are always immediate
+        for (auto& [buffer, jobs]: m_jobs) {
+            for (auto& [offset, pending]: jobs)
+                restage(pending.job.stagingBuffer, pending.job.stagingOffset, pending.job.size, previousSegment);
         }
-        if(stagingBufferRef == UNDEFINED_RESOURCE) {
-            createStagingBuffer(size);
-            stagingBufferRef = m_stagingBuffers.back();
-            stagingOffset = 0;
-            m_stagingBufferPointers[stagingBufferRef] = size;
-        }
-
-        return {stagingBufferRef, stagingOffset};
+        for (auto& job: m_imageJobs)
+            restage(job.stagingBuffer, job.stagingOffset, job.size, previousSegment);
     }
-}
+}
\ No newline at end of file
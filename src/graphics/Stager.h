@@ -2,15 +2,24 @@
 
 #include "ResourceManager.h"
 
+#include <array>
+#include <map>
 #include <unordered_map>
 
 namespace vanguard {
+    // Uploads with this priority are always copied in the frame they were requested in, regardless of the budget
+    constexpr uint32_t UPLOAD_PRIORITY_IMMEDIATE = UINT32_MAX;
+    // Copy offsets into images have to be a multiple of 4 and of the texel size, which holds for every power of two
+    // texel size up to 16
+    constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+
     struct CopyJob {
         ResourceRef stagingBuffer;
         ResourceRef dstBuffer;
         uint32_t stagingOffset;
         uint32_t dstOffset;
         uint32_t size;
+        uint32_t priority = UPLOAD_PRIORITY_IMMEDIATE;
     };
 
     struct ImageCopyJob {
@@ -21,8 +30,29 @@ namespace vanguard {
         uint32_t width = 0;
         uint32_t height = 0;
         uint32_t arrayLayer = 0;
+        uint32_t size = 0;
+        uint32_t priority = UPLOAD_PRIORITY_IMMEDIATE;
+    };
+
+    // Counters of the last baked frame
+    struct StagerStats {
+        // vkCmdCopyBuffer and vkCmdCopyBufferToImage calls, and the regions they copy
+        uint32_t copies = 0;
+        uint32_t regions = 0;
+        vk::DeviceSize bytes = 0;
+        // Jobs carried over to the next frame because of the budget
+        uint32_t deferredJobs = 0;
+        vk::DeviceSize deferredBytes = 0;
     };
 
+    // Uploads are copied into a persistently mapped ring buffer, split into FRAMES_IN_FLIGHT_PLUS_ONE segments. The
+    // uploads of one submission share a segment, which is only reused once that submission's fence has signaled. An
+    // upload which doesn't fit into what's left of the segment gets its own staging buffer, freed with the segment.
+    //
+    // Writes to a buffer range replace the parts of earlier, not yet copied writes they overlap, so the destination
+    // ranges of pending jobs never overlap. Jobs are baked into one multi-region copy per source and destination, with
+    // contiguous ranges merged. With an upload budget jobs below UPLOAD_PRIORITY_IMMEDIATE are copied highest priority
+    // first until the budget is used up, the rest are carried over to later frames.
     class Stager {
     public:
         Stager() = default;
@@ -33,20 +63,57 @@ namespace vanguard {
         Stager(Stager&& other) = delete;
         Stager& operator=(Stager&& other) = delete;
 
-        void createStagingBuffer(uint32_t size);
-        void updateBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data);
+        void init(vk::DeviceSize ringSize = STAGING_RING_SIZE);
+
+        void updateBuffer(ResourceRef buffer, uint32_t offset, uint32_t size, const void* data, uint32_t priority = UPLOAD_PRIORITY_IMMEDIATE);
         void copyBuffer(ResourceRef srcBuffer, ResourceRef dstBuffer, uint32_t srcOffset, uint32_t dstOffset, uint32_t size);
 
-        void updateImage(ResourceRef image, vk::ImageLayout currentLayout, uint32_t size, const void* data, uint32_t arrayLayer = 0);
+        void updateImage(ResourceRef image, vk::ImageLayout currentLayout, uint32_t size, const void* data, uint32_t arrayLayer = 0,
+                         uint32_t priority = UPLOAD_PRIORITY_IMMEDIATE);
+
+        // Bytes copied per frame, 0 for no limit. At least one budgeted job is copied every frame so large ones still
+        // progress, even when immediate uploads have used up the budget.
+        void setUploadBudget(vk::DeviceSize bytes) { m_uploadBudget = bytes; }
+        [[nodiscard]] vk::DeviceSize getUploadBudget() const { return m_uploadBudget; }
+        [[nodiscard]] const StagerStats& getStats() const { return m_stats; }
+
+        // Persistently mapped, host coherent and only usable as a copy source. Shared with the async uploader's ring.
+        static ResourceRef createStagingBuffer(vk::DeviceSize size, const std::string& name = "staging buffer");
 
         void bakeCommands(vk::CommandBuffer commandBuffer);
+        // Called once the baked commands are submitted, moves on to the next segment
         void flush();
     private:
-        std::pair<ResourceRef, uint32_t> findStagingBuffer(uint32_t size);
+        struct Segment {
+            vk::DeviceSize offset = 0;
+            vk::DeviceSize pointer = 0;
+            std::vector<ResourceRef> overflowBuffers;
+        };
+        struct PendingJob {
+            // Request order, parts of a trimmed job keep the original's
+            uint64_t sequence;
+            CopyJob job;
+        };
+
+        void addJob(const CopyJob& job);
+        // Copies the data into staging memory, returns the staging buffer and the offset it was written to
+        std::pair<ResourceRef, uint32_t> stage(uint32_t size, const void* data);
+        // Moves a deferred job's staging data into the current segment
+        void restage(ResourceRef& stagingBuffer, uint32_t& stagingOffset, uint32_t size, Segment& previousSegment);
     private:
-        std::vector<ResourceRef> m_stagingBuffers;
-        std::unordered_map<ResourceRef, uint32_t> m_stagingBufferPointers;
-        std::vector<CopyJob> m_jobs;
+        ResourceRef m_ring = UNDEFINED_RESOURCE;
+        char* m_ringData = nullptr;
+        vk::DeviceSize m_segmentSize = 0;
+        std::array<Segment, FRAMES_IN_FLIGHT_PLUS_ONE> m_segments;
+        uint32_t m_currentSegment = 0;
+
+        // Per destination buffer, keyed by destination offset. After baking only the deferred jobs remain.
+        std::unordered_map<ResourceRef, std::map<uint32_t, PendingJob>> m_jobs;
+        uint64_t m_nextJobSequence = 0;
+        // In request order, after baking only the deferred jobs remain
         std::vector<ImageCopyJob> m_imageJobs;
+
+        vk::DeviceSize m_uploadBudget = 0;
+        StagerStats m_stats;
     };
-}
\ No newline at end of file
+}
@@ -8,6 +8,21 @@ namespace vanguard {
     class Texture {
     public:
         [[nodiscard]] virtual ResourceRef getImage() const = 0;
+        // Index into the bindless image array, BindlessDescriptors::INVALID_INDEX when bindless isn't supported
+        [[nodiscard]] virtual uint32_t getBindlessIndex() const = 0;
+        // Contents are uploaded asynchronously, the image mustn't be sampled before it's ready
+        [[nodiscard]] virtual UploadTicket getUploadTicket() const = 0;
+        [[nodiscard]] bool isReady() const { return RENDER_SYSTEM.getAsyncUploader().isComplete(getUploadTicket()); }
+    protected:
+        static uint32_t addBindlessImage(ResourceRef image) {
+            if(!Vulkan::isBindlessSupported())
+                return BindlessDescriptors::INVALID_INDEX;
+            return RENDER_SYSTEM.getResourceManager().getBindlessDescriptors().addImage(image);
+        }
+        static void removeBindlessImage(uint32_t index) {
+            if(index != BindlessDescriptors::INVALID_INDEX)
+                RENDER_SYSTEM.getResourceManager().getBindlessDescriptors().removeImage(index);
+        }
     };
 
     class Texture2D : public Texture {
@@ -18,17 +33,24 @@ namespace vanguard {
 
         Texture2D(Texture2D&& other) noexcept {
             m_image = other.m_image;
+            m_bindlessIndex = other.m_bindlessIndex;
+            m_uploadTicket = other.m_uploadTicket;
             other.m_image = UNDEFINED_RESOURCE;
+            other.m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
         }
 
         Texture2D& operator=(Texture2D&& other) noexcept {
             m_image = other.m_image;
+            m_bindlessIndex = other.m_bindlessIndex;
+            m_uploadTicket = other.m_uploadTicket;
             other.m_image = UNDEFINED_RESOURCE;
+            other.m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
             return *this;
         }
 
         ~Texture2D() {
             if(m_image != UNDEFINED_RESOURCE) {
+                removeBindlessImage(m_bindlessIndex);
                 RENDER_SYSTEM.getResourceManager().destroyImage(m_image);
             }
         }
@@ -48,13 +70,21 @@ namespace vanguard {
                 .aspect = vk::ImageAspectFlagBits::eColor,
                 .width = data.width,
                 .height = data.height,
+                .concurrent = true,
+                .asyncUpload = true,
+                .name = "texture",
             });
-            RENDER_SYSTEM.getStager().updateImage(m_image, vk::ImageLayout::eUndefined, data.data.size(), data.data.data());
+            m_uploadTicket = RENDER_SYSTEM.getAsyncUploader().uploadImage(m_image, data.data.size(), data.data.data());
+            m_bindlessIndex = addBindlessImage(m_image);
         }
 
         [[nodiscard]] ResourceRef getImage() const override { return m_image; }
+        [[nodiscard]] uint32_t getBindlessIndex() const override { return m_bindlessIndex; }
+        [[nodiscard]] UploadTicket getUploadTicket() const override { return m_uploadTicket; }
     private:
         ResourceRef m_image = UNDEFINED_RESOURCE;
+        uint32_t m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
+        UploadTicket m_uploadTicket{};
     };
 
     struct CubeMapTextureInfo {
@@ -77,17 +107,24 @@ namespace vanguard {
 
         CubeMapTexture(CubeMapTexture&& other) noexcept {
             m_image = other.m_image;
+            m_bindlessIndex = other.m_bindlessIndex;
+            m_uploadTicket = other.m_uploadTicket;
             other.m_image = UNDEFINED_RESOURCE;
+            other.m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
         }
 
         CubeMapTexture& operator=(CubeMapTexture&& other) noexcept {
             m_image = other.m_image;
+            m_bindlessIndex = other.m_bindlessIndex;
+            m_uploadTicket = other.m_uploadTicket;
             other.m_image = UNDEFINED_RESOURCE;
+            other.m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
             return *this;
         }
 
         ~CubeMapTexture() {
             if(m_image != UNDEFINED_RESOURCE) {
+                removeBindlessImage(m_bindlessIndex);
                 RENDER_SYSTEM.getResourceManager().destroyImage(m_image);
             }
         }
@@ -109,16 +146,24 @@ namespace vanguard {
                 .height = data.height,
                 .arrayLayers = 6,
                 .type = ImageType::Cube,
+                .concurrent = true,
+                .asyncUpload = true,
+                .name = "cube map texture",
             });
             auto faces = {&data.right, &data.left, &data.top, &data.bottom, &data.front, &data.back};
             auto vFaces = std::vector(faces.begin(), faces.end());
             for(int i = 0; i < 6; i++) {
-                RENDER_SYSTEM.getStager().updateImage(m_image, vk::ImageLayout::eUndefined, vFaces[i]->data.size(), vFaces[i]->data.data(), i);
+                m_uploadTicket = RENDER_SYSTEM.getAsyncUploader().uploadImage(m_image, vFaces[i]->data.size(), vFaces[i]->data.data(), i);
             }
+            m_bindlessIndex = addBindlessImage(m_image);
         }
 
         [[nodiscard]] ResourceRef getImage() const override { return m_image; }
+        [[nodiscard]] uint32_t getBindlessIndex() const override { return m_bindlessIndex; }
+        [[nodiscard]] UploadTicket getUploadTicket() const override { return m_uploadTicket; }
     private:
         ResourceRef m_image = UNDEFINED_RESOURCE;
+        uint32_t m_bindlessIndex = BindlessDescriptors::INVALID_INDEX;
+        UploadTicket m_uploadTicket{};
     };
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "TransientBufferAllocator.h"
+#include "../Application.h"
+
+namespace vanguard {
+    void TransientBufferAllocator::init(vk::DeviceSize frameSize) {
+        // Both alignments are powers of two, so the larger one satisfies both
+        m_alignment = std::max(Vulkan::padUniformBufferSize(1), Vulkan::padStorageBufferSize(1));
+        m_frameSize = static_cast<uint32_t>(frameSize / m_alignment * m_alignment);
+
+        BufferInfo info{};
+        // A descriptor range past the last chunk of the last slice has to stay inside the buffer
+        info.size = m_frameSize * FRAMES_IN_FLIGHT + TRANSIENT_BUFFER_MAX_RANGE;
+        info.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+        info.memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+        info.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        info.preferredMemoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        info.concurrent = true;
+        info.name = "transient buffer";
+        auto& resourceManager = RENDER_SYSTEM.getResourceManager();
+        m_buffer = resourceManager.createBuffer(info);
+        m_data = static_cast<char*>(resourceManager.getBuffer(m_buffer).allocation.allocationInfo.pMappedData);
+    }
+
+    TransientAllocation TransientBufferAllocator::allocate(uint32_t size) {
+        uint32_t alignedSize = (size + m_alignment - 1) / m_alignment * m_alignment;
+        uint32_t pointer = m_pointer.fetch_add(alignedSize, std::memory_order_relaxed);
+        if(pointer + alignedSize > m_frameSize)
+            throw std::runtime_error("Transient buffer is full, raise TRANSIENT_BUFFER_SIZE");
+        return TransientAllocation{
+            .data = m_data + m_frameOffset + pointer,
+            .offset = m_frameOffset + pointer,
+        };
+    }
+
+    void TransientBufferAllocator::beginFrame(uint32_t frameIndex) {
+        m_frameOffset = frameIndex * m_frameSize;
+        m_pointer.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ResourceManager.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace vanguard {
+    struct TransientAllocation {
+        // Persistently mapped, written by the CPU and only valid for the frame it was allocated in
+        void* data = nullptr;
+        // Dynamic offset of the chunk from the start of the buffer
+        uint32_t offset = 0;
+    };
+
+    // Bump allocates per draw data out of one persistently mapped buffer with a slice per frame in flight, bound through
+    // eUniformBufferDynamic and eStorageBufferDynamic descriptors written once with offset 0. A frame's slice is reset
+    // once its fence has been waited on. Chunks are aligned for both uniform and storage buffer offsets. Allocating is
+    // thread safe, so batches recorded on worker threads can allocate as well.
+    class TransientBufferAllocator {
+    public:
+        TransientBufferAllocator() = default;
+
+        TransientBufferAllocator(const TransientBufferAllocator&) = delete;
+        TransientBufferAllocator& operator=(const TransientBufferAllocator&) = delete;
+
+        void init(vk::DeviceSize frameSize = TRANSIENT_BUFFER_SIZE);
+
+        [[nodiscard]] TransientAllocation allocate(uint32_t size);
+        template <typename T> requires std::is_trivially_copyable_v<T>
+        [[nodiscard]] uint32_t write(const T& data) {
+            auto allocation = allocate(sizeof(T));
+            memcpy(allocation.data, &data, sizeof(T));
+            return allocation.offset;
+        }
+
+        // Called once the frame's fence has been waited on
+        void beginFrame(uint32_t frameIndex);
+
+        [[nodiscard]] ResourceRef getBuffer() const { return m_buffer; }
+    private:
+        ResourceRef m_buffer = UNDEFINED_RESOURCE;
+        char* m_data = nullptr;
+        uint32_t m_frameSize = 0;
+        uint32_t m_alignment = 1;
+        uint32_t m_frameOffset = 0;
+        std::atomic<uint32_t> m_pointer = 0;
+    };
+}
@@ -3,8 +3,17 @@
 #include "../Logger.h"
 #include "Allocator.h"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 #define VULKAN_LOGGER_NAME "Vulkan"
 #define VULKAN_MIN_IMAGE_COUNT 2
+#define VULKAN_PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define VULKAN_PIPELINE_CACHE_MAGIC 0x56474350
+// Caches claiming to be larger are treated as corrupt
+#define VULKAN_PIPELINE_CACHE_MAX_SIZE (512 * 1024 * 1024)
 
 namespace vanguard {
     static vk::raii::Context s_context;
@@ -14,6 +23,19 @@ namespace vanguard {
     static std::optional<vk::raii::Device> s_device;
     static uint32_t s_queueFamilyIndex = UINT32_MAX;
     static std::optional<vk::raii::Queue> s_queue;
+    static uint32_t s_computeQueueFamilyIndex = UINT32_MAX;
+    static std::optional<vk::raii::Queue> s_computeQueue;
+    static uint32_t s_transferQueueFamilyIndex = UINT32_MAX;
+    static std::optional<vk::raii::Queue> s_transferQueue;
+    static std::vector<uint32_t> s_queueFamilyIndices;
+    static std::vector<uint32_t> s_uploadQueueFamilyIndices;
+    static vk::PhysicalDeviceFeatures s_enabledFeatures;
+    static vk::PhysicalDeviceDescriptorIndexingFeatures s_descriptorIndexingFeatures;
+    static vk::PhysicalDeviceTimelineSemaphoreFeatures s_timelineSemaphoreFeatures;
+    static bool s_bindlessSupported = false;
+    static bool s_pushDescriptorSupported = false;
+    static bool s_memoryBudgetSupported = false;
+    static vk::DeviceSize s_hostVisibleDeviceLocalSize = 0;
     static std::optional<vk::raii::SurfaceKHR> s_surface;
     static std::optional<vk::raii::SwapchainKHR> s_swapchain;
     static vk::Extent2D s_swapchainExtent;
@@ -21,6 +43,15 @@ namespace vanguard {
     static std::optional<Allocator> s_allocator;
     static std::mutex s_vmaMutex;
     static std::optional<vk::raii::DescriptorPool> s_descriptorPool;
+    static std::optional<vk::raii::PipelineCache> s_pipelineCache;
+    static bool s_pipelineCacheWarm = false;
+
+    // Written in front of the driver's cache data, the driver's own header doesn't cover the driver version
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t driverVersion;
+        uint64_t dataSize;
+    };
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessengerFunc( VkDebugUtilsMessageSeverityFlagBitsEXT       messageSeverity,
                                                      VkDebugUtilsMessageTypeFlagsEXT              messageTypes,
@@ -48,6 +79,44 @@ namespace vanguard {
         return VK_FALSE;
     }
 
+    // Returns nothing when there is no cache on disk or it was written by a different device or driver
+    static std::vector<uint8_t> loadPipelineCacheData() {
+        std::ifstream file(VULKAN_PIPELINE_CACHE_PATH, std::ios::binary | std::ios::ate);
+        if(!file)
+            return {};
+        auto fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        PipelineCacheFileHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        auto properties = s_physicalDevice->getProperties();
+        if(!file || header.magic != VULKAN_PIPELINE_CACHE_MAGIC || header.driverVersion != properties.driverVersion) {
+            WARN("Discarding pipeline cache written by a different driver");
+            return {};
+        }
+
+        // The size comes from disk, check it before allocating
+        if(header.dataSize > fileSize - sizeof(header) || header.dataSize > VULKAN_PIPELINE_CACHE_MAX_SIZE) {
+            WARN("Discarding truncated pipeline cache");
+            return {};
+        }
+        std::vector<uint8_t> data(header.dataSize);
+        file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        VkPipelineCacheHeaderVersionOne cacheHeader{};
+        if(!file || data.size() < sizeof(cacheHeader)) {
+            WARN("Discarding truncated pipeline cache");
+            return {};
+        }
+        std::memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+        if(cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+           cacheHeader.vendorID != properties.vendorID || cacheHeader.deviceID != properties.deviceID ||
+           std::memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+            WARN("Discarding pipeline cache written by a different device");
+            return {};
+        }
+        return data;
+    }
+
     void Vulkan::init(const std::vector<std::string>& extensions) {
         vk::ApplicationInfo appInfo{
             .pApplicationName = APPLICATION_NAME,
@@ -103,6 +172,27 @@ namespace vanguard {
         if(s_queueFamilyIndex == UINT32_MAX) {
             ERROR("No suitable queue family found");
         }
+        // A compute only family usually maps to dedicated async compute hardware
+        for (uint32_t i = 0; i < queueFamilyProperties.size(); i++) {
+            if ((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute) && !(queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics)) {
+                s_computeQueueFamilyIndex = i;
+                break;
+            }
+        }
+        if(s_computeQueueFamilyIndex == UINT32_MAX) {
+            INFO("No dedicated compute queue family found, async compute runs on the main queue");
+        }
+        // A transfer only family usually maps to the copy engines
+        for (uint32_t i = 0; i < queueFamilyProperties.size(); i++) {
+            auto flags = queueFamilyProperties[i].queueFlags;
+            if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+                s_transferQueueFamilyIndex = i;
+                break;
+            }
+        }
+        if(s_transferQueueFamilyIndex == UINT32_MAX) {
+            INFO("No dedicated transfer queue family found, async uploads run on the main queue");
+        }
 
         std::vector<const char*> deviceExtensions = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -115,56 +205,182 @@ namespace vanguard {
             }
         }
 
+        // Optional extensions, anything using them has to check for support first
+        auto supportedExtensions = s_physicalDevice->enumerateDeviceExtensionProperties();
+        auto isExtensionSupported = [&](std::string_view name) {
+            return std::any_of(supportedExtensions.begin(), supportedExtensions.end(), [&](const vk::ExtensionProperties& properties) {
+                return name == properties.extensionName.data();
+            });
+        };
+        s_pushDescriptorSupported = isExtensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        if(s_pushDescriptorSupported)
+            deviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        else
+            INFO("VK_KHR_push_descriptor isn't supported, push descriptor sets are disabled");
+        s_memoryBudgetSupported = isExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if(s_memoryBudgetSupported)
+            deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        else
+            INFO("VK_EXT_memory_budget isn't supported, memory budgets are estimated from the heap sizes");
+
         float queuePriority = 1.0f;
-        vk::DeviceQueueCreateInfo deviceQueueCreateInfo{
-            .queueFamilyIndex = s_queueFamilyIndex,
-            .queueCount = 1,
-            .pQueuePriorities = &queuePriority,
+        std::vector<vk::DeviceQueueCreateInfo> deviceQueueCreateInfos = {
+            vk::DeviceQueueCreateInfo{
+                .queueFamilyIndex = s_queueFamilyIndex,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            }
         };
+        if(s_computeQueueFamilyIndex != UINT32_MAX) {
+            deviceQueueCreateInfos.push_back(vk::DeviceQueueCreateInfo{
+                .queueFamilyIndex = s_computeQueueFamilyIndex,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            });
+        }
+        if(s_transferQueueFamilyIndex != UINT32_MAX) {
+            deviceQueueCreateInfos.push_back(vk::DeviceQueueCreateInfo{
+                .queueFamilyIndex = s_transferQueueFamilyIndex,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            });
+        }
+
+        // Optional features, anything using them has to check getEnabledFeatures first
+        auto supportedFeatures = s_physicalDevice->getFeatures();
+        s_enabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        s_enabledFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+        s_enabledFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+
+        // Bindless needs partially bound, variable length arrays which can be written while bound
+        auto supportedIndexing = s_physicalDevice->getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>()
+                .get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+        s_bindlessSupported = supportedIndexing.descriptorBindingPartiallyBound && supportedIndexing.runtimeDescriptorArray &&
+                supportedIndexing.shaderSampledImageArrayNonUniformIndexing && supportedIndexing.shaderStorageBufferArrayNonUniformIndexing &&
+                supportedIndexing.descriptorBindingSampledImageUpdateAfterBind && supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind &&
+                supportedIndexing.descriptorBindingUpdateUnusedWhilePending;
+        if(s_bindlessSupported) {
+            s_descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            s_descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            s_descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            s_descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+            s_descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            s_descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            s_descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        } else {
+            INFO("Descriptor indexing isn't supported, bindless descriptors are disabled");
+        }
+
+        // Async uploads signal timeline semaphores, core since 1.2 but still optional
+        if(!s_physicalDevice->getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>()
+                .get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore) {
+            throw std::runtime_error("Unsupported GPU, missing timeline semaphores.");
+        }
+        s_timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        s_timelineSemaphoreFeatures.pNext = s_bindlessSupported ? &s_descriptorIndexingFeatures : nullptr;
 
         s_device = s_physicalDevice->createDevice({
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &deviceQueueCreateInfo,
+            .pNext = &s_timelineSemaphoreFeatures,
+            .queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size()),
+            .pQueueCreateInfos = deviceQueueCreateInfos.data(),
             .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
             .ppEnabledExtensionNames = deviceExtensions.data(),
+            .pEnabledFeatures = &s_enabledFeatures,
         });
 
         s_queue = s_device->getQueue(s_queueFamilyIndex, 0);
+        s_queueFamilyIndices = { s_queueFamilyIndex };
+        if(s_computeQueueFamilyIndex != UINT32_MAX) {
+            s_computeQueue = s_device->getQueue(s_computeQueueFamilyIndex, 0);
+            s_queueFamilyIndices.push_back(s_computeQueueFamilyIndex);
+        }
+        // Sharing with more families can cost compression and bandwidth, so only async upload destinations add the
+        // transfer family
+        s_uploadQueueFamilyIndices = s_queueFamilyIndices;
+        if(s_transferQueueFamilyIndex != UINT32_MAX) {
+            s_transferQueue = s_device->getQueue(s_transferQueueFamilyIndex, 0);
+            s_uploadQueueFamilyIndices.push_back(s_transferQueueFamilyIndex);
+        }
 
         VmaVulkanFunctions vmaVulkanFunctions{
             .vkGetInstanceProcAddr = s_context.getDispatcher()->vkGetInstanceProcAddr,
             .vkGetDeviceProcAddr = s_instance->getDispatcher()->vkGetDeviceProcAddr,
         };
         s_allocator = Allocator(VmaAllocatorCreateInfo{
+            .flags = s_memoryBudgetSupported ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u,
             .physicalDevice = static_cast<VkPhysicalDevice>(**s_physicalDevice),
             .device = static_cast<VkDevice>(**s_device),
             .pVulkanFunctions = &vmaVulkanFunctions,
             .instance = static_cast<VkInstance>(**s_instance),
+            // The budget extension is queried through the core 1.1 properties2 functions
+            .vulkanApiVersion = VK_API_VERSION_1_2,
         });
 
-        #define POOL_SIZE 11
-        vk::DescriptorPoolSize poolSizes[POOL_SIZE] = {
-            { vk::DescriptorType::eSampler, 1000 },
-            { vk::DescriptorType::eCombinedImageSampler, 1000 },
-            { vk::DescriptorType::eSampledImage, 1000 },
-            { vk::DescriptorType::eStorageImage, 1000 },
-            { vk::DescriptorType::eUniformTexelBuffer, 1000 },
-            { vk::DescriptorType::eStorageTexelBuffer, 1000 },
-            { vk::DescriptorType::eUniformBuffer, 1000 },
-            { vk::DescriptorType::eStorageBuffer, 1000 },
-            { vk::DescriptorType::eUniformBufferDynamic, 1000 },
-            { vk::DescriptorType::eStorageBufferDynamic, 1000 },
-            { vk::DescriptorType::eInputAttachment, 1000 },
-        };
+        // BAR memory the CPU writes into directly, the whole of VRAM with resizable BAR
+        auto memoryProperties = s_physicalDevice->getMemoryProperties();
+        auto barFlags = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if((memoryProperties.memoryTypes[i].propertyFlags & barFlags) == barFlags) {
+                s_hostVisibleDeviceLocalSize = std::max(s_hostVisibleDeviceLocalSize, memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size);
+            }
+        }
+        if(s_hostVisibleDeviceLocalSize > 0) {
+            INFO("Host visible device local memory: {} MiB", s_hostVisibleDeviceLocalSize >> 20);
+        } else {
+            INFO("No host visible device local memory, host written buffers live in system memory");
+        }
+
+        // Only ImGui allocates from this pool, everything else goes through a DescriptorAllocator
+        vk::DescriptorPoolSize imGuiPoolSize{ vk::DescriptorType::eCombinedImageSampler, 16 };
         s_descriptorPool = s_device->createDescriptorPool({
             .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-            .maxSets = 1000 * POOL_SIZE,
-            .poolSizeCount = POOL_SIZE,
-            .pPoolSizes = poolSizes,
+            .maxSets = 16,
+            .poolSizeCount = 1,
+            .pPoolSizes = &imGuiPoolSize,
         });
+
+        // Shared by every pipeline created, so a warm start skips most of the driver's shader compilation
+        std::vector<uint8_t> pipelineCacheData = loadPipelineCacheData();
+        s_pipelineCacheWarm = !pipelineCacheData.empty();
+        s_pipelineCache = s_device->createPipelineCache({
+            .initialDataSize = pipelineCacheData.size(),
+            .pInitialData = pipelineCacheData.data(),
+        });
+        INFO("Starting with a {} pipeline cache ({} bytes)", s_pipelineCacheWarm ? "warm" : "cold", pipelineCacheData.size());
+    }
+
+    void Vulkan::savePipelineCache() {
+        // Written next to the cache and renamed over it, so being killed halfway leaves the old cache intact
+        std::vector<uint8_t> data = s_pipelineCache->getData();
+        std::string tempPath = std::string(VULKAN_PIPELINE_CACHE_PATH) + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if(!file) {
+            ERROR("Failed to open {} for writing", tempPath);
+            return;
+        }
+
+        PipelineCacheFileHeader header{
+            .magic = VULKAN_PIPELINE_CACHE_MAGIC,
+            .driverVersion = s_physicalDevice->getProperties().driverVersion,
+            .dataSize = data.size(),
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        file.close();
+        if(!file) {
+            ERROR("Failed to write {}", tempPath);
+            return;
+        }
+        std::error_code error;
+        std::filesystem::rename(tempPath, VULKAN_PIPELINE_CACHE_PATH, error);
+        if(error) {
+            ERROR("Failed to replace {}: {}", VULKAN_PIPELINE_CACHE_PATH, error.message());
+            return;
+        }
+        INFO("Saved pipeline cache ({} bytes)", data.size());
     }
 
-    static void createSwapchain(uint32_t width, uint32_t height) {
+    static std::optional<vk::raii::SwapchainKHR> createSwapchain(uint32_t width, uint32_t height) {
         auto surfaceFormats = s_physicalDevice->getSurfaceFormatsKHR(**s_surface);
         auto chosenSurfaceFormat = surfaceFormats[0];
         auto presentMode = vk::PresentModeKHR::eFifo;
@@ -196,8 +412,10 @@ namespace vanguard {
             .clipped = VK_TRUE
         };
 
-        if(s_swapchain.has_value())
-            info.oldSwapchain = **s_swapchain;
+        std::optional<vk::raii::SwapchainKHR> oldSwapchain = std::move(s_swapchain);
+        s_swapchain.reset();
+        if(oldSwapchain.has_value())
+            info.oldSwapchain = **oldSwapchain;
 
         s_swapchain = s_device->createSwapchainKHR(info);
 
@@ -222,6 +440,7 @@ namespace vanguard {
                 //.imageView = s_device->createImageView(viewInfo),
             });
         }
+        return oldSwapchain;
     }
 
     void Vulkan::initWindow(VkSurfaceKHR surface, uint32_t width, uint32_t height) {
@@ -230,8 +449,8 @@ namespace vanguard {
         createSwapchain(width, height);
     }
 
-    void Vulkan::recreateSwapchain(uint32_t width, uint32_t height) {
-        createSwapchain(width, height);
+    std::optional<vk::raii::SwapchainKHR> Vulkan::recreateSwapchain(uint32_t width, uint32_t height) {
+        return createSwapchain(width, height);
     }
 
     void Vulkan::initImGui(ImGuiWindow& window) {
@@ -252,15 +471,13 @@ namespace vanguard {
         ImGuiIO& io = ImGui::GetIO();
         ImGui_ImplGlfw_InitForVulkan(window.getHandle(), true);
 
-        static VkPipelineCache imGuiPipelineCache = VK_NULL_HANDLE;
-
         ImGui_ImplVulkan_InitInfo init_info{
             .Instance = static_cast<VkInstance>(**s_instance),
             .PhysicalDevice = static_cast<VkPhysicalDevice>(**s_physicalDevice),
             .Device = static_cast<VkDevice>(**s_device),
             .QueueFamily = s_queueFamilyIndex,
             .Queue = static_cast<VkQueue>(**s_queue),
-            .PipelineCache = imGuiPipelineCache,
+            .PipelineCache = static_cast<VkPipelineCache>(**s_pipelineCache),
             .DescriptorPool = static_cast<VkDescriptorPool>(**s_descriptorPool),
             .MinImageCount = VULKAN_MIN_IMAGE_COUNT,
             .ImageCount = wd.ImageCount,
@@ -407,6 +624,58 @@ namespace vanguard {
         return s_queueFamilyIndex;
     }
 
+    bool Vulkan::hasTransferQueue() {
+        return s_transferQueue.has_value();
+    }
+
+    vk::raii::Queue& Vulkan::getTransferQueue() {
+        return s_transferQueue.has_value() ? *s_transferQueue : *s_queue;
+    }
+
+    uint32_t Vulkan::getTransferQueueFamilyIndex() {
+        return s_transferQueue.has_value() ? s_transferQueueFamilyIndex : s_queueFamilyIndex;
+    }
+
+    bool Vulkan::hasComputeQueue() {
+        return s_computeQueue.has_value();
+    }
+
+    vk::raii::Queue& Vulkan::getComputeQueue() {
+        return s_computeQueue.has_value() ? *s_computeQueue : *s_queue;
+    }
+
+    uint32_t Vulkan::getComputeQueueFamilyIndex() {
+        return s_computeQueue.has_value() ? s_computeQueueFamilyIndex : s_queueFamilyIndex;
+    }
+
+    const std::vector<uint32_t>& Vulkan::getQueueFamilyIndices() {
+        return s_queueFamilyIndices;
+    }
+
+    const std::vector<uint32_t>& Vulkan::getUploadQueueFamilyIndices() {
+        return s_uploadQueueFamilyIndices;
+    }
+
+    const vk::PhysicalDeviceFeatures& Vulkan::getEnabledFeatures() {
+        return s_enabledFeatures;
+    }
+
+    bool Vulkan::isBindlessSupported() {
+        return s_bindlessSupported;
+    }
+
+    bool Vulkan::isPushDescriptorSupported() {
+        return s_pushDescriptorSupported;
+    }
+
+    bool Vulkan::isMemoryBudgetSupported() {
+        return s_memoryBudgetSupported;
+    }
+
+    vk::DeviceSize Vulkan::getHostVisibleDeviceLocalSize() {
+        return s_hostVisibleDeviceLocalSize;
+    }
+
     vk::raii::SwapchainKHR& Vulkan::getSwapchain() {
         return *s_swapchain;
     }
@@ -423,8 +692,12 @@ namespace vanguard {
         return *s_allocator;
     }
 
-    vk::raii::DescriptorPool& Vulkan::getDescriptorPool() {
-        return *s_descriptorPool;
+    vk::raii::PipelineCache& Vulkan::getPipelineCache() {
+        return *s_pipelineCache;
+    }
+
+    bool Vulkan::isPipelineCacheWarm() {
+        return s_pipelineCacheWarm;
     }
 
     std::mutex& Vulkan::getVmaMutex() {
@@ -454,4 +727,13 @@ namespace vanguard {
         }
         return alignedSize;
     }
-}
\ No newline at end of file
+
+    uint32_t Vulkan::padStorageBufferSize(uint32_t originalSize) {
+        auto minSsboAlignment = s_physicalDevice->getProperties().limits.minStorageBufferOffsetAlignment;
+        auto alignedSize = originalSize;
+        if (minSsboAlignment > 0) {
+            alignedSize = (alignedSize + minSsboAlignment - 1) & ~(minSsboAlignment - 1);
+        }
+        return alignedSize;
+    }
+}
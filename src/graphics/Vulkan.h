@@ -20,8 +20,11 @@ namespace vanguard {
     class Vulkan {
     public:
         static void init(const std::vector<std::string>& extensions);
+        // Writes the pipeline cache back to disk for the next launch
+        static void savePipelineCache();
         static void initWindow(VkSurfaceKHR surface, uint32_t width, uint32_t height);
-        static void recreateSwapchain(uint32_t width, uint32_t height);
+        // Hands back the old swapchain, frames in flight may still be presenting from it
+        static std::optional<vk::raii::SwapchainKHR> recreateSwapchain(uint32_t width, uint32_t height);
 
         static void initImGui(ImGuiWindow& window);
         static void beginImGuiFrame();
@@ -33,14 +36,38 @@ namespace vanguard {
         static vk::raii::Device& getDevice();
         static vk::raii::Queue& getQueue();
         static uint32_t getQueueFamilyIndex();
+        // Dedicated compute queue, the compute getters fall back to the main queue when there is none
+        static bool hasComputeQueue();
+        static vk::raii::Queue& getComputeQueue();
+        static uint32_t getComputeQueueFamilyIndex();
+        // Dedicated transfer queue for async uploads, falls back to the main queue like the compute getters
+        static bool hasTransferQueue();
+        static vk::raii::Queue& getTransferQueue();
+        static uint32_t getTransferQueueFamilyIndex();
+        // Families of the graphics and compute queues, used for concurrent sharing
+        static const std::vector<uint32_t>& getQueueFamilyIndices();
+        // Same plus the transfer queue's family, for concurrent resources written by the async uploader
+        static const std::vector<uint32_t>& getUploadQueueFamilyIndices();
+        static const vk::PhysicalDeviceFeatures& getEnabledFeatures();
+        // Descriptor indexing features needed by BindlessDescriptors
+        static bool isBindlessSupported();
+        // VK_KHR_push_descriptor, needed for push descriptor set layouts
+        static bool isPushDescriptorSupported();
+        // VK_EXT_memory_budget, VMA reports the driver's budgets instead of estimates with it
+        static bool isMemoryBudgetSupported();
+        // Size of the heap behind the largest device local memory type the CPU can map, 0 when there's none
+        static vk::DeviceSize getHostVisibleDeviceLocalSize();
         static vk::raii::SwapchainKHR& getSwapchain();
         static vk::Extent2D getSwapchainExtent();
         static std::vector<SwapchainImage>& getSwapchainImages();
         static Allocator& getAllocator();
-        static vk::raii::DescriptorPool& getDescriptorPool();
         static std::mutex& getVmaMutex();
+        static vk::raii::PipelineCache& getPipelineCache();
+        // Whether the pipeline cache was loaded from disk at init
+        static bool isPipelineCacheWarm();
 
         static vk::Format getDepthFormat();
         static uint32_t padUniformBufferSize(uint32_t originalSize);
+        static uint32_t padStorageBufferSize(uint32_t originalSize);
     };
 }
\ No newline at end of file
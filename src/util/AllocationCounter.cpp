@@ -0,0 +1,44 @@
+#include "AllocationCounter.h"
+
+#ifdef VANGUARD_TRACK_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> s_allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
+
+namespace vanguard {
+    uint64_t AllocationCounter::getCount() {
+#ifdef VANGUARD_TRACK_ALLOCATIONS
+        return s_allocations.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    bool AllocationCounter::isEnabled() {
+#ifdef VANGUARD_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vanguard {
+    // Counts global operator new calls when built with VANGUARD_TRACK_ALLOCATIONS, always 0 otherwise
+    class AllocationCounter {
+    public:
+        [[nodiscard]] static uint64_t getCount();
+        [[nodiscard]] static bool isEnabled();
+    };
+
+    // Allocations made between construction and getCount()
+    class ScopedAllocationCounter {
+    public:
+        ScopedAllocationCounter() : m_start(AllocationCounter::getCount()) {}
+
+        [[nodiscard]] uint64_t getCount() const { return AllocationCounter::getCount() - m_start; }
+    private:
+        uint64_t m_start;
+    };
+}
@@ -3,6 +3,13 @@
 #include <unordered_set>
 #include <glm/ext.hpp>
 
+namespace vanguard {
+    template <typename T>
+    inline void hashCombine(std::size_t& seed, const T& value) {
+        seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+}
+
 template <>
 struct std::hash<glm::ivec3> {
     std::size_t operator()(const glm::ivec3& k) const {
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vanguard {
+    // Fixed set of worker threads, tasks get the index of the worker running them so they can use per worker state
+    class ThreadPool {
+    public:
+        explicit ThreadPool(uint32_t threadCount) {
+            for (uint32_t i = 0; i < threadCount; i++) {
+                m_threads.emplace_back([this, i] { run(i); });
+            }
+        }
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stopping = true;
+            }
+            m_taskAvailable.notify_all();
+            for (auto& thread: m_threads) {
+                thread.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ThreadPool(ThreadPool&&) = delete;
+        ThreadPool& operator=(ThreadPool&&) = delete;
+
+        void submit(std::function<void(uint32_t)> task) {
+            {
+                std::lock_guard lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+                m_pendingTasks++;
+            }
+            m_taskAvailable.notify_one();
+        }
+
+        // Blocks until every submitted task has finished
+        void wait() {
+            std::unique_lock lock(m_mutex);
+            m_tasksFinished.wait(lock, [this] { return m_pendingTasks == 0; });
+        }
+
+        [[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+    private:
+        void run(uint32_t worker) {
+            while(true) {
+                std::function<void(uint32_t)> task;
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_taskAvailable.wait(lock, [this] { return m_stopping || m_nextTask < m_tasks.size(); });
+                    if(m_stopping && m_nextTask == m_tasks.size())
+                        return;
+                    task = std::move(m_tasks[m_nextTask++]);
+                    // Reset once drained, the vector keeps its capacity so later batches don't allocate
+                    if(m_nextTask == m_tasks.size()) {
+                        m_tasks.clear();
+                        m_nextTask = 0;
+                    }
+                }
+                task(worker);
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_pendingTasks--;
+                }
+                m_tasksFinished.notify_all();
+            }
+        }
+    private:
+        std::vector<std::thread> m_threads;
+        std::vector<std::function<void(uint32_t)>> m_tasks;
+        size_t m_nextTask = 0;
+        uint32_t m_pendingTasks = 0;
+        bool m_stopping = false;
+
+        std::mutex m_mutex;
+        std::condition_variable m_taskAvailable;
+        std::condition_variable m_tasksFinished;
+    };
+}